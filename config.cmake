@@ -3,4 +3,12 @@ set(APP_NAME esp-now-ant-bms)
 add_definitions(
     -DUSER_SETUP_LOADED=1
     -fdiagnostics-color=always
+#    -DANTBMS_EMULATOR=1
+#    -DBLE_BLOCKING_CONNECT=1
+#    -DESPNOW_ADAPTIVE_RATE=1
+#    -DESPNOW_TIME_MASTER=1
+#    -DESPNOW_GATEWAY=1
+#    -DGATEWAY_UART_EXPORT=1
+#    -DNODE_POWER_SAVE=1
+#    -DSERIALIZATION_BENCHMARK=1
 )
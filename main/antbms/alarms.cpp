@@ -0,0 +1,232 @@
+#include "alarms.h"
+
+// system includes
+#include <algorithm>
+#include <charconv>
+
+namespace antbms {
+
+namespace {
+float max_temperature(const AntBmsData &data)
+{
+    return data.temperatures.empty() ? 0.f : *std::max_element(data.temperatures.begin(), data.temperatures.end());
+}
+
+// off, full, manually switched off or over/undervoltage protection are normal operation,
+// the voltage limits are covered by the cell voltage rules already
+float charge_mosfet_fault(const AntBmsData &data)
+{
+    switch (data.charge_mosfet_status)
+    {
+    case ChargeMosfetStatus::OverCurrentProtection:
+    case ChargeMosfetStatus::TotalOverpressure:
+    case ChargeMosfetStatus::BatteryOverTemperature:
+    case ChargeMosfetStatus::MosfetOverTemperature:
+    case ChargeMosfetStatus::AbnormalCurrent:
+    case ChargeMosfetStatus::BalancedLineDroppedString:
+    case ChargeMosfetStatus::MotherboardOverTemperature:
+    case ChargeMosfetStatus::DischargeMosfetAbnormality:
+        return 1.f;
+    default:
+        return 0.f;
+    }
+}
+
+float discharge_mosfet_fault(const AntBmsData &data)
+{
+    switch (data.discharge_mosfet_status)
+    {
+    case DischargeMosfetStatus::OverCurrentProtection:
+    case DischargeMosfetStatus::BatteryOverTemperature:
+    case DischargeMosfetStatus::MosfetOverTemperature:
+    case DischargeMosfetStatus::AbnormalCurrent:
+    case DischargeMosfetStatus::BalancedLineDroppedString:
+    case DischargeMosfetStatus::MotherboardOverTemperature:
+    case DischargeMosfetStatus::ShortCircuitProtection:
+    case DischargeMosfetStatus::DischargeMosfetAbnormality:
+    case DischargeMosfetStatus::StartException:
+        return 1.f;
+    default:
+        return 0.f;
+    }
+}
+
+// defaults cover both NMC and LiFePO4 packs, tighten them with set_thresholds()
+constexpr const std::array<AlarmRule, ALARM_COUNT> DEFAULT_RULES{{
+        {AlarmId::CellOverVoltage, [](const AntBmsData &data) { return data.max_cell_voltage; },
+                AlarmRule::Above, 4.25f, 4.15f},
+        {AlarmId::CellUnderVoltage, [](const AntBmsData &data) { return data.min_cell_voltage; },
+                AlarmRule::Below, 2.80f, 3.00f},
+        {AlarmId::BatteryOverTemperature, max_temperature,
+                AlarmRule::Above, 60.f, 55.f},
+        {AlarmId::MosfetOverTemperature, [](const AntBmsData &data) { return data.mosfet_temperature; },
+                AlarmRule::Above, 80.f, 70.f},
+        {AlarmId::BalancerOverTemperature, [](const AntBmsData &data) { return data.balancer_temperature; },
+                AlarmRule::Above, 80.f, 70.f},
+        {AlarmId::ChargeMosfetFault, charge_mosfet_fault,
+                AlarmRule::Above, 0.5f, 0.5f},
+        {AlarmId::DischargeMosfetFault, discharge_mosfet_fault,
+                AlarmRule::Above, 0.5f, 0.5f},
+}};
+} // namespace
+
+AlarmEngine::AlarmEngine() : m_rules{DEFAULT_RULES}
+{}
+
+void AlarmEngine::set_thresholds(AlarmId id, float set, float clear)
+{
+    std::lock_guard lock{m_mutex};
+
+    auto &rule = m_rules[static_cast<size_t>(id)];
+    rule.set = set;
+    rule.clear = clear;
+}
+
+bool AlarmEngine::evaluate(const AntBmsData &data, int64_t now_us)
+{
+    std::lock_guard lock{m_mutex};
+
+    bool raised_any = false;
+
+    for (size_t i = 0; i < ALARM_COUNT; i++)
+    {
+        const auto &rule = m_rules[i];
+        const float value = rule.value(data);
+
+        const bool crossed_set = rule.direction == AlarmRule::Above ? value > rule.set : value < rule.set;
+        const bool crossed_clear = rule.direction == AlarmRule::Above ? value <= rule.clear : value >= rule.clear;
+
+        bool &active = m_active[i];
+        if (active ? !crossed_clear : !crossed_set)
+        {
+            continue;
+        }
+
+        active = !active;
+        m_pending[i] = AlarmEvent{
+            .id = rule.id,
+            .active = active,
+            .value = value,
+            .seq = ++m_seq,
+            .triggered_us = now_us,
+            .last_sent_us = 0,
+            .attempts = 0,
+        };
+
+        raised++;
+        raised_any = true;
+    }
+
+    return raised_any;
+}
+
+std::optional<AlarmEvent> AlarmEngine::due(int64_t now_us)
+{
+    std::lock_guard lock{m_mutex};
+
+    for (auto &event : m_pending)
+    {
+        if (!event || (event->attempts && now_us - event->last_sent_us < repeat_interval_us(event->attempts)))
+        {
+            continue;
+        }
+
+        if (event->attempts >= MAX_ATTEMPTS)
+        {
+            event.reset();
+            expired++;
+            continue;
+        }
+
+        return event;
+    }
+
+    return std::nullopt;
+}
+
+void AlarmEngine::transmitted(const AlarmEvent &event, int64_t now_us)
+{
+    std::lock_guard lock{m_mutex};
+
+    auto &pending = m_pending[static_cast<size_t>(event.id)];
+    if (!pending || pending->seq != event.seq)
+    {
+        // superseded meanwhile
+        return;
+    }
+
+    if (pending->last_sent_us)
+    {
+        retransmissions++;
+    }
+    else
+    {
+        trigger_to_air.add(now_us - pending->triggered_us);
+    }
+
+    pending->last_sent_us = now_us;
+    pending->attempts++;
+}
+
+void AlarmEngine::acknowledge(uint16_t seq)
+{
+    std::lock_guard lock{m_mutex};
+
+    for (auto &event : m_pending)
+    {
+        if (event && event->seq == seq)
+        {
+            event.reset();
+            acknowledged++;
+        }
+    }
+}
+
+int64_t AlarmEngine::repeat_interval_us(uint8_t attempts) const
+{
+    // 200ms, 400ms, 800ms ... up to 10s
+    return std::min(m_repeat_interval_us << (attempts - 1), MAX_REPEAT_INTERVAL_US);
+}
+
+bool AlarmEngine::has_pending() const
+{
+    std::lock_guard lock{m_mutex};
+
+    return std::any_of(m_pending.begin(), m_pending.end(), [](const auto &event) { return event.has_value(); });
+}
+
+std::expected<size_t, std::string> AlarmEngine::encode(const AlarmEvent &event, std::span<char> buffer)
+{
+    helpers::JsonWriter writer{buffer};
+    writer.raw("ALM:");
+    writer.begin_object();
+    writer.field("seq", event.seq);
+    writer.field("id", static_cast<uint8_t>(event.id));
+    writer.field("act", static_cast<uint8_t>(event.active));
+    writer.field("val", event.value);
+    writer.end_object();
+
+    return AntBmsData::finish(writer);
+}
+
+std::optional<uint16_t> AlarmEngine::parse_seq(std::string_view content)
+{
+    constexpr const std::string_view KEY = "\"seq\":";
+
+    const auto pos = content.find(KEY);
+    if (pos == std::string_view::npos)
+    {
+        return std::nullopt;
+    }
+
+    uint16_t seq;
+    const auto begin = content.data() + pos + KEY.size();
+    if (std::from_chars(begin, content.data() + content.size(), seq).ec != std::errc{})
+    {
+        return std::nullopt;
+    }
+
+    return seq;
+}
+
+} // namespace antbms
@@ -0,0 +1,116 @@
+#pragma once
+
+// system includes
+#include <array>
+#include <cstdint>
+#include <expected>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+// local includes
+#include "datastructure.h"
+#include "helpers/durationstats.h"
+
+namespace antbms {
+
+enum class AlarmId : uint8_t
+{
+    CellOverVoltage,
+    CellUnderVoltage,
+    BatteryOverTemperature,
+    MosfetOverTemperature,
+    BalancerOverTemperature,
+    ChargeMosfetFault,
+    DischargeMosfetFault,
+    Count
+};
+
+constexpr static const size_t ALARM_COUNT = static_cast<size_t>(AlarmId::Count);
+
+struct AlarmRule
+{
+    enum Direction : uint8_t
+    {
+        Above,
+        Below,
+    };
+
+    AlarmId id;
+    float (*value)(const AntBmsData &data);
+    Direction direction;
+    // raised when crossing set, cleared only once back past clear
+    float set;
+    float clear;
+};
+
+struct AlarmEvent
+{
+    AlarmId id;
+    bool active;
+    float value;
+    uint16_t seq;
+    int64_t triggered_us;
+    int64_t last_sent_us;
+    uint8_t attempts;
+};
+
+/// Evaluates the rule table on every decoded frame. Each raise or clear becomes
+/// an event that is transmitted ahead of normal telemetry and repeated until
+/// the receiver acknowledges its sequence number with "ACK:<seq>". The repeat
+/// interval doubles with every attempt, without a receiver the event is dropped
+/// after MAX_ATTEMPTS so a power-saving node can go back to sleep.
+///
+/// evaluate() runs on the NimBLE host task, the rest on the main loop.
+class AlarmEngine
+{
+public:
+    constexpr static const uint8_t MAX_ATTEMPTS = 8;
+    constexpr static const int64_t MAX_REPEAT_INTERVAL_US = 10'000'000;
+
+    AlarmEngine();
+
+    void set_thresholds(AlarmId id, float set, float clear);
+
+    void set_repeat_interval_us(int64_t interval_us)
+    { m_repeat_interval_us = interval_us; }
+
+    /// returns true if a new event was raised
+    bool evaluate(const AntBmsData &data, int64_t now_us);
+
+    /// next event that needs to go on air, if any
+    std::optional<AlarmEvent> due(int64_t now_us);
+
+    void transmitted(const AlarmEvent &event, int64_t now_us);
+
+    void acknowledge(uint16_t seq);
+
+    [[nodiscard]] bool has_pending() const;
+
+    static std::expected<size_t, std::string> encode(const AlarmEvent &event, std::span<char> buffer);
+
+    /// sequence number of a received "ALM:" frame's content, for the acknowledge
+    static std::optional<uint16_t> parse_seq(std::string_view content);
+
+    uint32_t raised{};
+    uint32_t acknowledged{};
+    uint32_t retransmissions{};
+    // given up after MAX_ATTEMPTS without acknowledge
+    uint32_t expired{};
+    // evaluate() -> first esp_now_send()
+    helpers::DurationStats trigger_to_air;
+
+private:
+    [[nodiscard]] int64_t repeat_interval_us(uint8_t attempts) const;
+
+    std::array<AlarmRule, ALARM_COUNT> m_rules;
+    std::array<bool, ALARM_COUNT> m_active{};
+    std::array<std::optional<AlarmEvent>, ALARM_COUNT> m_pending{};
+    uint16_t m_seq = 0;
+    int64_t m_repeat_interval_us = 200'000;
+    mutable std::mutex m_mutex;
+};
+
+} // namespace antbms
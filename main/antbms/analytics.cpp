@@ -0,0 +1,98 @@
+#include "analytics.h"
+
+// system includes
+#include <cmath>
+
+namespace antbms {
+
+namespace {
+// internal resistance needs a real load step, small changes are mostly noise
+constexpr const float MIN_CURRENT_STEP_A = 2.f;
+constexpr const float MAX_STEP_DURATION_S = 2.f;
+constexpr const float MAX_INTERNAL_RESISTANCE_OHM = 1.f;
+constexpr const float RESISTANCE_ALPHA = 0.1f;
+} // namespace
+
+void Analytics::TrendEstimator::add(double x, double y, double alpha)
+{
+    if (!initialized)
+    {
+        mean_x = x;
+        mean_y = y;
+        initialized = true;
+        return;
+    }
+
+    const double dx = x - mean_x;
+    const double dy = y - mean_y;
+    mean_x += alpha * dx;
+    mean_y += alpha * dy;
+    cov_xy = (1 - alpha) * (cov_xy + alpha * dx * dy);
+    var_x = (1 - alpha) * (var_x + alpha * dx * dx);
+}
+
+void Analytics::update(AntBmsData &data, int64_t now_us)
+{
+    const float voltage = data.total_voltage;
+    const float current = data.current;
+
+    if (!m_first_sample_us)
+    {
+        m_first_sample_us = now_us;
+    }
+
+    if (!m_last_sample_us)
+    {
+        m_current_ewma = current;
+    }
+    else if (const float dt_s = (now_us - m_last_sample_us) / 1e6f; dt_s > 0 && dt_s <= MAX_GAP_S)
+    {
+        // trapezoidal power integration, positive current charges the pack
+        const double power_w = (double(voltage) * current + double(m_last_voltage) * m_last_current) / 2;
+        const double energy_wh = power_w * dt_s / 3600;
+        if (energy_wh >= 0)
+        {
+            m_energy_in_wh.add(energy_wh);
+        }
+        else
+        {
+            m_energy_out_wh.add(-energy_wh);
+        }
+
+        m_current_ewma += (1 - std::exp(-dt_s / m_current_tau_s)) * (current - m_current_ewma);
+
+        const float hours = (now_us - m_first_sample_us) / 3.6e9f;
+        m_imbalance_trend.add(hours, data.delta_cell_voltage * 1000.f, 1 - std::exp(-dt_s / m_trend_tau_s));
+
+        if (const float di = current - m_last_current;
+            std::fabs(di) >= MIN_CURRENT_STEP_A && dt_s <= MAX_STEP_DURATION_S)
+        {
+            if (const float r = (voltage - m_last_voltage) / di; r > 0 && r < MAX_INTERNAL_RESISTANCE_OHM)
+            {
+                m_internal_resistance_ohm = m_internal_resistance_ohm > 0
+                                            ? m_internal_resistance_ohm + RESISTANCE_ALPHA * (r - m_internal_resistance_ohm)
+                                            : r;
+            }
+        }
+    }
+
+    m_last_sample_us = now_us;
+    m_last_voltage = voltage;
+    m_last_current = current;
+
+    data.energy_in = m_energy_in_wh.sum;
+    data.energy_out = m_energy_out_wh.sum;
+    data.average_current = m_current_ewma;
+    data.c_rate = data.total_battery_capacity_setting > 0
+                  ? std::fabs(m_current_ewma) / data.total_battery_capacity_setting : 0;
+    data.imbalance_trend = m_imbalance_trend.slope();
+    data.internal_resistance = m_internal_resistance_ohm * 1000.f;
+}
+
+void Analytics::reset()
+{
+    // energy counters survive reconnects, only the sample chain restarts
+    m_last_sample_us = 0;
+}
+
+} // namespace antbms
@@ -0,0 +1,76 @@
+#pragma once
+
+// system includes
+#include <cstdint>
+
+// local includes
+#include "datastructure.h"
+
+namespace antbms {
+
+/// Derived battery metrics, updated in O(1) after every decoded status frame.
+/// Results are written back into the AntBmsData "derived" fields.
+class Analytics
+{
+public:
+    // samples further apart than this are not integrated (link dropped, BMS stalled)
+    constexpr static const float MAX_GAP_S = 5.f;
+
+    void set_current_time_constant(float seconds)
+    { m_current_tau_s = seconds; }
+
+    void set_trend_time_constant(float seconds)
+    { m_trend_tau_s = seconds; }
+
+    void update(AntBmsData &data, int64_t now_us);
+
+    void reset();
+
+private:
+    // compensated summation, energy is accumulated for days from tiny increments
+    struct KahanSum
+    {
+        double sum{};
+        double compensation{};
+
+        void add(double value)
+        {
+            const double y = value - compensation;
+            const double t = sum + y;
+            compensation = (t - sum) - y;
+            sum = t;
+        }
+    };
+
+    // exponentially forgetting least squares slope, x is kept relative to the
+    // first sample so the sums stay small
+    struct TrendEstimator
+    {
+        double mean_x{};
+        double mean_y{};
+        double cov_xy{};
+        double var_x{};
+        bool initialized{};
+
+        void add(double x, double y, double alpha);
+
+        [[nodiscard]] double slope() const
+        { return var_x > 0 ? cov_xy / var_x : 0; }
+    };
+
+    float m_current_tau_s = 10.f;
+    float m_trend_tau_s = 600.f;
+
+    int64_t m_last_sample_us = 0;
+    float m_last_voltage = 0;
+    float m_last_current = 0;
+    int64_t m_first_sample_us = 0;
+
+    KahanSum m_energy_in_wh;
+    KahanSum m_energy_out_wh;
+    float m_current_ewma = 0;
+    TrendEstimator m_imbalance_trend;
+    float m_internal_resistance_ohm = 0;
+};
+
+} // namespace antbms
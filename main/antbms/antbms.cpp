@@ -1,26 +1,40 @@
 #include "antbms.h"
 
+// system includes
+#include <algorithm>
+#include <charconv>
+#include <limits>
+
 // esp-idf includes
 #include <esp_log.h>
+#include <esp_timer.h>
 
 // 3rdparty includes
+#include <fmt/core.h>
 #include <NimBLEDevice.h>
 
 // local includes
+#include "helpers/base64.h"
 #include "helpers/crc16.h"
 #include "helpers/format_hex_pretty.h"
+#include "helpers/memorystats.h"
 #include "espnow.h"
+#include "frame.h"
+#include "ratecontroller.h"
+#include "statusdecoder.h"
 
 namespace antbms {
 constexpr static const uint16_t ANT_BMS_SERVICE_UUID = 0xFFE0;
 constexpr static const uint16_t ANT_BMS_CHARACTERISTIC_UUID = 0xFFE1;
 
-constexpr static const uint8_t MAX_RESPONSE_SIZE = 152;
+constexpr static const uint8_t MAX_RESPONSE_SIZE = FrameAssembler::MAX_FRAME_SIZE;
+
+// every notification carries a 3 byte ATT header (opcode + handle)
+constexpr static const uint16_t ATT_NOTIFY_OVERHEAD = 3;
+constexpr static const uint16_t ATT_DEFAULT_MTU = 23;
 
-constexpr static const uint8_t ANT_PKT_START_1 = 0x7E;
-constexpr static const uint8_t ANT_PKT_START_2 = 0xA1;
-constexpr static const uint8_t ANT_PKT_END_1 = 0xAA;
-constexpr static const uint8_t ANT_PKT_END_2 = 0x55;
+// failed attempts at the last known address before scanning again
+constexpr static const uint32_t RESCAN_AFTER_FAILURES = 3;
 
 constexpr static const uint8_t ANT_FRAME_TYPE_STATUS = 0x11;
 constexpr static const uint8_t ANT_FRAME_TYPE_DEVICE_INFO = 0x12;
@@ -33,74 +47,102 @@ constexpr static const uint8_t ANT_FRAME_TYPE_UNKNOWN2 = 0x43;
 constexpr static const uint8_t ANT_FRAME_TYPE_UNKNOWN3 = 0x61;
 
 constexpr static const uint8_t ANT_COMMAND_STATUS = 0x01;
+// reads a range of parameter registers, the device info is one of them
 constexpr static const uint8_t ANT_COMMAND_DEVICE_INFO = 0x02;
+constexpr static const uint8_t ANT_COMMAND_READ_REGISTERS = ANT_COMMAND_DEVICE_INFO;
 constexpr static const uint8_t ANT_COMMAND_WRITE_REGISTER = 0x51;
+constexpr static const uint8_t ANT_COMMAND_AUTHENTICATE = 0x23;
 
-constexpr static const uint8_t CHARGE_MOSFET_STATUS_SIZE = 16;
-static const char *const CHARGE_MOSFET_STATUS[CHARGE_MOSFET_STATUS_SIZE] = {
-        "Off",                           // 0x00
-        "On",                            // 0x01
-        "Overcharge protection",         // 0x02
-        "Over current protection",       // 0x03
-        "Battery full",                  // 0x04
-        "Total overpressure",            // 0x05
-        "Battery over temperature",      // 0x06
-        "MOSFET over temperature",       // 0x07
-        "Abnormal current",              // 0x08
-        "Balanced line dropped string",  // 0x09
-        "Motherboard over temperature",  // 0x0A
-        "Unknown",                       // 0x0B
-        "Unknown",                       // 0x0C
-        "Discharge MOSFET abnormality",  // 0x0D
-        "Unknown",                       // 0x0E
-        "Manually turned off",           // 0x0F
-};
+constexpr static const uint16_t ANT_ADDRESS_PASSWORD = 0x016a;
+constexpr static const uint16_t ANT_ADDRESS_DEVICE_INFO = 0x026c;
+constexpr static const size_t ANT_MAX_PASSWORD_SIZE = 32;
+
+// frames that never change, CRC included, computed at compile time
+constexpr static const auto STATUS_REQUEST_FRAME = make_frame(ANT_COMMAND_STATUS, 0x0000, 0xbe);
+static_assert(STATUS_REQUEST_FRAME == Frame<0>{0x7e, 0xa1, 0x01, 0x00, 0x00, 0xbe, 0x18, 0x55, 0xaa, 0x55});
+
+constexpr static const auto DEVICE_INFO_REQUEST_FRAME = make_frame(ANT_COMMAND_DEVICE_INFO, ANT_ADDRESS_DEVICE_INFO, 0x20);
+static_assert(DEVICE_INFO_REQUEST_FRAME == Frame<0>{0x7e, 0xa1, 0x02, 0x6c, 0x02, 0x20, 0x58, 0xc4, 0xaa, 0x55});
+
+// default password "123456789abc"
+constexpr static const auto AUTHENTICATE_FRAME = make_frame<12>(
+        ANT_COMMAND_AUTHENTICATE, ANT_ADDRESS_PASSWORD, 0x0c,
+        {0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x61, 0x62, 0x63});
+
+// hardware and software version, 16 bytes each, end at byte 38
+constexpr static const size_t DEVICE_INFO_MIN_SIZE = 38;
+
+// "REG:<address hex>,<count>" is answered with "REGV:<address hex>,<hex bytes>" or "REGV:<address hex>,miss",
+// the answer has to fit into one ESP-NOW frame
+constexpr static const size_t MAX_REGISTER_QUERY = 96;
+static_assert(sizeof("REGV:ffff,") - 1 + 2 * MAX_REGISTER_QUERY <= ESP_NOW_MAX_DATA_LEN);
+
+// the batches carry voltage, current, SoC and cell extremes already, the rest of the
+// fast group goes out at the pace of the other groups
+constexpr static const auto BATCHED_FAST_PERIOD = std::chrono::seconds{2};
+
+constexpr static const size_t CAPTURE_DEFAULT_SIZE = 16 * 1024;
+// 57 bytes make one 76 character base64 line
+constexpr static const size_t CAPTURE_DUMP_LINE_BYTES = 57;
+// keeps a replay at speed 0 from stalling the main loop
+constexpr static const size_t REPLAY_RECORDS_PER_UPDATE = 64;
+
+std::array<uint8_t, 2> to_le16(uint16_t value)
+{
+    return {uint8_t(value >> 0), uint8_t(value >> 8)};
+}
+
+uint8_t notifications_per_frame(uint16_t mtu)
+{
+    const uint16_t payload = std::max<uint16_t>(mtu, ATT_DEFAULT_MTU) - ATT_NOTIFY_OVERHEAD;
+    return (MAX_RESPONSE_SIZE + payload - 1) / payload;
+}
 
-static const uint8_t DISCHARGE_MOSFET_STATUS_SIZE = 16;
-static const char *const DISCHARGE_MOSFET_STATUS[DISCHARGE_MOSFET_STATUS_SIZE] = {
-        "Off",                           // 0x00
-        "On",                            // 0x01
-        "Overdischarge protection",      // 0x02
-        "Over current protection",       // 0x03
-        "Unknown",                       // 0x04
-        "Total pressure undervoltage",   // 0x05
-        "Battery over temperature",      // 0x06
-        "MOSFET over temperature",       // 0x07
-        "Abnormal current",              // 0x08
-        "Balanced line dropped string",  // 0x09
-        "Motherboard over temperature",  // 0x0A
-        "Charge MOSFET on",              // 0x0B
-        "Short circuit protection",      // 0x0C
-        "Discharge MOSFET abnormality",  // 0x0D
-        "Start exception",               // 0x0E
-        "Manually turned off",           // 0x0F
+struct ConnParams
+{
+    uint16_t min_interval; // 1.25ms units
+    uint16_t max_interval; // 1.25ms units
+    uint16_t latency;      // connection events
+    uint16_t timeout;      // 10ms units
 };
 
-static const uint8_t BALANCER_STATUS_SIZE = 11;
-static const char *const BALANCER_STATUS[BALANCER_STATUS_SIZE] = {
-        "Off",                                   // 0x00
-        "Exceeds the limit equilibrium",         // 0x01
-        "Charge differential pressure balance",  // 0x02
-        "Balanced over temperature",             // 0x03
-        "Automatic equalization",                // 0x04
-        "Unknown",                               // 0x05
-        "Unknown",                               // 0x06
-        "Unknown",                               // 0x07
-        "Unknown",                               // 0x08
-        "Unknown",                               // 0x09
-        "Motherboard over temperature",          // 0x0A
+// what NimBLE connects with unless told otherwise
+constexpr static const ConnParams DEFAULT_CONN_PARAMS{
+    .min_interval = BLE_GAP_INITIAL_CONN_ITVL_MIN,
+    .max_interval = BLE_GAP_INITIAL_CONN_ITVL_MAX,
+    .latency = BLE_GAP_INITIAL_CONN_LATENCY,
+    .timeout = BLE_GAP_INITIAL_SUPERVISION_TIMEOUT,
 };
 
-std::string format_total_runtime_(const uint32_t value)
+// reasons a peripheral gives for connection parameters it does not accept, anything
+// else (timeout, out of range, BMS switched off) says nothing about our parameters
+bool conn_params_rejected(int reason)
+{
+    switch (reason)
+    {
+    case BLE_HS_EINVAL:
+    case BLE_HS_HCI_ERR(BLE_ERR_INV_LMP_LL_PARM):
+    case BLE_HS_HCI_ERR(BLE_ERR_UNSUPP_LMP_PARM_VAL):
+    case BLE_HS_HCI_ERR(BLE_ERR_CONN_PARMS):
+        return true;
+    default:
+        return false;
+    }
+}
+
+ConnParams conn_params_for_poll_interval(espchrono::millis_clock::duration poll_interval)
 {
-    int seconds = (int) value;
-    int years = seconds / (24 * 3600 * 365);
-    seconds = seconds % (24 * 3600 * 365);
-    int days = seconds / (24 * 3600);
-    seconds = seconds % (24 * 3600);
-    int hours = seconds / 3600;
-    return (years ? std::to_string(years) + "y " : "") + (days ? std::to_string(days) + "d " : "") +
-           (hours ? std::to_string(hours) + "h" : "");
+    const int64_t poll_ms = std::chrono::duration_cast<std::chrono::milliseconds>(poll_interval).count();
+
+    // leave room for ~16 connection events per poll, so even a fragmented frame
+    // completes early in the poll period. No peripheral latency, the BMS should
+    // see our request at the very next event.
+    return ConnParams{
+        .min_interval = 6, // 7.5ms
+        .max_interval = static_cast<uint16_t>(std::clamp<int64_t>(poll_ms * 4 / 5 / 16, 6, 24)),
+        .latency = 0,
+        .timeout = static_cast<uint16_t>(std::clamp<int64_t>(poll_ms * 4 / 10, 100, 3200)),
+    };
 }
 
 bool AntBms::send_(uint8_t function, uint16_t address, uint8_t value, bool authenticate)
@@ -111,122 +153,39 @@ bool AntBms::send_(uint8_t function, uint16_t address, uint8_t value, bool authe
         authenticate_();
     }
 
-    uint8_t frame[10];
-    frame[0] = 0x7e;          // header
-    frame[1] = 0xa1;          // header
-    frame[2] = function;      // control
-    frame[3] = address >> 0;  // address
-    frame[4] = address >> 8;  // address
-    frame[5] = value;         // value
-    auto crc = helpers::crc16(frame + 1, 5);
-    frame[6] = crc >> 0;  // CRC
-    frame[7] = crc >> 8;  // CRC
-    frame[8] = 0xaa;      // footer
-    frame[9] = 0x55;      // footer
-
-    ESP_LOGV(TAG, "Send command: %s", format_hex_pretty(frame, sizeof(frame)).c_str());
-
-    if (m_ble_characteristic)
-    {
-        if (m_ble_characteristic->canWrite())
-        {
-            if (m_ble_characteristic->writeValue(frame, sizeof(frame), false))
-            {
-                ESP_LOGI(TAG, "Write successful");
-                return true;
-            }
-            else
-            {
-                ESP_LOGW(TAG, "Write failed");
-            }
-        }
-        else
-        {
-            ESP_LOGW(TAG, "Characteristic cannot be written");
-        }
-    }
-    else
-    {
-        ESP_LOGW(TAG, "Characteristic not found");
-    }
-
-    return false;
+    return write_frame_(make_frame(function, address, value));
 }
 
 bool AntBms::authenticate_()
 {
-    uint8_t frame[22];
-
-    frame[0] = 0x7e;   // header
-    frame[1] = 0xa1;   // header
-    frame[2] = 0x23;   // control
-    frame[3] = 0x6a;   // address
-    frame[4] = 0x01;   // address
-    frame[5] = 0x0c;   // data len
-    frame[6] = 0x31;   // 1
-    frame[7] = 0x32;   // 2
-    frame[8] = 0x33;   // 3
-    frame[9] = 0x34;   // 4
-    frame[10] = 0x35;  // 5
-    frame[11] = 0x36;  // 6
-    frame[12] = 0x37;  // 7
-    frame[13] = 0x38;  // 8
-    frame[14] = 0x39;  // 9
-    frame[15] = 0x61;  // a
-    frame[16] = 0x62;  // b
-    frame[17] = 0x63;  // c
-
-    auto crc = helpers::crc16(frame + 1, 17);
-    frame[18] = crc >> 0;  // CRC
-    frame[19] = crc >> 8;  // CRC
-
-    frame[20] = 0xaa;
-    frame[21] = 0x55;
-
-    ESP_LOGV(TAG, "Send command: %s", format_hex_pretty(frame, sizeof(frame)).c_str());
+    return write_frame_(AUTHENTICATE_FRAME);
+}
 
-    if (m_ble_characteristic)
-    {
-        if (m_ble_characteristic->canWrite())
-        {
-            if (m_ble_characteristic->writeValue(frame, sizeof(frame), false))
-            {
-                ESP_LOGI(TAG, "Write successful");
-                return true;
-            }
-            else
-            {
-                ESP_LOGW(TAG, "Write failed");
-            }
-        }
-        else
-        {
-            ESP_LOGW(TAG, "Characteristic cannot be written");
-        }
-    }
-    else
+bool AntBms::authenticate_variable_(const uint8_t *data, uint8_t data_length)
+{
+    using PasswordFrame = VariableFrame<ANT_MAX_PASSWORD_SIZE>;
+
+    const std::span<const uint8_t> password{data, data_length};
+    if (!PasswordFrame::fits(password))
     {
-        ESP_LOGW(TAG, "Characteristic not found");
+        ESP_LOGW(TAG, "Password too long (%d>%d)", data_length, ANT_MAX_PASSWORD_SIZE);
+        return false;
     }
 
-    return false;
+    return write_frame_(PasswordFrame{ANT_COMMAND_AUTHENTICATE, ANT_ADDRESS_PASSWORD, password});
 }
 
-bool AntBms::authenticate_variable_(const uint8_t *data, uint8_t data_length)
+bool AntBms::write_frame_(std::span<const uint8_t> frame)
 {
-    std::vector<uint8_t> frame = {0x7E, 0xA1, 0x23, 0x6A, 0x01};
-    frame.push_back(data_length);
-    for (int i = 0; i < data_length; i++)
+    ESP_LOGV(TAG, "Send command: %s", format_hex_pretty(frame.data(), frame.size()).c_str());
+
+    m_capture.record(CaptureEvent::Write, esp_timer_get_time(), frame);
+
+    if (m_emulator)
     {
-        frame.push_back(data[i]);
+        m_emulator->write(frame, esp_timer_get_time());
+        return true;
     }
-    auto crc = helpers::crc16(frame.data() + 1, frame.size());
-    frame.push_back(crc >> 0);
-    frame.push_back(crc >> 8);
-    frame.push_back(0xAA);
-    frame.push_back(0x55);
-
-    ESP_LOGV(TAG, "Send command: %s", format_hex_pretty(&frame.front(), frame.size()).c_str());
 
     if (m_ble_characteristic)
     {
@@ -252,11 +211,10 @@ bool AntBms::authenticate_variable_(const uint8_t *data, uint8_t data_length)
         ESP_LOGW(TAG, "Characteristic not found");
     }
 
-
     return false;
 }
 
-void AntBms::on_ant_bms_ble_data_(const uint8_t &function, const std::vector<uint8_t> &data)
+void AntBms::on_ant_bms_ble_data_(const uint8_t &function, std::span<const uint8_t> data)
 {
     switch (function)
     {
@@ -264,195 +222,72 @@ void AntBms::on_ant_bms_ble_data_(const uint8_t &function, const std::vector<uin
         on_status_data_(data);
         break;
     case ANT_FRAME_TYPE_DEVICE_INFO:
-        on_device_info_data_(data);
+        on_register_data_(data);
         break;
     default:
-        ESP_LOGW(TAG, "Unhandled response received (function 0x%02X): %s", function, format_hex_pretty(data).c_str());
+        ESP_LOGW(TAG, "Unhandled response received (function 0x%02X): %s", function,
+                 format_hex_pretty(data.data(), data.size()).c_str());
     }
 }
 
-void AntBms::on_status_data_(const std::vector<uint8_t> &data)
+void AntBms::on_status_data_(std::span<const uint8_t> data)
 {
-    auto ant_get_16bit = [&](size_t i) -> uint16_t {
-        return (uint16_t(data[i + 1]) << 8) | (uint16_t(data[i + 0]) << 0);
-    };
-    auto ant_get_32bit = [&](size_t i) -> uint32_t {
-        return (uint32_t(ant_get_16bit(i + 2)) << 16) | (uint32_t(ant_get_16bit(i + 0)) << 0);
-    };
-
     ESP_LOGD(TAG, "Status frame (%d bytes):", data.size());
 
-    if (data.size() != (6 + data[5] + 4))
+    if (const auto valid = validate_status_frame(data); !valid)
     {
-        ESP_LOGW(TAG, "Skipping status frame because of invalid length");
+        ESP_LOGW(TAG, "Skipping status frame: %s", valid.error().c_str());
+        m_invalid_frames++;
         return;
     }
 
-    // Status request
-    // -> 0x7e 0xa1 0x01 0x00 0x00 0xbe 0x18 0x55 0xaa 0x55
-    //
-    // Status response
-    //
-    // Byte Len Payload     Description                      Unit  Precision
-    //   0   2  0x7E 0xA1   Start of frame
-    //   2   1  0x11        Function
-    //   3   2  0x00 0x00   Address
-    //   5   1  0x8E        Data length
-    //   6   1  0x05        Permissions
-    ESP_LOGV(TAG, "  Permissions: %d", data[6]);
-
-    //   7   1  0x01        Battery status (0: Unknown, 1: Idle, 2: Charge, 3: Discharge, 4: Standby, 5: Error)
-    ESP_LOGV(TAG, "  Battery status: %d", data[7]);
-    m_bmsData.battery_status = static_cast<BatteryStatus>(data[7]);
-
-    //   8   1  0x04        Number of temperature sensors       max 4.
-    uint8_t temperature_sensors = data[8];
-    ESP_LOGV(TAG, "  Number of temperature sensors: %d", temperature_sensors);
-
-    //   9   1  0x0E        Number of cells (14)                max 32
-    uint8_t cells = data[9];
+    m_bmsData.timestamp_us = espnow::time_sync().to_synced(m_assembler.frame_start_us()).value_or(0);
 
-    //  10   8  0x02 0x00 0x00 0x00 0x00 0x00 0x00 0x00   Protection bitmask
-    //  18   8  0x00 0x00 0x00 0x01 0x00 0x00 0x00 0x00   Warning bitmask
-    //  26   8  0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00   Balancing? bitmask
-
-    //  34   2  0x11 0x10   Cell voltage 1             uint16_t
-    //  36   2  0x11 0x10   Cell voltage 2
-    //  38   2  0x11 0x10   Cell voltage 3
-    //  40   2  0x11 0x10   Cell voltage 4
-    //  42   2  0x11 0x10   Cell voltage 5
-    //  44   2  0x11 0x10   Cell voltage 6
-    //  46   2  0x11 0x10   Cell voltage 7
-    //  48   2  0x11 0x10   Cell voltage 8
-    //  50   2  0x11 0x10   Cell voltage 9
-    //  52   2  0x11 0x10   Cell voltage 10
-    //  54   2  0x11 0x10   Cell voltage 11
-    //  56   2  0x11 0x10   Cell voltage 12
-    //  58   2  0x11 0x10   Cell voltage 13
-    //  60   2  0x11 0x10   Cell voltage 14            uint16_t
-    m_bmsData.cell_voltages.clear();
-    for (uint8_t i = 0; i < cells; i++)
+    // byte for byte the same frame as last time, nothing to decode. The sample still counts,
+    // analytics integrate over time and batches are timestamped.
+    if (std::ranges::equal(data, m_last_status_frame))
     {
-        m_bmsData.cell_voltages.push_back(ant_get_16bit(i * 2 + 34) * 0.001f);
+        m_unchanged_frames++;
     }
-
-    uint8_t offset = cells * 2;
-
-    //  62   2  0x1C 0x00   Temperature sensor 1        int16_t
-    //  64   2  0x1C 0x00   Temperature sensor 2        int16_t
-    //  66   2  0xD8 0xFF   Temperature sensor 3        int16_t
-    //  68   2  0x1C 0x00   Temperature sensor 4        int16_t
-    //  70   2  0x1C 0x00   Mosfet temperature          int16_t
-    //  72   2  0x1C 0x00   Balancer temperature        int16_t
-    m_bmsData.temperatures.clear();
-    for (uint8_t i = 0; i < temperature_sensors; i++)
+    else
     {
-        m_bmsData.temperatures.push_back(((int16_t) ant_get_16bit(i * 2 + 34 + offset)) * 1.0f);
-    }
-
-    offset = offset + (temperature_sensors * 2);
-    //  70   2  0x1C 0x00   Mosfet temperature          int16_t
-    m_bmsData.mosfet_temperature = ((int16_t) ant_get_16bit(34 + offset)) * 1.0f;
-
-    //  72   2  0x1C 0x00   Balancer temperature        int16_t
-    m_bmsData.balancer_temperature = ((int16_t) ant_get_16bit(36 + offset)) * 1.0f;
-
-    //  74   2  0x7E 0x16   Total voltage              uint16_t
-    m_bmsData.total_voltage = ant_get_16bit(38 + offset) * 0.01f;
-
-    //  76   2  0x00 0x00   Current                     int16_t
-    m_bmsData.current = ((int16_t) ant_get_16bit(40 + offset)) * 0.1f;
-
-    //  78   2  0x60 0x00   State of charge            uint16_t
-    m_bmsData.state_of_charge = ((int16_t) ant_get_16bit(42 + offset)) * 1.0f;
-
-    //  80   2  0x64 0x00   State of health            uint16_t
-    //ESP_LOGI(TAG, "  State of health: %.0f %%", ant_get_16bit(44 + offset) * 1.0f);
-    m_bmsData.state_of_health = ((int16_t) ant_get_16bit(44 + offset)) * 1.0f;
-
-
-    //  82   1  0x01        Charge MOS status
-    uint8_t raw_charge_mosfet_status = data[46 + offset];
-    m_bmsData.charge_mosfet_status = static_cast<ChargeMosfetStatus>(raw_charge_mosfet_status);
-    m_bmsData.charge_mosfet_status_string = CHARGE_MOSFET_STATUS[raw_charge_mosfet_status];
-
-    //  83   1  0x02        Discharge MOS status
-    uint8_t raw_discharge_mosfet_status = data[47 + offset];
-    m_bmsData.discharge_mosfet_status = static_cast<DischargeMosfetStatus>(raw_discharge_mosfet_status);
-    m_bmsData.discharge_mosfet_status_string = DISCHARGE_MOSFET_STATUS[raw_discharge_mosfet_status];
-
-    //  84   1  0x00        Balancer status
-    uint8_t raw_balancer_status = data[48 + offset];
-    m_bmsData.balancer_status = static_cast<BalancerStatus>(raw_balancer_status);
-    m_bmsData.balancer_status_string = BALANCER_STATUS[raw_balancer_status];
-
-    //  85   1  0x00        Reserved
-    //  86   4  0x80 0xC3 0xC9 0x01    Battery capacity            uint32_t
-    m_bmsData.total_battery_capacity_setting = ant_get_32bit(50 + offset) * 0.000001f;
-
-    //  90   4  0x4F 0x55 0xB3 0x01    Battery capacity remaining  uint32_t
-    m_bmsData.capacity_remaining = ant_get_32bit(54 + offset) * 0.000001f;
-
-    //  94   4  0x08 0x53 0x00 0x00    Total battery cycles capacity     uint32_t
-    m_bmsData.battery_cycle_capacity = ant_get_32bit(58 + offset) * 0.001f;
-
-    //  98   4  0x00 0x00 0x00 0x00    Power
-    m_bmsData.power = ((int32_t) ant_get_32bit(62 + offset)) * 1.0f;
-
+        m_last_status_frame.assign(data.begin(), data.end());
 
-    // 102   4  0x6B 0x28 0x12 0x00    Total runtime
-    m_bmsData.total_runtime = ant_get_32bit(66 + offset);
-    m_bmsData.total_runtime_formatted = format_total_runtime_(ant_get_32bit(66 + offset));
-
-    // 106   4  0x00 0x00 0x00 0x00    Balanced cell bitmask
-    m_bmsData.balanced_cell_bitmask = ant_get_32bit(70 + offset);
-
-    // 110   2  0x11 0x10              Maximum cell voltage
-    m_bmsData.max_cell_voltage = ant_get_16bit(74 + offset) * 0.001f;
-
-    // 112   2  0x01 0x00              Maximum voltage cell
-    m_bmsData.max_voltage_cell = ant_get_16bit(76 + offset) * 1.0f;
-
-    // 114   2  0x11 0x10              Minimum cell voltage
-    m_bmsData.min_cell_voltage = ant_get_16bit(78 + offset) * 0.001f;
-
-    // 116   2  0x01 0x00              Minimum voltage cell
-    m_bmsData.min_voltage_cell = ant_get_16bit(80 + offset) * 1.0f;
-
-    // 118   2  0x00 0x00              Delta cell voltage
-    m_bmsData.delta_cell_voltage = ant_get_16bit(82 + offset) * 0.001f;
-
-    // 120   2  0x11 0x10              Average cell voltage
-    m_bmsData.average_cell_voltage = ant_get_16bit(84 + offset) * 0.001f;
+        const auto decode_start = esp_timer_get_time();
+        decode_status_frame(data, m_bmsData);
+        m_decode_stats.add(esp_timer_get_time() - decode_start);
+    }
 
-    // 122   2  0x02 0x00              Discharge MOSFET, voltage between D-S
-    // 124   2  0x70 0x00              Drive voltage (discharge MOSFET)
-    // 126   2  0x03 0x00              Drive voltage (charge MOSFET)
-    // 128   2  0xAC 0x02              F40com
-    // 130   2  0xF1 0xFA              Battery type (0xfaf1: Ternary Lithium, 0xfaf2: Lithium Iron Phosphate,
-    //                                               0xfaf3: Lithium Titanate, 0xfaf4: Custom)
-    // 132   4  0x7D 0x2E 0x00 0x00    Accumulated discharging capacity
-    m_bmsData.accumulated_discharging_capacity = ant_get_32bit(96 + offset) * 0.001f;
+    const auto analytics_start = esp_timer_get_time();
+    m_analytics.update(m_bmsData, analytics_start);
+    m_analytics_stats.add(esp_timer_get_time() - analytics_start);
 
-    // 136   4  0x94 0x77 0x00 0x00    Accumulated charging capacity
-    m_bmsData.accumulated_charging_capacity = ant_get_32bit(100 + offset) * 0.001f;
+    // alarms skip the telemetry schedule, wake the main loop to send them right away
+    if (m_alarms.evaluate(m_bmsData, esp_timer_get_time()) && m_loop_task)
+    {
+        xTaskNotifyGive(m_loop_task);
+    }
 
-    // 140   4  0xDE 0x07 0x00 0x00    Accumulated discharging time
-    m_bmsData.accumulated_discharging_time = ant_get_32bit(104 + offset);
-    m_bmsData.accumulated_discharging_time_formatted = format_total_runtime_(ant_get_32bit(104 + offset));
+    m_dirty.update(m_bmsData);
 
-    // 144   4  0x77 0x76 0x00 0x00    Accumulated charging time
-    m_bmsData.accumulated_charging_time = ant_get_32bit(108 + offset);
-    m_bmsData.accumulated_charging_time_formatted = format_total_runtime_(ant_get_32bit(108 + offset));
+    m_batcher.add(CompactSample::from(m_bmsData, espchrono::millis_clock::now(), m_assembler.frame_start_us()));
 
-    // 148   2  0x35 0xE2              CRC
-    // 150   2  0xAA 0x55              End of frame
+    if (m_sample_handler)
+    {
+        m_sample_handler(m_bmsData, m_assembler.frame_start_us());
+    }
 }
 
-void AntBms::on_device_info_data_(const std::vector<uint8_t> &data)
+void AntBms::on_device_info_data_(std::span<const uint8_t> data)
 {
     ESP_LOGI(TAG, "Device info frame (%d bytes):", data.size());
 
+    if (data.size() < DEVICE_INFO_MIN_SIZE)
+    {
+        ESP_LOGW(TAG, "Skipping device info frame because it is too short");
+        return;
+    }
+
     // Status request
     // -> 0x7e 0xa1 0x02 0x6c 0x02 0x20 0x58 0xc4 0xaa 0x55
     //
@@ -468,6 +303,7 @@ void AntBms::on_device_info_data_(const std::vector<uint8_t> &data)
 
     //  22  16  0x31 0x36 0x5A 0x4D 0x55 0x42 0x30 0x30 0x2D 0x32 0x31 0x31 0x30 0x32 0x36 0x41    Software version
     m_bmsData.software_version = std::string(data.begin() + 22, data.begin() + 22 + 16);
+    m_dirty.mark(field_mask(Field::HardwareVersion, Field::SoftwareVersion), m_bmsData);
 
     //  38   2  0x72 0x08   CRC
     //  40   1  0xFF        Reserved
@@ -478,65 +314,92 @@ void AntBms::on_device_info_data_(const std::vector<uint8_t> &data)
     //  46   2  0xAA 0x55   End of frame
 }
 
-void AntBms::assemble(const uint8_t *data, uint8_t data_length)
+void AntBms::on_register_data_(std::span<const uint8_t> data)
 {
-    if (m_frame_buffer.size() > MAX_RESPONSE_SIZE)
+    // Register read response
+    //
+    // Byte Len Payload     Description
+    //   0   2  0x7E 0xA1   Start of frame
+    //   2   1  0x12        Function
+    //   3   2  0x00 0x01   Address of the first register
+    //   5   1  0x80        Number of registers
+    //   6   n  ...         One byte per register
+    //
+    // assemble() made sure the frame holds at least as many bytes as announced
+    const uint16_t address = uint16_t(data[4]) << 8 | data[3];
+    m_mirror.fill(address, data.subspan(ANT_FRAME_HEADER_SIZE, data[5]), esp_timer_get_time());
+
+    if (address == ANT_ADDRESS_DEVICE_INFO)
     {
-        ESP_LOGW(TAG, "Maximum response size (%d bytes) exceeded", m_frame_buffer.size());
-        m_frame_buffer.clear();
+        on_device_info_data_(data);
     }
+}
 
-    // Flush buffer on every preamble
-    if (data[0] == ANT_PKT_START_1 && data[1] == ANT_PKT_START_2)
+void AntBms::assemble(const uint8_t *data, uint8_t data_length)
+{
+    const auto frame = m_assembler.feed({data, data_length}, esp_timer_get_time());
+    if (!frame)
     {
-        m_frame_buffer.clear();
+        return;
     }
 
-    m_frame_buffer.insert(m_frame_buffer.end(), data, data + data_length);
+    m_supervisor.frame_received(esp_timer_get_time());
+    m_link_stats.frame_completed(m_assembler.frame_notifications());
 
-    if (m_frame_buffer.back() == ANT_PKT_END_2)
+    const uint8_t function = (*frame)[2];
+    if (function == ANT_FRAME_TYPE_STATUS)
     {
-        const uint8_t *raw = &m_frame_buffer[0];
-
-        uint8_t function = raw[2];
-        uint16_t data_len = raw[5];
-        uint16_t frame_len = 6 + data_len + 4;
-        // It looks like the data_len value of the device info frame is wrong
-        if (frame_len != m_frame_buffer.size() && function != ANT_FRAME_TYPE_DEVICE_INFO)
-        {
-            ESP_LOGW(TAG, "Invalid frame length");
-            m_frame_buffer.clear();
-            return;
-        }
+        m_status_requests.response_received(esp_timer_get_time());
 
-        uint16_t computed_crc = helpers::crc16(raw + 1, frame_len - 5);
-        uint16_t remote_crc = uint16_t(raw[frame_len - 3]) << 8 | (uint16_t(raw[frame_len - 4]) << 0);
-        if (computed_crc != remote_crc)
+        if (m_loop_task)
         {
-            ESP_LOGW(TAG, "CRC Check failed! %04X != %04X", computed_crc, remote_crc);
-            m_frame_buffer.clear();
-            return;
+            xTaskNotifyGive(m_loop_task);
         }
-
-        std::vector<uint8_t> assembled_data(m_frame_buffer.begin(), m_frame_buffer.end());
-
-        on_ant_bms_ble_data_(function, assembled_data);
-        m_frame_buffer.clear();
     }
+
+    on_ant_bms_ble_data_(function, *frame);
 }
 
 void AntBms::write_register(uint16_t address, uint8_t value)
 {
+    // read back once written, the BMS may have refused or clamped the value
+    m_mirror.invalidate(address);
     send_(ANT_COMMAND_WRITE_REGISTER, address, value, true);
 }
 
 void AntBms::update()
+{
+    const auto start = esp_timer_get_time();
+    update_();
+    m_update_stats.add(esp_timer_get_time() - start);
+}
+
+void AntBms::update_()
 {
     ESP_LOGD(TAG, "update() called");
 
+    send_alarms_();
+    pump_replay_();
+
     switch (m_ble_state)
     {
     case BleState::BLE_IDLE:
+        if (m_emulator)
+        {
+            ESP_LOGI(TAG, "Using emulated BMS (%d cells, %d sensors, mtu %d, loss %.2f)", m_emulator->config().cells,
+                     m_emulator->config().temperature_sensors, m_emulator->config().mtu,
+                     m_emulator->config().loss_rate);
+
+            reset_link_state_();
+            m_mtu = m_emulator->config().mtu;
+            m_ble_state = BleState::BLE_CONNECTED;
+            m_supervisor.connected(esp_timer_get_time());
+            m_capture.record(CaptureEvent::Connected, esp_timer_get_time(), to_le16(m_mtu));
+
+            write_frame_(DEVICE_INFO_REQUEST_FRAME);
+            break;
+        }
+
         if (NimBLEDevice::getInitialized())
         {
             ESP_LOGW(TAG, "BLE device initialized?!?");
@@ -548,6 +411,12 @@ void AntBms::update()
 
         NimBLEDevice::setPower(ESP_PWR_LVL_P9);
 
+        // ask for the largest MTU, the exchange happens on every connect
+        if (auto err = NimBLEDevice::setMTU(BLE_ATT_MTU_MAX); err != 0)
+        {
+            ESP_LOGW(TAG, "Failed to set preferred MTU %d: %d", BLE_ATT_MTU_MAX, err);
+        }
+
         m_ble_scan = NimBLEDevice::getScan();
 
         m_ble_scan->setScanCallbacks(&m_on_scan_results, false);
@@ -556,158 +425,1077 @@ void AntBms::update()
         m_ble_scan->setWindow(99);
 
         m_ble_scan->setActiveScan(true);
-        m_ble_scan->start(0, false);
 
-        m_ble_state = BleState::BLE_SCANNING;
+        start_scan_();
         break;
     case BleState::BLE_SCANNING:
     {
-        if (m_ble_devices.empty())
+        if (m_ble_devices.empty() || !m_supervisor.may_connect(esp_timer_get_time()))
         {
             return;
         }
 
-        auto &first_element = m_ble_devices[0];
+        const auto address = m_ble_devices.front()->getAddress();
 
-        ble_connect(first_element->getAddress());
+        // the scan would only compete with the connection for air time
+        m_ble_scan->stop();
+        ble_connect(address);
         break;
     }
     case BleState::BLE_CONNECTING:
-        m_ble_state = BleState::BLE_SCANNING;
+        // the NimBLE host task reports the outcome through onConnect() / onConnectFail()
+        switch (m_link_event.exchange(LinkEvent::None))
+        {
+        case LinkEvent::Connected:
+            ESP_LOGI(TAG, "Connected to %s in %lldms", m_ble_client->getPeerAddress().toString().c_str(),
+                     (esp_timer_get_time() - m_connect_start_us) / 1000);
+            start_discovery_();
+            break;
+        case LinkEvent::ConnectFailed:
+            connect_failed_(m_link_error);
+            break;
+        default:;
+        }
+        break;
+    case BleState::BLE_DISCOVERING:
+        switch (m_link_event.exchange(LinkEvent::None))
+        {
+        case LinkEvent::Subscribed:
+            subscribed_();
+            break;
+        case LinkEvent::DiscoveryFailed:
+            // the link is useless without the characteristic, counts as a failed attempt
+            m_ble_client->disconnect();
+            m_supervisor.connect_failed(esp_timer_get_time());
+            m_ble_state = BLE_BACKOFF;
+            break;
+        default:;
+        }
+        break;
+    case BleState::BLE_BACKOFF:
+        // a link we dropped ourselves takes a moment to tear down
+        if (!m_supervisor.may_connect(esp_timer_get_time()) || (m_ble_client && m_ble_client->isConnected()))
+        {
+            return;
+        }
+
+        if (m_emulator)
+        {
+            m_ble_state = BleState::BLE_IDLE;
+        }
+        // the BMS does not move, only rescan once its address stopped working
+        else if (m_bms_address && m_supervisor.failures_in_row() <= RESCAN_AFTER_FAILURES)
+        {
+            ble_connect(*m_bms_address);
+        }
+        else
+        {
+            m_bms_address.reset();
+            start_scan_();
+        }
         break;
     case BleState::BLE_CONNECTED:
-        if (espchrono::ago(m_last_update) > m_interval)
+        if (!m_emulator && !(m_ble_client && m_ble_client->isConnected()))
         {
-            m_last_update = espchrono::millis_clock::now();
-            send_(ANT_COMMAND_STATUS, 0x0000, 0xbe, false);
+            ESP_LOGW(TAG, "Connection lost");
+            // a BMS may accept the connection and drop it again over the parameters
+            fall_back_on_rejection_(m_link_error);
+            link_lost_(ConnectionSupervisor::Loss::Disconnected);
+            break;
         }
 
-        if (espchrono::ago(m_last_wireless_update) > m_wireless_interval)
+        if (m_supervisor.poll(esp_timer_get_time()))
         {
-            m_last_wireless_update = espchrono::millis_clock::now();
+            ESP_LOGW(TAG, "No valid frame for %lldms, reconnecting",
+                     m_supervisor.silent_us(esp_timer_get_time()) / 1000);
+            link_lost_(ConnectionSupervisor::Loss::Stalled);
+            break;
+        }
 
-            static bool flip = false;
-            ESP_LOGI(TAG, "[APP] Free memory: %ld bytes", esp_get_free_heap_size());
+        if (m_emulator)
+        {
+            m_emulator->poll(esp_timer_get_time(), [this](const uint8_t *data, size_t length) {
+                on_notification_(data, length);
+            });
+        }
 
-            if (flip)
-            {
-                if (!espnow::send(espnow::broadcast_address, m_bmsData.toString()))
-                {
-                    ESP_LOGE(TAG, "Failed to send data over ESP-NOW");
-                }
-            }
-            else
+        // the BMS answers one request at a time, status polls and register reads take turns
+        if (const auto now = esp_timer_get_time(); m_status_requests.poll(now) && !m_mirror.in_flight(now))
+        {
+            m_last_update = espchrono::millis_clock::now();
+            m_status_requests.request_sent(now);
+            write_frame_(STATUS_REQUEST_FRAME);
+        }
+
+        if (!m_status_requests.in_flight())
+        {
+            if (const auto range = m_mirror.next_read(esp_timer_get_time()))
             {
-                if (!espnow::send(espnow::broadcast_address, m_bmsData.toRareString()))
-                {
-                    ESP_LOGE(TAG, "Failed to send data over ESP-NOW");
-                }
+                write_frame_(make_frame(ANT_COMMAND_READ_REGISTERS, range->address, range->length));
             }
-            flip = !flip;
         }
+
+        if (espchrono::ago(m_last_link_stats) > m_link_stats_interval)
+        {
+            m_last_link_stats = espchrono::millis_clock::now();
+            log_link_stats_();
+        }
+
+        if (espchrono::ago(m_last_wireless_update) > m_wireless_interval)
+        {
+            m_last_wireless_update = espchrono::millis_clock::now();
+
+            send_telemetry_slot_();
+        }
+
+        send_batches_();
+
+        send_subscriptions_();
         break;
     default:;
     }
 }
 
-AntBms::AntBms() : m_on_scan_results{*this}, m_on_client_events{*this}, m_characteristics_callbacks{*this}
-{}
-
-void AntBms::ble_connect(NimBLEAddress address)
+espchrono::millis_clock::time_point AntBms::next_wakeup() const
 {
-    m_ble_state = BleState::BLE_CONNECTING;
+    const auto now = espchrono::millis_clock::now();
+    const auto now_us = esp_timer_get_time();
+    const auto at_us = [&](int64_t time_us) {
+        return now + std::chrono::ceil<espchrono::millis_clock::duration>(std::chrono::microseconds{time_us - now_us});
+    };
 
-    if (m_ble_client)
+    if (m_ble_state == BleState::BLE_BACKOFF)
     {
-        m_ble_client->disconnect();
+        return at_us(m_supervisor.next_attempt_us());
+    }
 
-        m_ble_client = nullptr;
+    if (m_ble_state != BleState::BLE_CONNECTED)
+    {
+        return now;
     }
 
-    m_ble_client = NimBLEDevice::createClient();
+    auto next = std::min(m_last_link_stats + m_link_stats_interval, at_us(m_status_requests.next_poll_us()));
 
-    m_ble_client->setClientCallbacks(&m_on_client_events, false);
+    // slots only open every wireless interval
+    const auto slot = m_last_wireless_update + m_wireless_interval;
+    next = std::min(next, std::max(slot, m_scheduler.next_due().value_or(slot)));
 
-    if (m_ble_client->connect(address))
+    for (const auto due : {m_batcher.deadline(), m_peers.next_due()})
     {
-        m_ble_state = BLE_CONNECTED;
-
-        ESP_LOGI(TAG, "Successfuly connected to %s", address.toString().c_str());
-
-        // add notify callback to ANT_BMS_CHARACTERISTIC_UUID
-        if (auto *service = m_ble_client->getService(ANT_BMS_SERVICE_UUID); service)
+        if (due)
         {
-            if (auto *characteristic = service->getCharacteristic(ANT_BMS_CHARACTERISTIC_UUID); characteristic)
-            {
-                if (characteristic->canNotify())
-                {
-                    if (characteristic->subscribe(true, [&](NimBLERemoteCharacteristic *pBLERemoteCharacteristic,
-                                                            uint8_t *pData, size_t length, bool isNotify) {
-                        m_notifyCallback(pBLERemoteCharacteristic, pData, length, isNotify);
-                    }))
-                    {
-                        ESP_LOGI(TAG, "Subscribed to %s", characteristic->toString().c_str());
-                        m_ble_characteristic = characteristic;
-                    }
-                    else
-                    {
-                        ESP_LOGW(TAG, "Failed to subscribe to %s", characteristic->toString().c_str());
-                    }
-                }
-                else
-                {
-                    ESP_LOGW(TAG, "Characteristic %s does not support notify", characteristic->toString().c_str());
-                }
-            }
-            else
-            {
-                ESP_LOGI(TAG, "Failed to get characteristic %s",
-                         NimBLEUUID{ANT_BMS_CHARACTERISTIC_UUID}.toString().c_str());
-            }
-        }
-        else
-        {
-            ESP_LOGI(TAG, "Failed to get service %s",
-                     NimBLEUUID{ANT_BMS_SERVICE_UUID}.toString().c_str());
+            next = std::min(next, *due);
         }
     }
-    else
+
+    if (const auto due_us = m_mirror.next_due_us())
+    {
+        next = std::min(next, at_us(*due_us));
+    }
+
+    if (m_emulator)
     {
-        ESP_LOGW(TAG, "Error connecting to %s", address.toString().c_str());
+        if (const auto due_us = m_emulator->next_due_us())
+        {
+            next = std::min(next, at_us(*due_us));
+        }
     }
+
+    return next;
 }
 
-void AntBms::m_notifyCallback(NimBLERemoteCharacteristic *pBLERemoteCharacteristic, uint8_t *pData, size_t length,
-                              bool isNotify)
+bool AntBms::busy() const
 {
-    // ESP_LOGI(TAG, "Received %s: %s (%.*s)", isNotify ? "notification" : "indication", format_hex_pretty(pData, length).c_str(), length, pData);
-
-    assemble(pData, length);
+    return (m_ble_state != BleState::BLE_CONNECTED && m_ble_state != BleState::BLE_BACKOFF) || m_alarms.has_pending();
 }
 
-void AntBms::OnScanResults::onDiscovered(NimBLEAdvertisedDevice *advertised_device)
+AntBms::AntBms() : m_loop_task{xTaskGetCurrentTaskHandle()}, m_on_scan_results{*this}, m_on_client_events{*this},
+                   m_characteristics_callbacks{*this}
 {
-    // check if ANT_BMS_SERVICE_UUID
-    if (!advertised_device->haveServiceUUID())
-    {
-        ESP_LOGW(TAG, "[onDiscovered] Found BLE device without service UUIDs: %s",
-                 advertised_device->toString().c_str());
-        return;
-    }
+    espnow::on_message("ACK", [this](const uint8_t *mac_addr, std::string_view content) {
+        uint16_t seq;
+        if (const auto [ptr, ec] = std::from_chars(content.data(), content.data() + content.size(), seq); ec != std::errc{})
+        {
+            ESP_LOGW(TAG, "Invalid alarm acknowledge: %.*s", content.size(), content.data());
+            return;
+        }
 
-    if (!advertised_device->isAdvertisingService(ANT_BMS_SERVICE_UUID))
-    {
-        ESP_LOGW(TAG, "[onDiscovered] Found BLE device without MATCHING service UUID: %s",
-                 advertised_device->toString().c_str());
-        return;
-    }
+        m_alarms.acknowledge(seq);
+    });
 
-    m_ant_bms.m_ble_devices.push_back(advertised_device);
-}
+    // "RATE:<group>=<period ms>" retunes a telemetry group at runtime
+    espnow::on_message("RATE", [this](const uint8_t *mac_addr, std::string_view content) {
+        const auto sep = content.find('=');
+        uint32_t period_ms;
+        if (sep == std::string_view::npos ||
+            std::from_chars(content.data() + sep + 1, content.data() + content.size(), period_ms).ec != std::errc{})
+        {
+            ESP_LOGW(TAG, "Invalid rate request: %.*s", content.size(), content.data());
+            return;
+        }
 
-void AntBms::OnClientCallback::onDisconnect(NimBLEClient *pClient, int reason)
+        if (!set_telemetry_period(content.substr(0, sep), std::chrono::milliseconds{period_ms}))
+        {
+            ESP_LOGW(TAG, "Unknown telemetry group: %.*s", sep, content.data());
+        }
+    });
+
+    // "BATCH:<latency budget ms>", 0 sends telemetry unbatched again
+    espnow::on_message("BATCH", [this](const uint8_t *mac_addr, std::string_view content) {
+        uint32_t budget_ms;
+        if (std::from_chars(content.data(), content.data() + content.size(), budget_ms).ec != std::errc{})
+        {
+            ESP_LOGW(TAG, "Invalid batching request: %.*s", content.size(), content.data());
+            return;
+        }
+
+        set_batching(std::chrono::milliseconds{budget_ms});
+    });
+
+    // "SUB:<group mask hex>,<period ms>" starts or refreshes a unicast stream of the selected telemetry groups
+    espnow::on_message("SUB", [this](const uint8_t *mac_addr, std::string_view content) {
+        const auto sep = content.find(',');
+        uint32_t groups;
+        uint32_t period_ms;
+        if (sep == std::string_view::npos ||
+            std::from_chars(content.data(), content.data() + sep, groups, 16).ec != std::errc{} ||
+            std::from_chars(content.data() + sep + 1, content.data() + content.size(), period_ms).ec != std::errc{})
+        {
+            ESP_LOGW(TAG, "Invalid subscription: %.*s", content.size(), content.data());
+            return;
+        }
+
+        MacAddress mac;
+        std::copy_n(mac_addr, mac.size(), mac.begin());
+
+        const auto result = m_peers.subscribe(mac, groups, std::chrono::milliseconds{period_ms},
+                                              espchrono::millis_clock::now());
+        if (result.evicted)
+        {
+            espnow::removePeer(result.evicted->data());
+        }
+
+        if (result.added && !espnow::addPeer(mac.data()))
+        {
+            m_peers.unsubscribe(mac);
+        }
+    });
+
+    espnow::on_message("UNSUB", [this](const uint8_t *mac_addr, std::string_view content) {
+        MacAddress mac;
+        std::copy_n(mac_addr, mac.size(), mac.begin());
+
+        if (m_peers.unsubscribe(mac))
+        {
+            espnow::removePeer(mac.data());
+        }
+    });
+
+    // "REG:<address hex>,<count>" reads parameter registers from the mirror, never from the BMS itself
+    espnow::on_message("REG", [this](const uint8_t *mac_addr, std::string_view content) {
+        const auto sep = content.find(',');
+        uint16_t address;
+        size_t count;
+        if (sep == std::string_view::npos ||
+            std::from_chars(content.data(), content.data() + sep, address, 16).ec != std::errc{} ||
+            std::from_chars(content.data() + sep + 1, content.data() + content.size(), count).ec != std::errc{} ||
+            count == 0 || count > MAX_REGISTER_QUERY)
+        {
+            ESP_LOGW(TAG, "Invalid register query: %.*s", content.size(), content.data());
+            return;
+        }
+
+        std::array<uint8_t, MAX_REGISTER_QUERY> values;
+        const std::span registers{values.data(), count};
+
+        constexpr const char HEX_DIGITS[] = "0123456789abcdef";
+
+        std::array<char, ESP_NOW_MAX_DATA_LEN> reply;
+        char *out = fmt::format_to_n(reply.data(), reply.size(), "REGV:{:04x},", address).out;
+        if (m_mirror.read(address, registers))
+        {
+            for (const auto value : registers)
+            {
+                *out++ = HEX_DIGITS[value >> 4];
+                *out++ = HEX_DIGITS[value & 0xf];
+            }
+        }
+        else
+        {
+            out = std::copy_n("miss", 4, out);
+        }
+
+        // broadcast, the asking node need not be a peer
+        espnow::send(espnow::broadcast_address, std::string_view{reply.data(), size_t(out - reply.data())});
+    });
+
+    espnow::on_send_status([this](const uint8_t *mac_addr, bool success) {
+        m_peers.delivered(mac_addr, success);
+    });
+
+    // "CAP:start[=<bytes>]", "CAP:stop", "CAP:dump" or "CAP:replay[=<speed>]"
+    espnow::on_message("CAP", [this](const uint8_t *mac_addr, std::string_view content) {
+        const auto sep = content.find('=');
+        const auto command = content.substr(0, sep);
+        const auto argument = sep == std::string_view::npos ? std::string_view{} : content.substr(sep + 1);
+
+        if (command == "start")
+        {
+            size_t capacity = CAPTURE_DEFAULT_SIZE;
+            std::from_chars(argument.data(), argument.data() + argument.size(), capacity);
+            start_capture(capacity);
+            ESP_LOGI(TAG, "Capturing into %d byte ring", capacity);
+        }
+        else if (command == "stop")
+        {
+            stop_capture();
+        }
+        else if (command == "dump")
+        {
+            dump_capture();
+        }
+        else if (command == "replay")
+        {
+            float speed = 0.f;
+            std::from_chars(argument.data(), argument.data() + argument.size(), speed);
+
+            if (const auto result = start_replay(m_capture.serialize(), speed); !result)
+            {
+                ESP_LOGW(TAG, "Replay failed: %s", result.error().c_str());
+            }
+        }
+        else
+        {
+            ESP_LOGW(TAG, "Invalid capture request: %.*s", content.size(), content.data());
+        }
+    });
+}
+
+void AntBms::send_telemetry_slot_()
+{
+    const auto now = espchrono::millis_clock::now();
+
+    std::array<size_t, TelemetryScheduler::MAX_GROUPS> due;
+    const auto due_count = m_scheduler.due(now, due);
+    if (!due_count)
+    {
+        return;
+    }
+
+    const FieldMask dirty = m_dirty.start_encode(m_encode_data);
+
+    std::array<char, ESP_NOW_MAX_DATA_LEN> tx_buffer;
+    FieldMask fields = 0;
+    size_t encoded_size = 0;
+    bool buffer_valid = true;
+
+    std::array<size_t, TelemetryScheduler::MAX_GROUPS> packed;
+    size_t packed_count = 0;
+
+    const auto encode_start = esp_timer_get_time();
+
+    // greedily fill the slot with the most overdue groups that still fit
+    for (size_t i = 0; i < due_count; i++)
+    {
+        const auto index = due[i];
+        const auto &group = m_scheduler.group(index);
+
+        // only what changed, unless the group has been quiet for too long
+        auto group_fields = group.fields;
+        if (now - group.last_sent < m_max_silence)
+        {
+            group_fields &= dirty;
+        }
+
+        if (!group_fields)
+        {
+            m_scheduler.unchanged(index, now);
+            continue;
+        }
+
+        auto encoded = m_encode_data.encodeFields(tx_buffer, fields | group_fields);
+        if (!encoded && (group_fields & field_bit(Field::PackedCellVoltages)))
+        {
+            // very uneven cells pack wide, send the rest rather than nothing
+            group_fields &= ~field_bit(Field::PackedCellVoltages);
+            encoded = m_encode_data.encodeFields(tx_buffer, fields | group_fields);
+        }
+
+        if (!encoded)
+        {
+            // stays due, goes first into the next slot
+            buffer_valid = false;
+            if (!fields)
+            {
+                ESP_LOGE(TAG, "Telemetry group %s does not fit a frame: %s", group.name, encoded.error().c_str());
+            }
+            continue;
+        }
+
+        fields |= group_fields;
+        encoded_size = *encoded;
+        buffer_valid = true;
+        packed[packed_count++] = index;
+    }
+
+    if (!fields)
+    {
+        m_frames_suppressed++;
+        return;
+    }
+
+    if (!buffer_valid)
+    {
+        // the last attempt overflowed and left a partial frame behind
+        encoded_size = m_encode_data.encodeFields(tx_buffer, fields).value_or(0);
+    }
+
+    m_encode_stats.add(esp_timer_get_time() - encode_start);
+
+    if (!espnow::send(espnow::broadcast_address, std::string_view{tx_buffer.data(), encoded_size}))
+    {
+        ESP_LOGE(TAG, "Failed to send data over ESP-NOW");
+        return;
+    }
+
+    m_dirty.sent(fields);
+    for (size_t i = 0; i < packed_count; i++)
+    {
+        m_scheduler.sent(packed[i], now);
+    }
+    m_frames_sent++;
+    m_telemetry_airtime_us += espnow::airtime_us(encoded_size);
+}
+
+void AntBms::set_batching(espchrono::millis_clock::duration latency_budget)
+{
+    m_batcher.set_latency_budget(latency_budget);
+
+    espchrono::millis_clock::duration min_period{};
+    if (latency_budget.count() > 0)
+    {
+        min_period = BATCHED_FAST_PERIOD;
+    }
+    m_scheduler.set_min_period("fast", min_period);
+}
+
+void AntBms::send_batches_()
+{
+    std::array<char, ESP_NOW_MAX_DATA_LEN> tx_buffer;
+
+    while (m_batcher.due(espchrono::millis_clock::now(), tx_buffer.size()))
+    {
+        const auto size = m_batcher.flush(tx_buffer);
+        if (!size)
+        {
+            continue;
+        }
+
+        if (!espnow::send(espnow::broadcast_address, std::string_view{tx_buffer.data(), size}))
+        {
+            ESP_LOGE(TAG, "Failed to send sample batch over ESP-NOW");
+            continue;
+        }
+
+        m_batch_airtime_us += espnow::airtime_us(size);
+    }
+}
+
+void AntBms::send_subscriptions_()
+{
+    const auto now = espchrono::millis_clock::now();
+
+    if (const auto expired = m_peers.expire(now))
+    {
+        espnow::removePeer(expired->data());
+    }
+
+    std::array<Subscriber, PeerRegistry::MAX_SUBSCRIBERS> due;
+    const auto due_count = m_peers.due(now, due);
+    if (due_count)
+    {
+        m_dirty.latest(m_encode_data);
+    }
+    for (size_t i = 0; i < due_count; i++)
+    {
+        send_to_subscriber_(due[i]);
+    }
+}
+
+void AntBms::send_to_subscriber_(const Subscriber &subscriber)
+{
+    std::array<char, ESP_NOW_MAX_DATA_LEN> tx_buffer;
+    FieldMask fields = 0;
+    size_t encoded_size = 0;
+    bool buffer_valid = true;
+
+    const auto try_add = [&](FieldMask group_fields) {
+        auto encoded = m_encode_data.encodeFields(tx_buffer, fields | group_fields);
+        if (!encoded && (group_fields & field_bit(Field::PackedCellVoltages)))
+        {
+            group_fields &= ~field_bit(Field::PackedCellVoltages);
+            encoded = m_encode_data.encodeFields(tx_buffer, fields | group_fields);
+        }
+
+        buffer_valid = encoded.has_value();
+        if (encoded)
+        {
+            fields |= group_fields;
+            encoded_size = *encoded;
+        }
+        return encoded.has_value();
+    };
+
+    const auto flush = [&]() {
+        if (!fields)
+        {
+            return;
+        }
+
+        if (!buffer_valid)
+        {
+            encoded_size = m_encode_data.encodeFields(tx_buffer, fields).value_or(0);
+        }
+
+        if (espnow::send(subscriber.mac.data(), std::string_view{tx_buffer.data(), encoded_size}))
+        {
+            m_peers.sent(subscriber.mac, encoded_size, espchrono::millis_clock::now());
+        }
+
+        fields = 0;
+        buffer_valid = true;
+    };
+
+    // the whole subscription every period, split over as many frames as needed
+    const auto groups = m_scheduler.groups();
+    for (size_t i = 0; i < groups.size(); i++)
+    {
+        if (!(subscriber.groups & (uint32_t{1} << i)))
+        {
+            continue;
+        }
+
+        if (try_add(groups[i].fields))
+        {
+            continue;
+        }
+
+        flush();
+
+        if (!try_add(groups[i].fields))
+        {
+            ESP_LOGE(TAG, "Telemetry group %s does not fit a frame", groups[i].name);
+        }
+    }
+
+    flush();
+}
+
+void AntBms::send_alarms_()
+{
+    while (const auto event = m_alarms.due(esp_timer_get_time()))
+    {
+        std::array<char, ESP_NOW_MAX_DATA_LEN> tx_buffer;
+
+        const auto encoded = AlarmEngine::encode(*event, tx_buffer);
+        if (!encoded)
+        {
+            ESP_LOGE(TAG, "Failed to encode alarm: %s", encoded.error().c_str());
+            return;
+        }
+
+        if (!espnow::send(espnow::broadcast_address, std::string_view{tx_buffer.data(), *encoded}))
+        {
+            ESP_LOGE(TAG, "Failed to send alarm over ESP-NOW");
+            return;
+        }
+
+        m_alarms.transmitted(*event, esp_timer_get_time());
+    }
+}
+
+void AntBms::ble_connect(NimBLEAddress address)
+{
+    m_ble_state = BleState::BLE_CONNECTING;
+
+    // NimBLE keeps every client it ever created, one is reused for all attempts
+    if (!m_ble_client)
+    {
+        m_ble_client = NimBLEDevice::createClient();
+        m_ble_client->setClientCallbacks(&m_on_client_events, false);
+        m_clients_created++;
+    }
+
+    // always set, the reused client would otherwise keep the tuned parameters after a fallback
+    const auto params = m_use_default_conn_params ? DEFAULT_CONN_PARAMS : conn_params_for_poll_interval(m_interval);
+    m_ble_client->setConnectionParams(params.min_interval, params.max_interval, params.latency, params.timeout);
+
+    reset_link_state_();
+
+    m_link_event = LinkEvent::None;
+    m_link_error = 0;
+    m_connect_start_us = esp_timer_get_time();
+
+#ifdef BLE_BLOCKING_CONNECT
+    // the old path, only to measure the stall the asynchronous one avoids, see the "Update:" stats
+    if (!m_ble_client->connect(address, true, false))
+    {
+        connect_failed_(m_ble_client->getLastError());
+        return;
+    }
+
+    m_discovery_start_us = esp_timer_get_time();
+    m_discovered_characteristic = discover_();
+    m_link_event = m_discovered_characteristic ? LinkEvent::Subscribed : LinkEvent::DiscoveryFailed;
+    m_ble_state = BLE_DISCOVERING;
+#else
+    // returns once the request is queued, a blocking connect would stall the loop for seconds
+    if (!m_ble_client->connect(address, true, true))
+    {
+        connect_failed_(m_ble_client->getLastError());
+    }
+#endif
+}
+
+void AntBms::connect_failed_(int reason)
+{
+    ESP_LOGW(TAG, "Error connecting to %s, reason %d", m_ble_client->getPeerAddress().toString().c_str(), reason);
+
+    fall_back_on_rejection_(reason);
+
+    m_supervisor.connect_failed(esp_timer_get_time());
+    m_ble_state = BLE_BACKOFF;
+}
+
+void AntBms::fall_back_on_rejection_(int reason)
+{
+    if (!m_use_default_conn_params && conn_params_rejected(reason))
+    {
+        ESP_LOGW(TAG, "BMS rejected the connection parameters, falling back to defaults");
+        m_use_default_conn_params = true;
+    }
+}
+
+void AntBms::start_discovery_()
+{
+    m_ble_state = BLE_DISCOVERING;
+    m_discovery_start_us = esp_timer_get_time();
+
+    // getService() and subscribe() wait for GATT round trips and must not run on the NimBLE host task either
+    if (xTaskCreate(&AntBms::discovery_task, "ble_discovery", 4096, this, 5, nullptr) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed to create discovery task");
+        m_link_event = LinkEvent::DiscoveryFailed;
+    }
+}
+
+void AntBms::discovery_task(void *arg)
+{
+    auto &self = *static_cast<AntBms *>(arg);
+
+    self.m_discovered_characteristic = self.discover_();
+    self.m_link_event = self.m_discovered_characteristic ? LinkEvent::Subscribed : LinkEvent::DiscoveryFailed;
+    xTaskNotifyGive(self.m_loop_task);
+
+    vTaskDelete(nullptr);
+}
+
+NimBLERemoteCharacteristic *AntBms::discover_()
+{
+    auto *service = m_ble_client->getService(ANT_BMS_SERVICE_UUID);
+    if (!service)
+    {
+        ESP_LOGI(TAG, "Failed to get service %s", NimBLEUUID{ANT_BMS_SERVICE_UUID}.toString().c_str());
+        return nullptr;
+    }
+
+    auto *characteristic = service->getCharacteristic(ANT_BMS_CHARACTERISTIC_UUID);
+    if (!characteristic)
+    {
+        ESP_LOGI(TAG, "Failed to get characteristic %s", NimBLEUUID{ANT_BMS_CHARACTERISTIC_UUID}.toString().c_str());
+        return nullptr;
+    }
+
+    if (!characteristic->canNotify())
+    {
+        ESP_LOGW(TAG, "Characteristic %s does not support notify", characteristic->toString().c_str());
+        return nullptr;
+    }
+
+    if (!characteristic->subscribe(true, [this](NimBLERemoteCharacteristic *pBLERemoteCharacteristic, uint8_t *pData,
+                                                size_t length, bool isNotify) {
+        m_notifyCallback(pBLERemoteCharacteristic, pData, length, isNotify);
+    }))
+    {
+        ESP_LOGW(TAG, "Failed to subscribe to %s", characteristic->toString().c_str());
+        return nullptr;
+    }
+
+    return characteristic;
+}
+
+void AntBms::subscribed_()
+{
+    m_ble_characteristic = m_discovered_characteristic;
+    m_ble_state = BLE_CONNECTED;
+    m_bms_address = m_ble_client->getPeerAddress();
+    m_supervisor.connected(esp_timer_get_time());
+
+    // the fallback only covers this connection, the next one tries the tuned parameters again
+    if (m_use_default_conn_params)
+    {
+        ESP_LOGI(TAG, "Connected with default connection parameters");
+        m_use_default_conn_params = false;
+    }
+
+    ESP_LOGI(TAG, "Subscribed to %s, discovery took %lldms", m_ble_characteristic->toString().c_str(),
+             (esp_timer_get_time() - m_discovery_start_us) / 1000);
+
+    // MTU exchange has finished by the time discovery is done
+    m_mtu = m_ble_client->getMTU();
+    m_capture.record(CaptureEvent::Connected, esp_timer_get_time(), to_le16(m_mtu));
+    ESP_LOGI(TAG, "MTU %d, status frame needs %d notification(s)", m_mtu, notifications_per_frame(m_mtu));
+}
+
+void AntBms::start_scan_()
+{
+    // the advertised devices belong to the scan results
+    m_ble_devices.clear();
+    m_ble_scan->clearResults();
+    m_ble_scan->start(0, false);
+
+    m_ble_state = BleState::BLE_SCANNING;
+}
+
+void AntBms::link_lost_(ConnectionSupervisor::Loss loss)
+{
+    m_supervisor.lost(loss, esp_timer_get_time());
+
+    m_ble_characteristic = nullptr;
+    m_discovered_characteristic = nullptr;
+    if (m_ble_client && m_ble_client->isConnected())
+    {
+        m_ble_client->disconnect();
+    }
+
+    reset_link_state_();
+    m_ble_state = BLE_BACKOFF;
+
+    ESP_LOGI(TAG, "Next connection attempt in %lldms",
+             std::max<int64_t>(m_supervisor.next_attempt_us() - esp_timer_get_time(), 0) / 1000);
+}
+
+void AntBms::reset_link_state_()
+{
+    m_mtu = ATT_DEFAULT_MTU;
+    m_assembler.reset();
+    m_status_requests.reset();
+    m_last_status_frame.clear();
+    m_dirty.reset();
+    m_analytics.reset();
+    m_mirror.reset();
+}
+
+void AntBms::log_link_stats_()
+{
+    const auto &stats = m_link_stats;
+
+    if (m_emulator)
+    {
+        ESP_LOGI(TAG, "Link (emulated): mtu=%d frames=%ld single_pdu=%ld notifications/frame avg=%.2f max=%d "
+                      "commands=%ld notifications sent=%ld dropped=%ld",
+                 m_mtu, stats.frames, stats.single_pdu_frames, stats.avg_notifications_per_frame(),
+                 stats.max_notifications_per_frame, m_emulator->commands, m_emulator->notifications_sent,
+                 m_emulator->notifications_dropped);
+
+        ESP_LOGI(TAG, "ESP-NOW loopback: delivered=%ld lost=%ld", espnow::loopback_stats().delivered,
+                 espnow::loopback_stats().lost);
+    }
+    else if (m_ble_client)
+    {
+        const auto info = m_ble_client->getConnInfo();
+
+        ESP_LOGI(TAG, "Link: mtu=%d interval=%.2fms latency=%d frames=%ld single_pdu=%ld notifications/frame avg=%.2f max=%d",
+                 m_mtu, info.getConnInterval() * 1.25f, info.getConnLatency(), stats.frames, stats.single_pdu_frames,
+                 stats.avg_notifications_per_frame(), stats.max_notifications_per_frame);
+    }
+    else
+    {
+        return;
+    }
+
+    const auto &requests = m_status_requests;
+    const auto elapsed_s = std::chrono::duration_cast<std::chrono::duration<float>>(m_link_stats_interval).count();
+
+    ESP_LOGI(TAG, "Status requests: sent=%ld answered=%ld timeouts=%ld rate=%.1f/s rtt min=%lldus avg=%lldus max=%lldus",
+             requests.requests, requests.responses, requests.timeouts, requests.responses / elapsed_s,
+             requests.rtt.min_or_zero_us(), requests.rtt.avg_us(), requests.rtt.max_us);
+
+    const auto &supervisor = m_supervisor;
+    ESP_LOGI(TAG, "Connection: connects=%ld failed=%ld stalls=%ld disconnects=%ld recoveries=%ld clients=%ld",
+             supervisor.connects, supervisor.connect_failures, supervisor.stalls, supervisor.disconnects,
+             supervisor.recoveries, m_clients_created);
+    ESP_LOGI(TAG, "Time to detect: %s", supervisor.time_to_detect.to_string().c_str());
+    ESP_LOGI(TAG, "Time to recover: %s", supervisor.time_to_recover.to_string().c_str());
+
+    const auto &mirror = m_mirror;
+    const auto queries = mirror.hits + mirror.misses;
+    ESP_LOGI(TAG, "Register mirror: valid=%d/%d reads=%ld timeouts=%ld read latency min=%lldus avg=%lldus max=%lldus "
+                  "queries=%ld hit rate=%.1f%%",
+             mirror.valid_count(), RegisterMirror::SIZE, mirror.reads, mirror.read_timeouts,
+             mirror.read_latency.min_or_zero_us(), mirror.read_latency.avg_us(), mirror.read_latency.max_us, queries,
+             queries ? mirror.hits * 100.f / queries : 0.f);
+
+    // the longest the main loop went without handling ESP-NOW because of us
+    ESP_LOGI(TAG, "Update: n=%ld min=%lldus avg=%lldus max=%lldus", m_update_stats.count,
+             m_update_stats.min_or_zero_us(), m_update_stats.avg_us(), m_update_stats.max_us);
+
+    ESP_LOGI(TAG, "Encode: n=%ld min=%lldus avg=%lldus max=%lldus", m_encode_stats.count,
+             m_encode_stats.min_or_zero_us(), m_encode_stats.avg_us(), m_encode_stats.max_us);
+
+    ESP_LOGI(TAG, "Decode: n=%ld invalid=%ld min=%lldus avg=%lldus max=%lldus", m_decode_stats.count,
+             m_invalid_frames, m_decode_stats.min_or_zero_us(), m_decode_stats.avg_us(), m_decode_stats.max_us);
+
+    ESP_LOGI(TAG, "Analytics: n=%ld min=%lldus avg=%lldus max=%lldus", m_analytics_stats.count,
+             m_analytics_stats.min_or_zero_us(), m_analytics_stats.avg_us(), m_analytics_stats.max_us);
+
+    ESP_LOGI(TAG, "Alarms: raised=%ld acknowledged=%ld retransmissions=%ld expired=%ld trigger->air min=%lldus avg=%lldus max=%lldus",
+             m_alarms.raised, m_alarms.acknowledged, m_alarms.retransmissions, m_alarms.expired,
+             m_alarms.trigger_to_air.min_or_zero_us(), m_alarms.trigger_to_air.avg_us(),
+             m_alarms.trigger_to_air.max_us);
+
+    // airtime share of one channel, the number to compare between batched and unbatched
+    ESP_LOGI(TAG, "Telemetry: sent=%ld suppressed=%ld unchanged_status_frames=%ld airtime=%lldus (%.2f%%)",
+             m_frames_sent, m_frames_suppressed, m_unchanged_frames, m_telemetry_airtime_us,
+             m_telemetry_airtime_us / (elapsed_s * 1e4f));
+
+    if (m_batcher.enabled())
+    {
+        ESP_LOGI(TAG, "Batching: budget=%lldms samples=%ld (%.1f/s) frames=%ld samples/frame=%.1f max_wait=%lldms "
+                      "dropped=%ld airtime=%lldus (%.2f%%) per sample=%lldus",
+                 std::chrono::milliseconds{m_batcher.latency_budget()}.count(), m_batcher.samples,
+                 m_batcher.batched / elapsed_s, m_batcher.frames,
+                 m_batcher.frames ? float(m_batcher.batched) / m_batcher.frames : 0.f, m_batcher.max_wait_ms,
+                 m_batcher.dropped, m_batch_airtime_us, m_batch_airtime_us / (elapsed_s * 1e4f),
+                 m_batcher.batched ? m_batch_airtime_us / m_batcher.batched : 0);
+    }
+
+    for (const auto &group : m_scheduler.groups())
+    {
+        ESP_LOGI(TAG, "Telemetry group %-12s target=%lldms achieved=%.2f/s unchanged=%ld max_staleness=%lldms",
+                 group.name, std::chrono::milliseconds{TelemetryScheduler::effective_period(group)}.count(),
+                 group.sent / elapsed_s, group.unchanged,
+                 std::chrono::milliseconds{group.max_staleness}.count());
+    }
+
+    std::array<Subscriber, PeerRegistry::MAX_SUBSCRIBERS> subscribers;
+    const auto subscriber_count = m_peers.snapshot(subscribers);
+    for (size_t i = 0; i < subscriber_count; i++)
+    {
+        const auto &peer = subscribers[i];
+        ESP_LOGI(TAG, "Subscriber %02x:%02x:%02x:%02x:%02x:%02x groups=%lx period=%lldms frames=%ld delivered=%.1f%% "
+                      "airtime=%lldus (%.2f%%)",
+                 peer.mac[0], peer.mac[1], peer.mac[2], peer.mac[3], peer.mac[4], peer.mac[5], peer.groups,
+                 std::chrono::milliseconds{peer.period}.count(), peer.frames, peer.delivery_ratio() * 100.f,
+                 peer.airtime_us, peer.airtime_us / (elapsed_s * 1e4f));
+    }
+
+    auto &time_sync = espnow::time_sync();
+    if (time_sync.role() == espnow::TimeSync::Role::Node)
+    {
+        const auto sync = time_sync.stats();
+        ESP_LOGI(TAG, "Time sync: %s offset=%lldus drift=%.2fppm requests=%ld accepted=%ld rejected=%ld "
+                      "error min=%lldus avg=%lldus max=%lldus delay avg=%lldus",
+                 time_sync.synced() ? "synced" : "not synced", sync.offset_us, sync.drift_ppm, sync.requests,
+                 sync.accepted, sync.rejected, sync.error.min_or_zero_us(), sync.error.avg_us(), sync.error.max_us,
+                 sync.delay.avg_us());
+    }
+
+    auto &rate_controller = espnow::rate_controller();
+    ESP_LOGI(TAG, "ESP-NOW rate: %s, full frame airtime=%lldus", rate_controller.current().name,
+             espnow::airtime_us(ESP_NOW_MAX_DATA_LEN));
+
+    const auto rate_stats = rate_controller.stats();
+    for (size_t i = 0; i < rate_stats.size(); i++)
+    {
+        if (const auto &stats = rate_stats[i]; stats.sent)
+        {
+            const auto &rate = espnow::RateController::rates()[i];
+            ESP_LOGI(TAG, "ESP-NOW rate %-7s unicast=%ld delivered=%.1f%% full frame airtime=%lldus", rate.name,
+                     stats.sent, stats.delivery_ratio() * 100.f, espnow::airtime_us(rate, ESP_NOW_MAX_DATA_LEN));
+        }
+    }
+
+    helpers::log_memory_stats(TAG);
+
+    // every report covers one window
+    m_link_stats.reset();
+    m_status_requests.reset_stats();
+    m_supervisor.reset_stats();
+    m_update_stats.reset();
+    m_mirror.reset_stats();
+    m_encode_stats.reset();
+    m_decode_stats.reset();
+    m_invalid_frames = 0;
+    m_analytics_stats.reset();
+    m_frames_sent = 0;
+    m_frames_suppressed = 0;
+    m_telemetry_airtime_us = 0;
+    m_batcher.reset_stats();
+    m_batch_airtime_us = 0;
+    m_scheduler.reset_stats();
+    m_peers.reset_stats();
+    rate_controller.reset_stats();
+    time_sync.reset_stats();
+    m_unchanged_frames = 0;
+    if (m_emulator)
+    {
+        m_emulator->reset_stats();
+    }
+}
+
+void AntBms::m_notifyCallback(NimBLERemoteCharacteristic *pBLERemoteCharacteristic, uint8_t *pData, size_t length,
+                              bool isNotify)
+{
+    // ESP_LOGI(TAG, "Received %s: %s (%.*s)", isNotify ? "notification" : "indication", format_hex_pretty(pData, length).c_str(), length, pData);
+
+    on_notification_(pData, length);
+}
+
+void AntBms::on_notification_(const uint8_t *data, size_t length)
+{
+    m_capture.record(CaptureEvent::Notification, esp_timer_get_time(), {data, length});
+
+    assemble(data, length);
+}
+
+void AntBms::dump_capture() const
+{
+    const auto capture = m_capture.serialize();
+
+    ESP_LOGI(TAG, "Capture begin: %d bytes, %ld records, %ld overwritten", capture.size(), m_capture.recorded,
+             m_capture.overwritten);
+
+    std::array<char, helpers::base64_encoded_size(CAPTURE_DUMP_LINE_BYTES)> line;
+    for (size_t pos = 0; pos < capture.size(); pos += CAPTURE_DUMP_LINE_BYTES)
+    {
+        const auto chunk = std::span{capture}.subspan(pos, std::min(CAPTURE_DUMP_LINE_BYTES, capture.size() - pos));
+        const auto size = helpers::base64_encode(chunk, line);
+        ESP_LOGI(TAG, "CAP %.*s", size, line.data());
+    }
+
+    ESP_LOGI(TAG, "Capture end");
+}
+
+std::expected<void, std::string> AntBms::start_replay(std::vector<uint8_t> capture, float speed)
+{
+    auto replay = CaptureReplay::open(std::move(capture));
+    if (!replay)
+    {
+        return std::unexpected(replay.error());
+    }
+
+    if (m_replay)
+    {
+        ESP_LOGW(TAG, "Replay restarted after %ld records", m_replay->stats().records);
+    }
+
+    m_replay.emplace(std::move(*replay));
+    m_replay_start_us = esp_timer_get_time();
+    m_replay_speed = speed;
+
+    return {};
+}
+
+void AntBms::pump_replay_()
+{
+    if (!m_replay)
+    {
+        return;
+    }
+
+    const auto elapsed_us = esp_timer_get_time() - m_replay_start_us;
+    const auto until_us = m_replay_speed > 0.f ? static_cast<int64_t>(elapsed_us * m_replay_speed)
+                                               : std::numeric_limits<int64_t>::max();
+
+    const auto done = m_replay->step(until_us, REPLAY_RECORDS_PER_UPDATE);
+    if (!done)
+    {
+        ESP_LOGW(TAG, "Replay failed: %s", done.error().c_str());
+        m_replay.reset();
+        return;
+    }
+
+    if (!*done)
+    {
+        return;
+    }
+
+    const auto &stats = m_replay->stats();
+    const auto &data = m_replay->data();
+    ESP_LOGI(TAG, "Replay: records=%ld notifications=%ld frames=%ld status=%ld invalid=%ld captured=%lldms took=%lldms",
+             stats.records, stats.notifications, stats.frames, stats.status_frames, stats.invalid_frames,
+             stats.captured_us / 1000, elapsed_us / 1000);
+    ESP_LOGI(TAG, "Replay last status: %.2fV %.2fA %.0f%% %d cells", data.total_voltage, data.current,
+             data.state_of_charge, data.cell_voltages.size());
+    m_replay.reset();
+}
+
+void AntBms::OnScanResults::onDiscovered(NimBLEAdvertisedDevice *advertised_device)
+{
+    // check if ANT_BMS_SERVICE_UUID
+    if (!advertised_device->haveServiceUUID())
+    {
+        ESP_LOGW(TAG, "[onDiscovered] Found BLE device without service UUIDs: %s",
+                 advertised_device->toString().c_str());
+        return;
+    }
+
+    if (!advertised_device->isAdvertisingService(ANT_BMS_SERVICE_UUID))
+    {
+        ESP_LOGW(TAG, "[onDiscovered] Found BLE device without MATCHING service UUID: %s",
+                 advertised_device->toString().c_str());
+        return;
+    }
+
+    m_ant_bms.m_ble_devices.push_back(advertised_device);
+}
+
+void AntBms::OnClientCallback::onConnect(NimBLEClient *pClient)
+{
+    m_ant_bms.m_link_event = LinkEvent::Connected;
+    xTaskNotifyGive(m_ant_bms.m_loop_task);
+}
+
+void AntBms::OnClientCallback::onConnectFail(NimBLEClient *pClient, int reason)
+{
+    ESP_LOGW(TAG, "Connect failed, reason %d", reason);
+    m_ant_bms.m_link_error = reason;
+    m_ant_bms.m_link_event = LinkEvent::ConnectFailed;
+    xTaskNotifyGive(m_ant_bms.m_loop_task);
+}
+
+void AntBms::OnClientCallback::onDisconnect(NimBLEClient *pClient, int reason)
+{
+    // update() notices through isConnected(), the state machine stays on the main loop
+    m_ant_bms.m_link_error = reason;
+    m_ant_bms.m_capture.record(CaptureEvent::Disconnected, esp_timer_get_time(), to_le16(reason));
+    ESP_LOGI(TAG, "Disconnected, reason %d", reason);
+}
+
+void AntBms::OnClientCallback::onMTUChange(NimBLEClient *pClient, uint16_t MTU)
+{
+    m_ant_bms.m_mtu = MTU;
+    m_ant_bms.m_capture.record(CaptureEvent::MtuChanged, esp_timer_get_time(), to_le16(MTU));
+    ESP_LOGI(TAG, "MTU changed to %d, status frame needs %d notification(s)", MTU, notifications_per_frame(MTU));
+}
+
+bool AntBms::OnClientCallback::onConnParamsUpdateRequest(NimBLEClient *pClient, const ble_gap_upd_params *params)
 {
-    m_ant_bms.m_ble_state = BLE_SCANNING;
+    // the BMS knows its own limits better than we do, accept whatever it asks for
+    ESP_LOGI(TAG, "BMS requested connection interval %.2f-%.2fms latency %d timeout %dms",
+             params->itvl_min * 1.25f, params->itvl_max * 1.25f, params->latency, params->supervision_timeout * 10);
+    return true;
 }
 
 void AntBms::CharacteristicCallbacks::onSubscribe(NimBLECharacteristic *pCharacteristic, NimBLEConnInfo &connInfo,
@@ -715,7 +1503,6 @@ void AntBms::CharacteristicCallbacks::onSubscribe(NimBLECharacteristic *pCharact
 {
     // send device info request
     ESP_LOGI(TAG, "Request device info frame");
-    // 0x7e 0xa1 0x02 0x6c 0x02 0x20 0x58 0xc4 0xaa 0x55
-    m_ant_bms.send_(ANT_COMMAND_DEVICE_INFO, 0x026c, 0x20, false);
+    m_ant_bms.write_frame_(DEVICE_INFO_REQUEST_FRAME);
 }
 } // namespace antbms
@@ -2,16 +2,40 @@
 constexpr const char *const TAG = "AntBms";
 
 // system includes
+#include <array>
+#include <atomic>
+#include <expected>
+#include <functional>
+#include <optional>
+#include <span>
 #include <vector>
 #include <string>
 #include <string_view>
 
+// esp-idf includes
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
 // 3rdparty includes
 #include <espchrono.h>
 #include <NimBLEDevice.h>
 
 // local includes
+#include "alarms.h"
+#include "analytics.h"
+#include "capture.h"
+#include "capturereplay.h"
+#include "connectionsupervisor.h"
 #include "datastructure.h"
+#include "dirtytracker.h"
+#include "emulator.h"
+#include "frameassembler.h"
+#include "linkstats.h"
+#include "peerregistry.h"
+#include "registermirror.h"
+#include "requesttracker.h"
+#include "samplebatcher.h"
+#include "telemetryscheduler.h"
 
 using namespace std::chrono_literals;
 
@@ -25,8 +49,62 @@ public:
     // interaction with class
     void update();
 
+    // minimum time between two status requests, 0 polls as fast as the BMS answers
     void set_interval(espchrono::millis_clock::duration interval)
-    { m_interval = interval; }
+    {
+        m_interval = interval;
+        m_status_requests.set_min_interval_us(std::chrono::duration_cast<std::chrono::microseconds>(interval).count());
+    }
+
+    // longest time a telemetry group stays off air when nothing changes
+    void set_max_silence(espchrono::millis_clock::duration max_silence)
+    { m_max_silence = max_silence; }
+
+    void set_deadband(Field field, float deadband)
+    { m_dirty.set_deadband(field, deadband); }
+
+    bool set_telemetry_period(std::string_view group, espchrono::millis_clock::duration period)
+    { return m_scheduler.set_period(group, period); }
+
+    bool set_telemetry_priority(std::string_view group, uint8_t priority)
+    { return m_scheduler.set_priority(group, priority); }
+
+    void set_alarm_thresholds(AlarmId id, float set, float clear)
+    { m_alarms.set_thresholds(id, set, clear); }
+
+    // batch samples into "BAT:" frames sent at the latest after budget, 0 turns batching off.
+    // While batching, the fast telemetry group goes out every 2s at most, the batches carry its main fields.
+    void set_batching(espchrono::millis_clock::duration latency_budget);
+
+    // a connection without a valid frame for that long gets dropped and reconnected
+    void set_stall_timeout(espchrono::millis_clock::duration timeout)
+    { m_supervisor.set_stall_timeout_us(std::chrono::duration_cast<std::chrono::microseconds>(timeout).count()); }
+
+    void set_request_timeout(espchrono::millis_clock::duration timeout)
+    { m_status_requests.set_timeout_us(std::chrono::duration_cast<std::chrono::microseconds>(timeout).count()); }
+
+    // called on the NimBLE host task with every decoded status frame and the esp_timer time it started
+    // arriving, set before the first update()
+    void on_sample(std::function<void(const AntBmsData &data, int64_t received_us)> handler)
+    { m_sample_handler = std::move(handler); }
+
+    // talk to a virtual BMS instead of scanning for a real one, call before the first update()
+    void enable_emulator(const Emulator::Config &config)
+    { m_emulator.emplace(config); }
+
+    // raw notification capture, see capture.h for the format
+    void start_capture(size_t capacity)
+    { m_capture.start(capacity); }
+
+    void stop_capture()
+    { m_capture.stop(); }
+
+    // prints the capture as base64 lines prefixed with "CAP "
+    void dump_capture() const;
+
+    // replays a capture into a CaptureReplay of its own, paced from update(). Speed 1 is real time,
+    // 0 as fast as the loop allows. The live data, alarms and telemetry are left alone.
+    std::expected<void, std::string> start_replay(std::vector<uint8_t> capture, float speed);
 
     void set_password(const std::string &password)
     { m_password = password; }
@@ -47,26 +125,120 @@ public:
 
     bool authenticate_variable_(const uint8_t *data, uint8_t data_length);
 
-    void on_ant_bms_ble_data_(const uint8_t &function, const std::vector<uint8_t> &data);
+    bool write_frame_(std::span<const uint8_t> frame);
 
-    void on_status_data_(const std::vector<uint8_t> &data);
+    void on_ant_bms_ble_data_(const uint8_t &function, std::span<const uint8_t> data);
 
-    void on_device_info_data_(const std::vector<uint8_t> &data);
+    void on_status_data_(std::span<const uint8_t> data);
+
+    void on_device_info_data_(std::span<const uint8_t> data);
+
+    void on_register_data_(std::span<const uint8_t> data);
 
     void assemble(const uint8_t *data, uint8_t data_length);
 
     void write_register(uint16_t address, uint8_t value);
 
+    // parameter registers as last read from the BMS, filled after connecting
+    [[nodiscard]] RegisterMirror &register_mirror()
+    { return m_mirror; }
+
     void push_advertised_device(NimBLEAdvertisedDevice *advertised_device)
     { m_ble_devices.push_back(advertised_device); }
 
+    // when update() has scheduled work next: status poll, telemetry slot, batch, subscriber or log
+    [[nodiscard]] espchrono::millis_clock::time_point next_wakeup() const;
+
+    // an alarm waits for its ACK or a BMS connection is being set up, the loop should not sleep
+    [[nodiscard]] bool busy() const;
+
+    [[nodiscard]] const LinkStats &link_stats() const
+    { return m_link_stats; }
+
+    [[nodiscard]] const RequestTracker &status_requests() const
+    { return m_status_requests; }
+
 private:
     std::string m_password;
-    std::vector<uint8_t> m_frame_buffer;
-    espchrono::millis_clock::duration m_interval = 500ms;
+    espchrono::millis_clock::duration m_interval = 0ms;
     espchrono::millis_clock::duration m_wireless_interval = 100ms;
     espchrono::millis_clock::time_point m_last_update = espchrono::millis_clock::now();
     espchrono::millis_clock::time_point m_last_wireless_update = espchrono::millis_clock::now();
+    espchrono::millis_clock::duration m_link_stats_interval = 30s;
+    espchrono::millis_clock::time_point m_last_link_stats = espchrono::millis_clock::now();
+
+    // link negotiation
+    uint16_t m_mtu = 23;
+    // set when the BMS rejected the tuned parameters, cleared once connected
+    bool m_use_default_conn_params = false;
+
+    // woken up whenever a status frame completes, so the next request goes out right away
+    TaskHandle_t m_loop_task = nullptr;
+
+    // per-frame link bookkeeping
+    FrameAssembler m_assembler;
+    LinkStats m_link_stats;
+    RequestTracker m_status_requests;
+    helpers::DurationStats m_encode_stats;
+    // how long update() kept the main loop from everything else
+    helpers::DurationStats m_update_stats;
+
+    // change tracking
+    DirtyTracker m_dirty;
+    // last status frame decoded, an identical one is not decoded again
+    std::vector<uint8_t> m_last_status_frame;
+    espchrono::millis_clock::duration m_max_silence = 5s;
+    TelemetryScheduler m_scheduler;
+    uint32_t m_frames_sent = 0;
+    uint32_t m_frames_suppressed = 0;
+    uint32_t m_unchanged_frames = 0;
+    int64_t m_telemetry_airtime_us = 0;
+
+    SampleBatcher m_batcher;
+    int64_t m_batch_airtime_us = 0;
+
+    helpers::DurationStats m_decode_stats;
+    uint32_t m_invalid_frames = 0;
+
+    Analytics m_analytics;
+    helpers::DurationStats m_analytics_stats;
+
+    AlarmEngine m_alarms;
+
+    PeerRegistry m_peers;
+
+    RegisterMirror m_mirror;
+
+    std::optional<Emulator> m_emulator;
+
+    CaptureRing m_capture;
+    std::optional<CaptureReplay> m_replay;
+    int64_t m_replay_start_us{};
+    float m_replay_speed{};
+
+    std::function<void(const AntBmsData &data, int64_t received_us)> m_sample_handler;
+
+    // liveness and reconnect backoff
+    ConnectionSupervisor m_supervisor;
+    std::optional<NimBLEAddress> m_bms_address;
+    uint32_t m_clients_created = 0;
+
+    // connect() and discovery report back from other tasks, update() picks the result up
+    enum class LinkEvent : uint8_t
+    {
+        None,
+        Connected,
+        ConnectFailed,
+        Subscribed,
+        DiscoveryFailed,
+    };
+    std::atomic<LinkEvent> m_link_event{LinkEvent::None};
+    // NimBLE reason of the last failed connect or disconnect
+    std::atomic<int> m_link_error{0};
+    // valid once Subscribed was reported
+    NimBLERemoteCharacteristic *m_discovered_characteristic = nullptr;
+    int64_t m_connect_start_us = 0;
+    int64_t m_discovery_start_us = 0;
 
     NimBLERemoteCharacteristic *m_ant_bms_remote_characteristic = nullptr;
     NimBLEScan *m_ble_scan = nullptr;
@@ -74,14 +246,52 @@ private:
     NimBLERemoteCharacteristic *m_ble_characteristic = nullptr;
     std::vector<NimBLEAdvertisedDevice *> m_ble_devices;
 
+    void update_();
+
     void ble_connect(NimBLEAddress address);
 
+    void connect_failed_(int reason);
+
+    void fall_back_on_rejection_(int reason);
+
+    void start_discovery_();
+
+    static void discovery_task(void *arg);
+
+    NimBLERemoteCharacteristic *discover_();
+
+    void subscribed_();
+
+    void start_scan_();
+
+    void link_lost_(ConnectionSupervisor::Loss loss);
+
+    void reset_link_state_();
+
+    void log_link_stats_();
+
+    void send_alarms_();
+
+    void pump_replay_();
+
+    void send_telemetry_slot_();
+
+    void send_batches_();
+
+    void send_subscriptions_();
+
+    void send_to_subscriber_(const Subscriber &subscriber);
+
     enum BleState
     {
         BLE_IDLE,
         BLE_SCANNING,
         BLE_CONNECTING,
+        // services are discovered and notifications subscribed on a task of their own
+        BLE_DISCOVERING,
         BLE_CONNECTED,
+        // waiting for the next connection attempt
+        BLE_BACKOFF,
     } m_ble_state = BLE_IDLE;
 
     // NimBLE callbacks
@@ -105,8 +315,16 @@ private:
                 : m_ant_bms{ant_bms}
         {}
 
+        void onConnect(NimBLEClient *pClient) override;
+
+        void onConnectFail(NimBLEClient *pClient, int reason) override;
+
         void onDisconnect(NimBLEClient *pClient, int reason) override;
 
+        void onMTUChange(NimBLEClient *pClient, uint16_t MTU) override;
+
+        bool onConnParamsUpdateRequest(NimBLEClient *pClient, const ble_gap_upd_params *params) override;
+
     private:
         AntBms &m_ant_bms;
     } m_on_client_events;
@@ -124,10 +342,15 @@ private:
         AntBms &m_ant_bms;
     } m_characteristics_callbacks;
 
+    void on_notification_(const uint8_t *data, size_t length);
+
     void m_notifyCallback(NimBLERemoteCharacteristic *pBLERemoteCharacteristic,
                         uint8_t *pData, size_t length, bool isNotify);
 
+    // written by the NimBLE host task only
     AntBmsData m_bmsData;
+    // what the main loop encodes, copied from m_dirty under its lock
+    AntBmsData m_encode_data{};
 };
 
 } // namespace antbms
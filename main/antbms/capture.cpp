@@ -0,0 +1,218 @@
+#include "capture.h"
+
+// system includes
+#include <algorithm>
+
+namespace antbms {
+
+namespace {
+constexpr const uint8_t CAPTURE_MAGIC[4] = {'A', 'N', 'T', 'C'};
+
+constexpr size_t varint_size(uint64_t value)
+{
+    size_t size = 1;
+    while (value >= 0x80)
+    {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+std::optional<uint64_t> read_varint(std::span<const uint8_t> data, size_t &pos)
+{
+    uint64_t value = 0;
+    for (unsigned shift = 0; pos < data.size() && shift < 64; shift += 7)
+    {
+        const uint8_t byte = data[pos++];
+        value |= uint64_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+        {
+            return value;
+        }
+    }
+    return std::nullopt;
+}
+} // namespace
+
+std::expected<CaptureReader, std::string> CaptureReader::open(std::span<const uint8_t> capture)
+{
+    if (capture.size() < CAPTURE_HEADER_SIZE || !std::equal(std::begin(CAPTURE_MAGIC), std::end(CAPTURE_MAGIC), capture.begin()))
+    {
+        return std::unexpected("not a capture file");
+    }
+
+    if (capture[4] != CAPTURE_VERSION)
+    {
+        return std::unexpected("unsupported capture version " + std::to_string(capture[4]));
+    }
+
+    uint64_t start_us = 0;
+    for (size_t i = 0; i < 8; i++)
+    {
+        start_us |= uint64_t(capture[5 + i]) << (i * 8);
+    }
+
+    return CaptureReader{capture.subspan(CAPTURE_HEADER_SIZE), static_cast<int64_t>(start_us)};
+}
+
+std::expected<std::optional<CaptureRecord>, std::string> CaptureReader::next()
+{
+    if (m_pos >= m_records.size())
+    {
+        return std::nullopt;
+    }
+
+    const auto event = m_records[m_pos++];
+    if (event >= static_cast<uint8_t>(CaptureEvent::Count))
+    {
+        return std::unexpected("invalid event " + std::to_string(event) + " at " + std::to_string(m_pos - 1));
+    }
+
+    const auto length = read_varint(m_records, m_pos);
+    const auto delta_us = read_varint(m_records, m_pos);
+    if (!length || !delta_us || *length > m_records.size() - m_pos)
+    {
+        return std::unexpected("truncated record at " + std::to_string(m_pos));
+    }
+
+    m_timestamp_us += *delta_us;
+
+    const CaptureRecord record{
+        .event = static_cast<CaptureEvent>(event),
+        .timestamp_us = m_timestamp_us,
+        .data = m_records.subspan(m_pos, *length),
+    };
+    m_pos += *length;
+
+    return record;
+}
+
+void CaptureRing::start(size_t capacity)
+{
+    std::lock_guard lock{m_mutex};
+
+    m_buffer.assign(capacity, 0);
+    m_buffer.shrink_to_fit();
+    m_tail = 0;
+    m_used = 0;
+    recorded = 0;
+    overwritten = 0;
+    m_running = capacity > 0;
+}
+
+void CaptureRing::stop()
+{
+    std::lock_guard lock{m_mutex};
+
+    m_running = false;
+    m_buffer = {};
+    m_tail = 0;
+    m_used = 0;
+}
+
+void CaptureRing::record(CaptureEvent event, int64_t timestamp_us, std::span<const uint8_t> data)
+{
+    if (!m_running)
+    {
+        return;
+    }
+
+    std::lock_guard lock{m_mutex};
+
+    if (m_used == 0)
+    {
+        m_base_us = timestamp_us;
+        m_last_us = timestamp_us;
+    }
+
+    const uint64_t delta_us = std::max<int64_t>(timestamp_us - m_last_us, 0);
+    const size_t size = 1 + varint_size(data.size()) + varint_size(delta_us) + data.size();
+    if (size > m_buffer.size())
+    {
+        return;
+    }
+
+    while (m_buffer.size() - m_used < size)
+    {
+        drop_oldest();
+    }
+
+    push(static_cast<uint8_t>(event));
+    push_varint(data.size());
+    push_varint(delta_us);
+    for (const auto byte : data)
+    {
+        push(byte);
+    }
+
+    m_last_us += delta_us;
+    recorded++;
+}
+
+std::vector<uint8_t> CaptureRing::serialize() const
+{
+    std::lock_guard lock{m_mutex};
+
+    std::vector<uint8_t> capture;
+    capture.reserve(CAPTURE_HEADER_SIZE + m_used);
+    capture.insert(capture.end(), std::begin(CAPTURE_MAGIC), std::end(CAPTURE_MAGIC));
+    capture.push_back(CAPTURE_VERSION);
+    for (size_t i = 0; i < 8; i++)
+    {
+        capture.push_back(uint64_t(m_base_us) >> (i * 8));
+    }
+
+    for (size_t i = 0; i < m_used; i++)
+    {
+        capture.push_back(at(i));
+    }
+
+    return capture;
+}
+
+void CaptureRing::push(uint8_t byte)
+{
+    m_buffer[(m_tail + m_used) % m_buffer.size()] = byte;
+    m_used++;
+}
+
+void CaptureRing::push_varint(uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        push(uint8_t(value) | 0x80);
+        value >>= 7;
+    }
+    push(uint8_t(value));
+}
+
+void CaptureRing::drop_oldest()
+{
+    size_t pos = 1;
+
+    const auto varint_at = [&]() {
+        uint64_t value = 0;
+        for (unsigned shift = 0;; shift += 7)
+        {
+            const uint8_t byte = at(pos++);
+            value |= uint64_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+            {
+                return value;
+            }
+        }
+    };
+
+    const auto length = varint_at();
+    const auto delta_us = varint_at();
+    pos += length;
+
+    // the next record is now relative to the dropped one
+    m_base_us += delta_us;
+    m_tail = (m_tail + pos) % m_buffer.size();
+    m_used -= pos;
+    overwritten++;
+}
+
+} // namespace antbms
@@ -0,0 +1,108 @@
+#pragma once
+
+// system includes
+#include <atomic>
+#include <cstdint>
+#include <expected>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace antbms {
+
+enum class CaptureEvent : uint8_t
+{
+    Notification, // raw chunk as delivered by NimBLE
+    Write,        // command frame we sent
+    Connected,    // data: MTU, little endian
+    Disconnected, // data: reason, little endian
+    MtuChanged,   // data: MTU, little endian
+    Count
+};
+
+struct CaptureRecord
+{
+    CaptureEvent event;
+    int64_t timestamp_us;
+    std::span<const uint8_t> data;
+};
+
+// Capture file layout
+//
+// Byte Len Description
+//   0   4  "ANTC"
+//   4   1  Version (1)
+//   5   8  Timestamp of the first record in us, little endian
+//  13   n  Records
+//
+// Record layout
+//
+//   1 byte event, varint data length, varint time since the previous record in us, data
+constexpr static const uint8_t CAPTURE_VERSION = 1;
+constexpr static const size_t CAPTURE_HEADER_SIZE = 13;
+
+/// Walks the records of a capture file, the file has to outlive the reader.
+class CaptureReader
+{
+public:
+    static std::expected<CaptureReader, std::string> open(std::span<const uint8_t> capture);
+
+    /// std::nullopt once all records were read
+    std::expected<std::optional<CaptureRecord>, std::string> next();
+
+private:
+    CaptureReader(std::span<const uint8_t> records, int64_t start_us) :
+            m_records{records}, m_timestamp_us{start_us}
+    {}
+
+    std::span<const uint8_t> m_records;
+    size_t m_pos = 0;
+    int64_t m_timestamp_us;
+};
+
+/// Keeps the most recent records in a RAM ring, dropping the oldest ones when full.
+///
+/// record() is called from the NimBLE host task and the main loop.
+class CaptureRing
+{
+public:
+    /// allocates the ring, a running capture is discarded
+    void start(size_t capacity);
+
+    /// frees the ring
+    void stop();
+
+    [[nodiscard]] bool running() const
+    { return m_running; }
+
+    void record(CaptureEvent event, int64_t timestamp_us, std::span<const uint8_t> data = {});
+
+    /// current ring contents as capture file
+    [[nodiscard]] std::vector<uint8_t> serialize() const;
+
+    uint32_t recorded{};
+    uint32_t overwritten{};
+
+private:
+    [[nodiscard]] uint8_t at(size_t offset) const
+    { return m_buffer[(m_tail + offset) % m_buffer.size()]; }
+
+    void push(uint8_t byte);
+
+    void push_varint(uint64_t value);
+
+    void drop_oldest();
+
+    std::vector<uint8_t> m_buffer;
+    size_t m_tail = 0;
+    size_t m_used = 0;
+    // records only store deltas, the oldest one relative to m_base_us
+    int64_t m_base_us = 0;
+    int64_t m_last_us = 0;
+    std::atomic<bool> m_running = false;
+    mutable std::mutex m_mutex;
+};
+
+} // namespace antbms
@@ -0,0 +1,113 @@
+#include "capturereplay.h"
+
+// local includes
+#include "statusdecoder.h"
+
+namespace antbms {
+
+namespace {
+
+constexpr const uint8_t ANT_FRAME_TYPE_STATUS = 0x11;
+
+} // namespace
+
+std::expected<CaptureReplay, std::string> CaptureReplay::open(std::vector<uint8_t> capture)
+{
+    auto reader = CaptureReader::open(capture);
+    if (!reader)
+    {
+        return std::unexpected(reader.error());
+    }
+
+    return CaptureReplay{std::move(capture), *reader};
+}
+
+std::expected<bool, std::string> CaptureReplay::step(int64_t until_us, size_t max_records)
+{
+    for (size_t replayed = 0; replayed < max_records; replayed++)
+    {
+        if (!m_pending)
+        {
+            const auto record = m_reader.next();
+            if (!record)
+            {
+                return std::unexpected(record.error());
+            }
+
+            if (!*record)
+            {
+                return true;
+            }
+
+            m_pending = **record;
+            if (!m_start_us)
+            {
+                m_start_us = m_pending->timestamp_us;
+            }
+        }
+
+        const auto captured_us = m_pending->timestamp_us - *m_start_us;
+        if (captured_us > until_us)
+        {
+            return false;
+        }
+
+        m_stats.captured_us = captured_us;
+        replay_(*m_pending);
+        m_pending.reset();
+        m_stats.records++;
+    }
+
+    return false;
+}
+
+void CaptureReplay::replay_(const CaptureRecord &record)
+{
+    switch (record.event)
+    {
+    case CaptureEvent::Notification:
+    {
+        m_stats.notifications++;
+
+        const auto frame = m_assembler.feed(record.data, record.timestamp_us);
+        if (!frame)
+        {
+            break;
+        }
+
+        m_stats.frames++;
+
+        if ((*frame)[2] != ANT_FRAME_TYPE_STATUS)
+        {
+            break;
+        }
+
+        if (!validate_status_frame(*frame))
+        {
+            m_stats.invalid_frames++;
+            break;
+        }
+
+        decode_status_frame(*frame, m_data);
+        m_stats.status_frames++;
+
+        if (m_status_handler)
+        {
+            m_status_handler(m_data, m_stats.captured_us);
+        }
+        break;
+    }
+    case CaptureEvent::Connected:
+        m_assembler.reset();
+        [[fallthrough]];
+    case CaptureEvent::MtuChanged:
+        if (record.data.size() >= 2)
+        {
+            m_mtu = uint16_t(record.data[1]) << 8 | record.data[0];
+        }
+        break;
+    default:;
+    }
+}
+
+} // namespace antbms
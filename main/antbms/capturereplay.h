@@ -0,0 +1,75 @@
+#pragma once
+
+// system includes
+#include <cstdint>
+#include <expected>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+// local includes
+#include "capture.h"
+#include "datastructure.h"
+#include "frameassembler.h"
+
+namespace antbms {
+
+/// Replays a capture into its own FrameAssembler and AntBmsData, nothing of it
+/// reaches the live telemetry, alarms or analytics.
+///
+/// Plain C++, the caller paces it with step().
+class CaptureReplay
+{
+public:
+    struct Stats
+    {
+        uint32_t records{};
+        uint32_t notifications{};
+        uint32_t frames{};
+        uint32_t status_frames{};
+        uint32_t invalid_frames{};
+        // capture time of the last replayed record, relative to the first one
+        int64_t captured_us{};
+    };
+
+    static std::expected<CaptureReplay, std::string> open(std::vector<uint8_t> capture);
+
+    /// replays at most \p max_records records captured up to \p until_us after the first one,
+    /// true once the whole capture was replayed
+    std::expected<bool, std::string> step(int64_t until_us, size_t max_records = SIZE_MAX);
+
+    /// called with every decoded status frame and the time it was captured, relative to the first record
+    void on_status(std::function<void(const AntBmsData &data, int64_t captured_us)> handler)
+    { m_status_handler = std::move(handler); }
+
+    [[nodiscard]] const AntBmsData &data() const
+    { return m_data; }
+
+    [[nodiscard]] const Stats &stats() const
+    { return m_stats; }
+
+    [[nodiscard]] uint16_t mtu() const
+    { return m_mtu; }
+
+private:
+    CaptureReplay(std::vector<uint8_t> &&capture, CaptureReader reader) :
+            m_capture{std::move(capture)}, m_reader{reader}
+    {}
+
+    void replay_(const CaptureRecord &record);
+
+    // the reader points into m_capture, moving the vector keeps its buffer
+    std::vector<uint8_t> m_capture;
+    CaptureReader m_reader;
+    std::optional<CaptureRecord> m_pending;
+    std::optional<int64_t> m_start_us;
+
+    FrameAssembler m_assembler;
+    AntBmsData m_data{};
+    Stats m_stats;
+    uint16_t m_mtu = 23;
+    std::function<void(const AntBmsData &data, int64_t captured_us)> m_status_handler;
+};
+
+} // namespace antbms
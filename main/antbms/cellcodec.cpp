@@ -0,0 +1,109 @@
+#include "cellcodec.h"
+
+// system includes
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+
+// 3rdparty includes
+#include <fmt/format.h>
+
+namespace antbms::cellcodec {
+
+std::expected<size_t, std::string> pack(std::span<const uint16_t> cells_mv, std::span<uint8_t> out)
+{
+    const size_t cells = cells_mv.size();
+    if (cells > MAX_CELLS)
+    {
+        return std::unexpected(fmt::format("too many cells ({}>{})", cells, MAX_CELLS));
+    }
+
+    uint16_t base = UINT16_MAX;
+    for (size_t i = 0; i < cells; i++)
+    {
+        base = std::min(base, cells_mv[i]);
+    }
+    if (!cells)
+    {
+        base = 0;
+    }
+
+    // OR over all offsets has the same bit width as the largest one
+    std::array<uint16_t, MAX_CELLS> offsets{};
+    uint16_t spread = 0;
+    for (size_t i = 0; i < cells; i++)
+    {
+        offsets[i] = cells_mv[i] - base;
+        spread |= offsets[i];
+    }
+
+    const uint8_t width = std::bit_width(spread);
+    const size_t size = HEADER_SIZE + (cells * width + 7) / 8;
+    if (size > out.size())
+    {
+        return std::unexpected(fmt::format("packed cells do not fit ({}>{})", size, out.size()));
+    }
+
+    out[0] = cells;
+    out[1] = width;
+    out[2] = base >> 0;
+    out[3] = base >> 8;
+
+    // mirror of unpack(): every offset lands in a 3 byte window at a fixed position,
+    // the zero padded scratch buffer takes the last window without bounds checks
+    std::array<uint8_t, max_packed_size(MAX_CELLS) + 2> bytes{};
+    for (size_t i = 0; i < cells; i++)
+    {
+        const size_t bit = i * width;
+        const size_t byte = bit / 8;
+        const uint32_t word = uint32_t(offsets[i]) << (bit % 8);
+        bytes[byte + 0] |= word >> 0;
+        bytes[byte + 1] |= word >> 8;
+        bytes[byte + 2] |= word >> 16;
+    }
+
+    std::memcpy(out.data() + HEADER_SIZE, bytes.data(), size - HEADER_SIZE);
+
+    return size;
+}
+
+std::expected<size_t, std::string> unpack(std::span<const uint8_t> in, std::span<uint16_t> cells_mv)
+{
+    if (in.size() < HEADER_SIZE)
+    {
+        return std::unexpected(fmt::format("packed cells too short ({} bytes)", in.size()));
+    }
+
+    const size_t cells = in[0];
+    const uint8_t width = in[1];
+    const uint16_t base = uint16_t(in[2]) | uint16_t(in[3]) << 8;
+
+    if (cells > MAX_CELLS || cells > cells_mv.size() || width > 16)
+    {
+        return std::unexpected(fmt::format("invalid packed cells header (cells={} width={})", cells, width));
+    }
+
+    const size_t payload = (cells * width + 7) / 8;
+    if (in.size() < HEADER_SIZE + payload)
+    {
+        return std::unexpected(fmt::format("packed cells truncated ({}<{})", in.size(), HEADER_SIZE + payload));
+    }
+
+    // zero padded copy, so every cell can read 3 bytes without bounds checks
+    std::array<uint8_t, max_packed_size(MAX_CELLS) + 2> bytes{};
+    std::memcpy(bytes.data(), in.data() + HEADER_SIZE, payload);
+
+    const uint32_t mask = (uint32_t{1} << width) - 1;
+    for (size_t i = 0; i < cells; i++)
+    {
+        const size_t bit = i * width;
+        const size_t byte = bit / 8;
+        const uint32_t word = uint32_t(bytes[byte]) | uint32_t(bytes[byte + 1]) << 8 | uint32_t(bytes[byte + 2]) << 16;
+        cells_mv[i] = base + ((word >> (bit % 8)) & mask);
+    }
+
+    return cells;
+}
+
+} // namespace antbms::cellcodec
@@ -0,0 +1,35 @@
+#pragma once
+
+// system includes
+#include <cstdint>
+#include <expected>
+#include <span>
+#include <string>
+
+namespace antbms::cellcodec {
+
+// Packed cell vector
+//
+// Byte Len Description
+//   0   1  Number of cells
+//   1   1  Bits per cell offset (0 if all cells are equal)
+//   2   2  Base value, lowest cell in mV (little endian)
+//   4   n  Cell offsets from the base, LSB first, ceil(cells * bits / 8) bytes
+//
+// 32 cells within 63mV of each other take 4 + 24 bytes.
+
+constexpr static const size_t MAX_CELLS = 32;
+constexpr static const size_t HEADER_SIZE = 4;
+
+constexpr size_t max_packed_size(size_t cells)
+{
+    return HEADER_SIZE + (cells * 16 + 7) / 8;
+}
+
+/// Returns the number of bytes written.
+std::expected<size_t, std::string> pack(std::span<const uint16_t> cells_mv, std::span<uint8_t> out);
+
+/// Returns the number of cells written to \p cells_mv.
+std::expected<size_t, std::string> unpack(std::span<const uint8_t> in, std::span<uint16_t> cells_mv);
+
+} // namespace antbms::cellcodec
@@ -0,0 +1,94 @@
+#include "connectionsupervisor.h"
+
+// system includes
+#include <algorithm>
+
+namespace antbms {
+
+void ConnectionSupervisor::connected(int64_t now_us)
+{
+    connects++;
+    m_connected_us = now_us;
+    m_delivered = false;
+}
+
+bool ConnectionSupervisor::poll(int64_t now_us)
+{
+    const auto last_frame_us = m_last_frame_us.load(std::memory_order_relaxed);
+    account_delivery(last_frame_us);
+
+    return silent_us(now_us) > m_stall_timeout_us;
+}
+
+void ConnectionSupervisor::lost(Loss loss, int64_t now_us)
+{
+    const auto last_frame_us = m_last_frame_us.load(std::memory_order_relaxed);
+    account_delivery(last_frame_us);
+
+    if (loss == Loss::Stalled)
+    {
+        stalls++;
+    }
+    else
+    {
+        disconnects++;
+    }
+
+    // a connection that never delivered keeps counting from the loss before it
+    if (!m_lost_us)
+    {
+        const auto alive_us = std::max(last_frame_us, m_connected_us);
+        time_to_detect.add(now_us - alive_us);
+        m_lost_us = alive_us;
+    }
+
+    m_delivered = false;
+    back_off(now_us);
+}
+
+void ConnectionSupervisor::connect_failed(int64_t now_us)
+{
+    connect_failures++;
+    back_off(now_us);
+}
+
+void ConnectionSupervisor::reset_stats()
+{
+    connects = 0;
+    connect_failures = 0;
+    stalls = 0;
+    disconnects = 0;
+    recoveries = 0;
+    time_to_detect.reset();
+    time_to_recover.reset();
+}
+
+void ConnectionSupervisor::account_delivery(int64_t last_frame_us)
+{
+    if (m_delivered || last_frame_us < m_connected_us)
+    {
+        return;
+    }
+
+    m_delivered = true;
+    m_failures_in_row = 0;
+
+    if (m_lost_us)
+    {
+        recoveries++;
+        time_to_recover.add(last_frame_us - m_lost_us);
+        m_lost_us = 0;
+    }
+}
+
+void ConnectionSupervisor::back_off(int64_t now_us)
+{
+    // the first retry goes out right away, a blip should not cost a full backoff
+    const auto delay_us = m_failures_in_row ?
+            std::min(m_min_backoff_us << std::min<uint32_t>(m_failures_in_row - 1, 20), m_max_backoff_us) : 0;
+
+    m_failures_in_row++;
+    m_next_attempt_us = now_us + delay_us;
+}
+
+} // namespace antbms
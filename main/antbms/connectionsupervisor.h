@@ -0,0 +1,101 @@
+#pragma once
+
+// system includes
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+// local includes
+#include "helpers/histogram.h"
+
+namespace antbms {
+
+/// Decides when the BMS link is dead and when to try again. A connection is
+/// alive as long as valid frames keep arriving, none for stall_timeout since
+/// the last one (or since connecting) declares it stalled even though BLE still
+/// reports it up. Failed connects and lost links back off exponentially, the
+/// first valid frame of a new connection resets that.
+///
+/// Time to detect runs from the last valid frame until the link was declared
+/// dead, time to recover from that last frame until the first one on the next
+/// connection.
+///
+/// frame_received() may be called from the NimBLE host task, everything else
+/// is expected to run on the main loop.
+class ConnectionSupervisor
+{
+public:
+    enum class Loss : uint8_t
+    {
+        Stalled,
+        Disconnected,
+    };
+
+    void set_stall_timeout_us(int64_t timeout_us)
+    { m_stall_timeout_us = timeout_us; }
+
+    void set_backoff_us(int64_t min_us, int64_t max_us)
+    {
+        m_min_backoff_us = min_us;
+        m_max_backoff_us = max_us;
+    }
+
+    void connected(int64_t now_us);
+
+    void frame_received(int64_t now_us)
+    { m_last_frame_us.store(now_us, std::memory_order_relaxed); }
+
+    /// accounts a recovery once the new connection delivered, true if it went
+    /// silent for longer than the stall timeout
+    bool poll(int64_t now_us);
+
+    /// time since the last valid frame, or since connecting if there was none yet
+    [[nodiscard]] int64_t silent_us(int64_t now_us) const
+    { return now_us - std::max(m_last_frame_us.load(std::memory_order_relaxed), m_connected_us); }
+
+    /// the connection is gone, backs off before the next attempt
+    void lost(Loss loss, int64_t now_us);
+
+    void connect_failed(int64_t now_us);
+
+    [[nodiscard]] bool may_connect(int64_t now_us) const
+    { return now_us >= m_next_attempt_us; }
+
+    [[nodiscard]] int64_t next_attempt_us() const
+    { return m_next_attempt_us; }
+
+    /// failed connects and lost links since the last valid frame
+    [[nodiscard]] uint32_t failures_in_row() const
+    { return m_failures_in_row; }
+
+    void reset_stats();
+
+    // per stats window
+    uint32_t connects{};
+    uint32_t connect_failures{};
+    uint32_t stalls{};
+    uint32_t disconnects{};
+    uint32_t recoveries{};
+    helpers::Histogram time_to_detect{250'000};
+    helpers::Histogram time_to_recover{250'000};
+
+private:
+    void account_delivery(int64_t last_frame_us);
+
+    void back_off(int64_t now_us);
+
+    int64_t m_stall_timeout_us = 5'000'000;
+    int64_t m_min_backoff_us = 500'000;
+    int64_t m_max_backoff_us = 60'000'000;
+
+    std::atomic<int64_t> m_last_frame_us{0};
+    int64_t m_connected_us = 0;
+    // last valid frame before the link was lost, 0 while nothing needs recovering
+    int64_t m_lost_us = 0;
+    bool m_delivered = false;
+
+    uint32_t m_failures_in_row = 0;
+    int64_t m_next_attempt_us = 0;
+};
+
+} // namespace antbms
@@ -1,14 +1,22 @@
 #pragma once
 
 // system includes
+#include <array>
 #include <vector>
 #include <expected>
 #include <cmath>
+#include <span>
 
 // 3rdparty includes
 #include <fmt/format.h>
 #include <ArduinoJson.h>
 
+// local includes
+#include "helpers/base64.h"
+#include "helpers/formatduration.h"
+#include "helpers/jsonwriter.h"
+#include "cellcodec.h"
+
 namespace antbms {
 template<typename T>
 std::string vecToString(std::string prefix, const std::vector<T> &vec)
@@ -87,6 +95,131 @@ enum class BalancerStatus
     MotherboardOverTemperature = 0x0A,
 };
 
+constexpr static const std::array<const char *, 16> CHARGE_MOSFET_STATUS_STRINGS{
+        "Off",                           // 0x00
+        "On",                            // 0x01
+        "Overcharge protection",         // 0x02
+        "Over current protection",       // 0x03
+        "Battery full",                  // 0x04
+        "Total overpressure",            // 0x05
+        "Battery over temperature",      // 0x06
+        "MOSFET over temperature",       // 0x07
+        "Abnormal current",              // 0x08
+        "Balanced line dropped string",  // 0x09
+        "Motherboard over temperature",  // 0x0A
+        "Unknown",                       // 0x0B
+        "Unknown",                       // 0x0C
+        "Discharge MOSFET abnormality",  // 0x0D
+        "Unknown",                       // 0x0E
+        "Manually turned off",           // 0x0F
+};
+
+constexpr static const std::array<const char *, 16> DISCHARGE_MOSFET_STATUS_STRINGS{
+        "Off",                           // 0x00
+        "On",                            // 0x01
+        "Overdischarge protection",      // 0x02
+        "Over current protection",       // 0x03
+        "Unknown",                       // 0x04
+        "Total pressure undervoltage",   // 0x05
+        "Battery over temperature",      // 0x06
+        "MOSFET over temperature",       // 0x07
+        "Abnormal current",              // 0x08
+        "Balanced line dropped string",  // 0x09
+        "Motherboard over temperature",  // 0x0A
+        "Charge MOSFET on",              // 0x0B
+        "Short circuit protection",      // 0x0C
+        "Discharge MOSFET abnormality",  // 0x0D
+        "Start exception",               // 0x0E
+        "Manually turned off",           // 0x0F
+};
+
+constexpr static const std::array<const char *, 11> BALANCER_STATUS_STRINGS{
+        "Off",                                   // 0x00
+        "Exceeds the limit equilibrium",         // 0x01
+        "Charge differential pressure balance",  // 0x02
+        "Balanced over temperature",             // 0x03
+        "Automatic equalization",                // 0x04
+        "Unknown",                               // 0x05
+        "Unknown",                               // 0x06
+        "Unknown",                               // 0x07
+        "Unknown",                               // 0x08
+        "Unknown",                               // 0x09
+        "Motherboard over temperature",          // 0x0A
+};
+
+template<size_t N, typename T>
+constexpr const char *status_string(const std::array<const char *, N> &table, T status)
+{
+    const auto raw = static_cast<size_t>(status);
+    return raw < N ? table[raw] : "Unknown";
+}
+
+// Everything that goes over the air, one bit each in a FieldMask
+enum class Field : uint8_t
+{
+    Power,
+    TotalVoltage,
+    Current,
+    StateOfCharge,
+    CapacityRemaining,
+    ChargeMosfetStatus,
+    DischargeMosfetStatus,
+    BalancerStatus,
+    DeltaCellVoltage,
+    MaxCellVoltage,
+    MinCellVoltage,
+    BalancerTemperature,
+    MosfetTemperature,
+    StateOfHealth,
+    TotalBatteryCapacitySetting,
+    BatteryCycleCapacity,
+    TotalRuntime,
+    BalancedCellBitmask,
+    MaxVoltageCell,
+    MinVoltageCell,
+    AccumulatedChargingCapacity,
+    AccumulatedDischargingTime,
+    AccumulatedChargingTime,
+    AverageCellVoltage,
+    AccumulatedDischargingCapacity,
+    ChargeMosfetStatusString,
+    DischargeMosfetStatusString,
+    BalancerStatusString,
+    AccumulatedDischargingTimeFormatted,
+    AccumulatedChargingTimeFormatted,
+    HardwareVersion,
+    SoftwareVersion,
+    TotalRuntimeFormatted,
+    CellVoltages,
+    Temperatures,
+    PackedCellVoltages,
+    EnergyIn,
+    EnergyOut,
+    AverageCurrent,
+    CRate,
+    ImbalanceTrend,
+    InternalResistance,
+    Count
+};
+
+constexpr static const size_t FIELD_COUNT = static_cast<size_t>(Field::Count);
+
+using FieldMask = uint64_t;
+static_assert(FIELD_COUNT <= sizeof(FieldMask) * 8);
+
+constexpr FieldMask field_bit(Field field)
+{
+    return FieldMask{1} << static_cast<uint8_t>(field);
+}
+
+template<typename... Fields>
+constexpr FieldMask field_mask(Fields... fields)
+{
+    return (field_bit(fields) | ...);
+}
+
+constexpr static const FieldMask ALL_FIELDS = (FieldMask{1} << FIELD_COUNT) - 1;
+
 struct AntBmsData
 {
     BatteryStatus battery_status;
@@ -101,7 +234,6 @@ struct AntBmsData
     float capacity_remaining;
     float battery_cycle_capacity;
     uint32_t total_runtime;
-    std::string total_runtime_formatted;
     std::vector<float> cell_voltages;
     std::vector<float> temperatures;
     uint32_t balanced_cell_bitmask;
@@ -114,20 +246,45 @@ struct AntBmsData
     float accumulated_discharging_capacity;
     float accumulated_charging_capacity;
     float accumulated_discharging_time;
-    std::string accumulated_discharging_time_formatted;
     float accumulated_charging_time;
-    std::string accumulated_charging_time_formatted;
 
     ChargeMosfetStatus charge_mosfet_status;
-    std::string charge_mosfet_status_string;
     DischargeMosfetStatus discharge_mosfet_status;
-    std::string discharge_mosfet_status_string;
     BalancerStatus balancer_status;
-    std::string balancer_status_string;
 
     std::string hardware_version;
     std::string software_version;
 
+    // derived on the node, see Analytics
+    float energy_in;           // Wh charged since boot
+    float energy_out;          // Wh discharged since boot
+    float average_current;     // A, exponentially weighted
+    float c_rate;              // average current / capacity
+    float imbalance_trend;     // mV/h change of the cell voltage delta
+    float internal_resistance; // mOhm, pack level
+
+    // synchronized time in us the status frame started arriving, 0 while not synced, see espnow::TimeSync
+    int64_t timestamp_us{};
+
+    // derived strings, only formatted when a serializer asks for them
+    [[nodiscard]] const char *chargeMosfetStatusString() const
+    { return status_string(CHARGE_MOSFET_STATUS_STRINGS, charge_mosfet_status); }
+
+    [[nodiscard]] const char *dischargeMosfetStatusString() const
+    { return status_string(DISCHARGE_MOSFET_STATUS_STRINGS, discharge_mosfet_status); }
+
+    [[nodiscard]] const char *balancerStatusString() const
+    { return status_string(BALANCER_STATUS_STRINGS, balancer_status); }
+
+    [[nodiscard]] helpers::FormattedDuration totalRuntimeFormatted() const
+    { return helpers::FormattedDuration{total_runtime}; }
+
+    [[nodiscard]] helpers::FormattedDuration accumulatedDischargingTimeFormatted() const
+    { return helpers::FormattedDuration{static_cast<uint32_t>(accumulated_discharging_time)}; }
+
+    [[nodiscard]] helpers::FormattedDuration accumulatedChargingTimeFormatted() const
+    { return helpers::FormattedDuration{static_cast<uint32_t>(accumulated_charging_time)}; }
+
     [[nodiscard]] std::string toString() const
     {
         ArduinoJson::StaticJsonDocument<1024> doc;
@@ -155,6 +312,290 @@ struct AntBmsData
         return fmt::format("BMS:{}", json);
     }
 
+    // Single pass encoder writing "BMS:{...}" with the selected fields straight
+    // into a transmit buffer. Same keys as toJSON()/toRareJSON(), returns the
+    // number of bytes written.
+    std::expected<size_t, std::string> encodeFields(std::span<char> buffer, FieldMask fields) const
+    {
+        helpers::JsonWriter writer{buffer};
+        writer.raw("BMS:");
+        writer.begin_object();
+
+        // every frame says which reading it comes from
+        if (timestamp_us)
+        {
+            writer.field("ts", timestamp_us);
+        }
+
+        const auto has = [fields](Field field) { return (fields & field_bit(field)) != 0; };
+
+        if (has(Field::Power))
+        {
+            writer.field("pwr", power);
+        }
+        if (has(Field::TotalVoltage))
+        {
+            writer.field("tvo", total_voltage);
+        }
+        if (has(Field::Current))
+        {
+            writer.field("cur", current);
+        }
+        if (has(Field::StateOfCharge))
+        {
+            writer.field("soc", state_of_charge);
+        }
+        if (has(Field::CapacityRemaining))
+        {
+            writer.field("cre", capacity_remaining);
+        }
+        if (has(Field::ChargeMosfetStatus))
+        {
+            writer.field("cms", charge_mosfet_status);
+        }
+        if (has(Field::DischargeMosfetStatus))
+        {
+            writer.field("dms", discharge_mosfet_status);
+        }
+        // toJSON() assigns "bst" twice, only the balancer status survives
+        if (has(Field::BalancerStatus))
+        {
+            writer.field("bst", balancer_status);
+        }
+        if (has(Field::DeltaCellVoltage))
+        {
+            writer.field("dcv", delta_cell_voltage);
+        }
+        if (has(Field::MaxCellVoltage))
+        {
+            writer.field("mcv", max_cell_voltage);
+        }
+        if (has(Field::MinCellVoltage))
+        {
+            writer.field("miv", min_cell_voltage);
+        }
+        if (has(Field::BalancerTemperature))
+        {
+            writer.field("bte", balancer_temperature);
+        }
+        if (has(Field::MosfetTemperature))
+        {
+            writer.field("mot", mosfet_temperature);
+        }
+        if (has(Field::StateOfHealth))
+        {
+            writer.field("soh", state_of_health);
+        }
+        if (has(Field::TotalBatteryCapacitySetting))
+        {
+            writer.field("tbc", total_battery_capacity_setting);
+        }
+        if (has(Field::BatteryCycleCapacity))
+        {
+            writer.field("bcc", battery_cycle_capacity);
+        }
+        if (has(Field::TotalRuntime))
+        {
+            writer.field("trt", total_runtime);
+        }
+        if (has(Field::BalancedCellBitmask))
+        {
+            writer.field("bcb", balanced_cell_bitmask);
+        }
+        if (has(Field::MaxVoltageCell))
+        {
+            writer.field("mvc", max_voltage_cell);
+        }
+        if (has(Field::MinVoltageCell))
+        {
+            writer.field("mic", min_voltage_cell);
+        }
+        if (has(Field::AccumulatedChargingCapacity))
+        {
+            writer.field("acc", accumulated_charging_capacity);
+        }
+        if (has(Field::AccumulatedDischargingTime))
+        {
+            writer.field("adt", accumulated_discharging_time);
+        }
+        if (has(Field::AccumulatedChargingTime))
+        {
+            writer.field("act", accumulated_charging_time);
+        }
+        if (has(Field::AverageCellVoltage))
+        {
+            writer.field("acv", average_cell_voltage);
+        }
+        if (has(Field::AccumulatedDischargingCapacity))
+        {
+            writer.field("adc", accumulated_discharging_capacity);
+        }
+        if (has(Field::ChargeMosfetStatusString))
+        {
+            writer.field("css", chargeMosfetStatusString());
+        }
+        if (has(Field::DischargeMosfetStatusString))
+        {
+            writer.field("dss", dischargeMosfetStatusString());
+        }
+        if (has(Field::BalancerStatusString))
+        {
+            writer.field("bss", balancerStatusString());
+        }
+        if (has(Field::AccumulatedDischargingTimeFormatted))
+        {
+            writer.field("dtf", accumulatedDischargingTimeFormatted().view());
+        }
+        if (has(Field::AccumulatedChargingTimeFormatted))
+        {
+            writer.field("ctf", accumulatedChargingTimeFormatted().view());
+        }
+        if (has(Field::HardwareVersion))
+        {
+            writer.field("hrd", hardware_version.c_str());
+        }
+        if (has(Field::SoftwareVersion))
+        {
+            writer.field("sft", software_version.c_str());
+        }
+        if (has(Field::TotalRuntimeFormatted))
+        {
+            writer.field("trf", totalRuntimeFormatted().view());
+        }
+
+        if (has(Field::CellVoltages))
+        {
+            writer.begin_array("vol");
+            for (const auto &cell_voltage: cell_voltages)
+            {
+                // the BMS reports whole mV, the float digits past them keep 32 cells from fitting a frame
+                writer.add_milli(static_cast<int32_t>(std::lround(cell_voltage * 1000.f)));
+            }
+            writer.end_array();
+        }
+
+        if (has(Field::Temperatures))
+        {
+            writer.begin_array("tmp");
+            for (const auto &temperature: temperatures)
+            {
+                writer.add(temperature);
+            }
+            writer.end_array();
+        }
+
+        if (has(Field::EnergyIn))
+        {
+            writer.field("ein", energy_in);
+        }
+        if (has(Field::EnergyOut))
+        {
+            writer.field("eou", energy_out);
+        }
+        if (has(Field::AverageCurrent))
+        {
+            writer.field("cav", average_current);
+        }
+        if (has(Field::CRate))
+        {
+            writer.field("crt", c_rate);
+        }
+        if (has(Field::ImbalanceTrend))
+        {
+            writer.field("imt", imbalance_trend);
+        }
+        if (has(Field::InternalResistance))
+        {
+            writer.field("irs", internal_resistance);
+        }
+
+        if (has(Field::PackedCellVoltages))
+        {
+            if (auto packed = packCellVoltages(); packed)
+            {
+                writer.field("cvp", std::string_view{packed->data(), packed->size()});
+            }
+            else
+            {
+                return std::unexpected(packed.error());
+            }
+        }
+
+        writer.end_object();
+
+        return finish(writer);
+    }
+
+    struct PackedCells
+    {
+        std::array<char, helpers::base64_encoded_size(cellcodec::max_packed_size(cellcodec::MAX_CELLS))> buffer;
+        size_t length;
+
+        [[nodiscard]] const char *data() const
+        { return buffer.data(); }
+
+        [[nodiscard]] size_t size() const
+        { return length; }
+    };
+
+    // cell voltages as base64 of the cellcodec format
+    std::expected<PackedCells, std::string> packCellVoltages() const
+    {
+        const size_t cells = std::min(cell_voltages.size(), cellcodec::MAX_CELLS);
+
+        std::array<uint16_t, cellcodec::MAX_CELLS> cells_mv;
+        for (size_t i = 0; i < cells; i++)
+        {
+            cells_mv[i] = static_cast<uint16_t>(std::lround(cell_voltages[i] * 1000.f));
+        }
+
+        std::array<uint8_t, cellcodec::max_packed_size(cellcodec::MAX_CELLS)> packed;
+        const auto packed_size = cellcodec::pack({cells_mv.data(), cells}, packed);
+        if (!packed_size)
+        {
+            return std::unexpected(packed_size.error());
+        }
+
+        PackedCells result;
+        result.length = helpers::base64_encode({packed.data(), *packed_size}, result.buffer);
+        return result;
+    }
+
+    std::expected<void, std::string> unpackCellVoltages(std::string_view base64)
+    {
+        std::array<uint8_t, cellcodec::max_packed_size(cellcodec::MAX_CELLS)> packed;
+        const auto packed_size = helpers::base64_decode(base64, packed);
+        if (!packed_size)
+        {
+            return std::unexpected(packed_size.error());
+        }
+
+        std::array<uint16_t, cellcodec::MAX_CELLS> cells_mv;
+        const auto cells = cellcodec::unpack({packed.data(), *packed_size}, cells_mv);
+        if (!cells)
+        {
+            return std::unexpected(cells.error());
+        }
+
+        cell_voltages.clear();
+        for (size_t i = 0; i < *cells; i++)
+        {
+            cell_voltages.push_back(cells_mv[i] * 0.001f);
+        }
+
+        return {};
+    }
+
+    static std::expected<size_t, std::string> finish(const helpers::JsonWriter &writer)
+    {
+        if (writer.overflowed())
+        {
+            return std::unexpected(fmt::format("encoded frame does not fit into {} bytes", writer.capacity()));
+        }
+
+        return writer.size();
+    }
+
     std::expected<void, std::string> toJSON(JsonDocument &doc) const
     {
         doc.clear();
@@ -213,22 +654,22 @@ struct AntBmsData
         {
             doc["acv"] = average_cell_voltage;
             doc["adc"] = accumulated_discharging_capacity;
-            doc["css"] = charge_mosfet_status_string.c_str();
+            doc["css"] = chargeMosfetStatusString();
             counter++;
         }
         else if (counter == 5)
         {
-            doc["dss"] = discharge_mosfet_status_string.c_str();
-            doc["bss"] = balancer_status_string.c_str();
-            doc["dtf"] = accumulated_discharging_time_formatted.c_str();
+            doc["dss"] = dischargeMosfetStatusString();
+            doc["bss"] = balancerStatusString();
+            doc["dtf"] = std::string{accumulatedDischargingTimeFormatted().view()};
             counter++;
         }
         else if (counter == 6)
         {
-            doc["ctf"] = accumulated_charging_time_formatted.c_str();
+            doc["ctf"] = std::string{accumulatedChargingTimeFormatted().view()};
             doc["hrd"] = hardware_version.c_str();
             doc["sft"] = software_version.c_str();
-            doc["trf"] = total_runtime_formatted.c_str();
+            doc["trf"] = std::string{totalRuntimeFormatted().view()};
             counter++;
         }
         else if (counter == 7)
@@ -256,6 +697,11 @@ struct AntBmsData
 
     void parseDoc(const JsonDocument &doc)
     {
+        if (doc.containsKey("ts"))
+        {
+            timestamp_us = doc["ts"].as<int64_t>();
+        }
+
         if (doc.containsKey("pwr"))
         {
             power = doc["pwr"].as<float>();
@@ -386,58 +832,72 @@ struct AntBmsData
             accumulated_discharging_capacity = doc["adc"].as<float>();
         }
 
-        if (doc.containsKey("css"))
+        // css, dss, bss, dtf, ctf and trf are derived from cms, dms, bst, adt, act and trt, see the accessors above
+
+        if (doc.containsKey("hrd"))
+        {
+            hardware_version = doc["hrd"].as<std::string>();
+        }
+
+        if (doc.containsKey("sft"))
         {
-            charge_mosfet_status_string = doc["css"].as<std::string>();
+            software_version = doc["sft"].as<std::string>();
         }
 
-        if (doc.containsKey("dss"))
+        if (doc.containsKey("vol"))
         {
-            discharge_mosfet_status_string = doc["dss"].as<std::string>();
+            // always the complete list, parsing into the previous state must not append
+            auto cell_voltages_json = doc["vol"].as<JsonArrayConst>();
+            cell_voltages.clear();
+            for (const auto &cell_voltage_json: cell_voltages_json)
+            {
+                cell_voltages.push_back(cell_voltage_json.as<float>());
+            }
         }
 
-        if (doc.containsKey("bss"))
+        if (doc.containsKey("ein"))
         {
-            balancer_status_string = doc["bss"].as<std::string>();
+            energy_in = doc["ein"].as<float>();
         }
 
-        if (doc.containsKey("dtf"))
+        if (doc.containsKey("eou"))
         {
-            accumulated_discharging_time_formatted = doc["dtf"].as<std::string>();
+            energy_out = doc["eou"].as<float>();
         }
 
-        if (doc.containsKey("ctf"))
+        if (doc.containsKey("cav"))
         {
-            accumulated_charging_time_formatted = doc["ctf"].as<std::string>();
+            average_current = doc["cav"].as<float>();
         }
 
-        if (doc.containsKey("hrd"))
+        if (doc.containsKey("crt"))
         {
-            hardware_version = doc["hrd"].as<std::string>();
+            c_rate = doc["crt"].as<float>();
         }
 
-        if (doc.containsKey("sft"))
+        if (doc.containsKey("imt"))
         {
-            software_version = doc["sft"].as<std::string>();
+            imbalance_trend = doc["imt"].as<float>();
         }
 
-        if (doc.containsKey("trf"))
+        if (doc.containsKey("irs"))
         {
-            total_runtime_formatted = doc["trf"].as<std::string>();
+            internal_resistance = doc["irs"].as<float>();
         }
 
-        if (doc.containsKey("vol"))
+        if (doc.containsKey("cvp"))
         {
-            auto cell_voltages_json = doc["vol"].as<JsonArrayConst>();
-            for (const auto &cell_voltage_json: cell_voltages_json)
+            // the packed vector is complete, it replaces whatever "vol" delivered
+            if (auto result = unpackCellVoltages(doc["cvp"].as<std::string>()); !result)
             {
-                cell_voltages.push_back(cell_voltage_json.as<float>());
+                cell_voltages.clear();
             }
         }
 
         if (doc.containsKey("tmp"))
         {
             auto temperatures_json = doc["tmp"].as<JsonArrayConst>();
+            temperatures.clear();
             for (const auto &temperature_json: temperatures_json)
             {
                 temperatures.push_back(temperature_json.as<float>());
@@ -0,0 +1,202 @@
+#include "dirtytracker.h"
+
+// system includes
+#include <algorithm>
+#include <cmath>
+
+namespace antbms {
+
+DirtyTracker::DirtyTracker()
+{
+    // roughly the noise floor of the ANT readings, fields not listed here count every change
+    set_deadband(Field::Power, 5.f);
+    set_deadband(Field::TotalVoltage, 0.02f);
+    set_deadband(Field::Current, 0.2f);
+    set_deadband(Field::CapacityRemaining, 0.01f);
+    set_deadband(Field::DeltaCellVoltage, 0.002f);
+    set_deadband(Field::MaxCellVoltage, 0.002f);
+    set_deadband(Field::MinCellVoltage, 0.002f);
+    set_deadband(Field::AverageCellVoltage, 0.002f);
+    set_deadband(Field::CellVoltages, 0.002f);
+    set_deadband(Field::PackedCellVoltages, 0.002f);
+    set_deadband(Field::BalancerTemperature, 1.f);
+    set_deadband(Field::MosfetTemperature, 1.f);
+    set_deadband(Field::Temperatures, 1.f);
+    // runtime counters tick every second, the formatted strings only every hour
+    set_deadband(Field::TotalRuntime, 60.f);
+    set_deadband(Field::AccumulatedDischargingTime, 60.f);
+    set_deadband(Field::AccumulatedChargingTime, 60.f);
+    set_deadband(Field::EnergyIn, 0.5f);
+    set_deadband(Field::EnergyOut, 0.5f);
+    set_deadband(Field::AverageCurrent, 0.1f);
+    set_deadband(Field::CRate, 0.005f);
+    set_deadband(Field::ImbalanceTrend, 0.5f);
+    set_deadband(Field::InternalResistance, 0.5f);
+}
+
+void DirtyTracker::update(const AntBmsData &data)
+{
+    std::lock_guard lock{m_mutex};
+
+    compare(Field::Power, data.power);
+    compare(Field::TotalVoltage, data.total_voltage);
+    compare(Field::Current, data.current);
+    compare(Field::StateOfCharge, data.state_of_charge);
+    compare(Field::CapacityRemaining, data.capacity_remaining);
+    compare(Field::ChargeMosfetStatus, static_cast<uint8_t>(data.charge_mosfet_status),
+            field_bit(Field::ChargeMosfetStatusString));
+    compare(Field::DischargeMosfetStatus, static_cast<uint8_t>(data.discharge_mosfet_status),
+            field_bit(Field::DischargeMosfetStatusString));
+    compare(Field::BalancerStatus, static_cast<uint8_t>(data.balancer_status),
+            field_bit(Field::BalancerStatusString));
+    compare(Field::DeltaCellVoltage, data.delta_cell_voltage);
+    compare(Field::MaxCellVoltage, data.max_cell_voltage);
+    compare(Field::MinCellVoltage, data.min_cell_voltage);
+    compare(Field::BalancerTemperature, data.balancer_temperature);
+    compare(Field::MosfetTemperature, data.mosfet_temperature);
+    compare(Field::StateOfHealth, data.state_of_health);
+    compare(Field::TotalBatteryCapacitySetting, data.total_battery_capacity_setting);
+    compare(Field::BatteryCycleCapacity, data.battery_cycle_capacity);
+    compare(Field::TotalRuntime, data.total_runtime, field_bit(Field::TotalRuntimeFormatted));
+    compare(Field::BalancedCellBitmask, data.balanced_cell_bitmask);
+    compare(Field::MaxVoltageCell, data.max_voltage_cell);
+    compare(Field::MinVoltageCell, data.min_voltage_cell);
+    compare(Field::AccumulatedChargingCapacity, data.accumulated_charging_capacity);
+    compare(Field::AccumulatedDischargingTime, data.accumulated_discharging_time,
+            field_bit(Field::AccumulatedDischargingTimeFormatted));
+    compare(Field::AccumulatedChargingTime, data.accumulated_charging_time,
+            field_bit(Field::AccumulatedChargingTimeFormatted));
+    compare(Field::AverageCellVoltage, data.average_cell_voltage);
+    compare(Field::AccumulatedDischargingCapacity, data.accumulated_discharging_capacity);
+    compare(Field::EnergyIn, data.energy_in);
+    compare(Field::EnergyOut, data.energy_out);
+    compare(Field::AverageCurrent, data.average_current);
+    compare(Field::CRate, data.c_rate);
+    compare(Field::ImbalanceTrend, data.imbalance_trend);
+    compare(Field::InternalResistance, data.internal_resistance);
+    compare(Field::CellVoltages, data.cell_voltages);
+    compare(Field::Temperatures, data.temperatures);
+    // same values, but sent on its own schedule, so it needs its own reference
+    compare(Field::PackedCellVoltages, data.cell_voltages);
+
+    m_published = data;
+}
+
+void DirtyTracker::mark(FieldMask fields, const AntBmsData &data)
+{
+    std::lock_guard lock{m_mutex};
+    m_dirty |= fields;
+    m_updated |= fields;
+    m_published = data;
+}
+
+FieldMask DirtyTracker::dirty() const
+{
+    std::lock_guard lock{m_mutex};
+    return m_dirty;
+}
+
+FieldMask DirtyTracker::start_encode(AntBmsData &data)
+{
+    std::lock_guard lock{m_mutex};
+    m_updated = 0;
+    data = m_published;
+    return m_dirty;
+}
+
+void DirtyTracker::latest(AntBmsData &data) const
+{
+    std::lock_guard lock{m_mutex};
+    data = m_published;
+}
+
+void DirtyTracker::sent(FieldMask fields)
+{
+    std::lock_guard lock{m_mutex};
+
+    // which of two values went out for these is unknown, keep the old reference
+    fields &= ~m_updated;
+
+    for (size_t i = 0; i < FIELD_COUNT; i++)
+    {
+        if (fields & field_bit(static_cast<Field>(i)))
+        {
+            m_reference[i] = m_latest[i];
+        }
+    }
+
+    for (const auto field : {Field::CellVoltages, Field::Temperatures, Field::PackedCellVoltages})
+    {
+        if (fields & field_bit(field))
+        {
+            const auto slot = vector_slot(field);
+            m_reference_vectors[slot] = m_latest_vectors[slot];
+        }
+    }
+
+    m_dirty &= ~fields;
+}
+
+void DirtyTracker::reset()
+{
+    std::lock_guard lock{m_mutex};
+    m_dirty = ALL_FIELDS;
+}
+
+void DirtyTracker::compare(Field field, double value, FieldMask derived)
+{
+    const auto index = static_cast<size_t>(field);
+    if (value != m_latest[index])
+    {
+        m_updated |= field_bit(field) | derived;
+    }
+    m_latest[index] = value;
+
+    if (std::fabs(value - m_reference[index]) > m_deadbands[index])
+    {
+        m_dirty |= field_bit(field) | derived;
+    }
+}
+
+void DirtyTracker::compare(Field field, std::span<const float> values)
+{
+    const auto slot = vector_slot(field);
+    auto &latest = m_latest_vectors[slot];
+    const auto &reference = m_reference_vectors[slot];
+    const auto deadband = m_deadbands[static_cast<size_t>(field)];
+
+    const uint8_t size = std::min(values.size(), MAX_VECTOR_SIZE);
+    if (size != latest.size || !std::equal(values.begin(), values.begin() + size, latest.values.begin()))
+    {
+        m_updated |= field_bit(field);
+    }
+
+    latest.size = size;
+    std::copy_n(values.begin(), latest.size, latest.values.begin());
+
+    bool changed = latest.size != reference.size;
+    for (uint8_t i = 0; i < latest.size && !changed; i++)
+    {
+        changed = std::fabs(latest.values[i] - reference.values[i]) > deadband;
+    }
+
+    if (changed)
+    {
+        m_dirty |= field_bit(field);
+    }
+}
+
+size_t DirtyTracker::vector_slot(Field field)
+{
+    switch (field)
+    {
+    case Field::CellVoltages:
+        return 0;
+    case Field::Temperatures:
+        return 1;
+    default:
+        return 2;
+    }
+}
+
+} // namespace antbms
@@ -0,0 +1,83 @@
+#pragma once
+
+// system includes
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <span>
+
+// local includes
+#include "datastructure.h"
+
+namespace antbms {
+
+/// Remembers which fields changed since they were last sent. Analog values only
+/// count as changed once they moved further than their deadband away from the
+/// value that was last sent, so noise alone does not keep a field dirty.
+///
+/// update() runs on the NimBLE host task after every decoded frame and keeps a copy
+/// of the data, start_encode() and sent() run on the main loop, which encodes that
+/// copy and never the decoder's own AntBmsData. Everything is guarded by one mutex.
+/// A field that was updated between start_encode() and sent() stays dirty, its
+/// reference keeps the old value.
+class DirtyTracker
+{
+public:
+    constexpr static const size_t MAX_VECTOR_SIZE = 32;
+
+    DirtyTracker();
+
+    void set_deadband(Field field, float deadband)
+    { m_deadbands[static_cast<size_t>(field)] = deadband; }
+
+    [[nodiscard]] float deadband(Field field) const
+    { return m_deadbands[static_cast<size_t>(field)]; }
+
+    /// compares \p data against the last sent values and publishes a copy of it
+    void update(const AntBmsData &data);
+
+    /// flag fields as changed regardless of their value and publish \p data, e.g. after a device info frame
+    void mark(FieldMask fields, const AntBmsData &data);
+
+    [[nodiscard]] FieldMask dirty() const;
+
+    /// call right before encoding, copies the published data into \p data and returns the dirty fields
+    FieldMask start_encode(AntBmsData &data);
+
+    /// copies the published data into \p data without starting an encode
+    void latest(AntBmsData &data) const;
+
+    /// fields went out, their values become the new reference unless they changed since start_encode()
+    void sent(FieldMask fields);
+
+    void reset();
+
+private:
+    struct VectorValue
+    {
+        std::array<float, MAX_VECTOR_SIZE> values{};
+        uint8_t size{};
+    };
+
+    void compare(Field field, double value, FieldMask derived = 0);
+    void compare(Field field, std::span<const float> values);
+
+    static size_t vector_slot(Field field);
+
+    std::array<float, FIELD_COUNT> m_deadbands{};
+    std::array<double, FIELD_COUNT> m_latest{};
+    std::array<double, FIELD_COUNT> m_reference{};
+
+    // cell voltages, temperatures and packed cell voltages
+    std::array<VectorValue, 3> m_latest_vectors{};
+    std::array<VectorValue, 3> m_reference_vectors{};
+
+    mutable std::mutex m_mutex;
+    // assigned in place, the vectors and strings keep their capacity between frames
+    AntBmsData m_published{};
+    FieldMask m_dirty = ALL_FIELDS;
+    // fields whose latest value changed since start_encode()
+    FieldMask m_updated = 0;
+};
+
+} // namespace antbms
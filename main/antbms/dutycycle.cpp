@@ -0,0 +1,153 @@
+#include "dutycycle.h"
+
+// system includes
+#include <algorithm>
+
+// esp-idf includes
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <sdkconfig.h>
+#if CONFIG_PM_ENABLE
+#include <esp_pm.h>
+#endif
+
+// local includes
+#include "espnow.h"
+
+namespace antbms {
+
+namespace {
+
+constexpr const char * const TAG = "DutyCycle";
+
+// loop cadence while busy, what the loop always did
+constexpr const int64_t BUSY_INTERVAL_US = 50'000;
+
+// a command usually gets answered or followed up within that
+constexpr const int64_t COMMAND_HOLD_US = 1'000'000;
+
+} // namespace
+
+bool DutyCycle::enable_light_sleep()
+{
+#if CONFIG_PM_ENABLE
+    esp_pm_config_t config{
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = 40,
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+        .light_sleep_enable = true,
+#else
+        .light_sleep_enable = false,
+#endif
+    };
+
+    if (auto err = esp_pm_configure(&config); err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "esp_pm_configure failed: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    return config.light_sleep_enable;
+#else
+    ESP_LOGW(TAG, "Built without CONFIG_PM_ENABLE, the CPU stays clocked while the loop sleeps");
+    return false;
+#endif
+}
+
+void DutyCycle::sleep(espchrono::millis_clock::time_point deadline, bool busy)
+{
+    const auto now_us = esp_timer_get_time();
+    if (m_woke_at)
+    {
+        awake_us += now_us - m_woke_at;
+    }
+
+    busy = busy || (espnow::last_message_us() && now_us - espnow::last_message_us() < COMMAND_HOLD_US);
+
+    if (!m_radio_changed_at)
+    {
+        m_radio_changed_at = now_us;
+    }
+
+    if (const bool radio_awake = espnow::radio_awake(); busy != radio_awake && espnow::power_save_enabled())
+    {
+        if (radio_awake)
+        {
+            radio_awake_us += now_us - m_radio_changed_at;
+        }
+        m_radio_changed_at = now_us;
+        espnow::set_radio_awake(busy);
+    }
+
+    const auto budget_us = std::chrono::duration_cast<std::chrono::microseconds>(m_latency_budget).count();
+    auto sleep_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            deadline - espchrono::millis_clock::now()).count();
+
+    if (busy)
+    {
+        busy_sleeps++;
+        sleep_us = std::min(sleep_us, BUSY_INTERVAL_US);
+    }
+    else if (sleep_us > budget_us)
+    {
+        capped++;
+        sleep_us = budget_us;
+    }
+    sleep_us = std::max<int64_t>(sleep_us, 0);
+
+    // rounded up, waking a tick early only costs another round through the loop
+    const auto tick_us = int64_t{portTICK_PERIOD_MS} * 1000;
+    const auto woken = ulTaskNotifyTake(pdTRUE, (sleep_us + tick_us - 1) / tick_us);
+
+    m_woke_at = esp_timer_get_time();
+    asleep_us += m_woke_at - now_us;
+    sleeps.add(m_woke_at - now_us);
+    wakeups++;
+
+    if (woken)
+    {
+        notified++;
+    }
+    else
+    {
+        lateness.add(std::max<int64_t>(m_woke_at - now_us - sleep_us, 0));
+    }
+}
+
+void DutyCycle::log(const char *tag)
+{
+    const auto now_us = esp_timer_get_time();
+    if (espnow::radio_awake() && m_radio_changed_at)
+    {
+        radio_awake_us += now_us - m_radio_changed_at;
+        m_radio_changed_at = now_us;
+    }
+
+    const auto total_us = std::max<int64_t>(awake_us + asleep_us, 1);
+    // kept awake the radio always listens, otherwise for its wake window
+    const auto radio_on = (radio_awake_us + (total_us - std::min(radio_awake_us, total_us)) *
+                           espnow::radio_listen_ratio()) / total_us;
+
+    auto &rx_latency = espnow::rx_latency();
+
+    ESP_LOGI(tag, "Duty cycle: awake=%.1f%% radio=%.1f%% wakeups=%ld (%.1f/s) notified=%ld capped=%ld busy=%ld "
+                  "sleep avg=%lldms max=%lldms late avg=%lldus max=%lldus rx latency avg=%lldms max=%lldms",
+             awake_us * 100.f / total_us, radio_on * 100.f, wakeups, wakeups * 1e6f / total_us, notified, capped, busy_sleeps,
+             sleeps.avg_us() / 1000, sleeps.max_us / 1000, lateness.avg_us(), lateness.max_us,
+             rx_latency.avg_us() / 1000, rx_latency.max_us / 1000);
+
+    awake_us = 0;
+    asleep_us = 0;
+    radio_awake_us = 0;
+    wakeups = 0;
+    notified = 0;
+    capped = 0;
+    busy_sleeps = 0;
+    sleeps.reset();
+    lateness.reset();
+    rx_latency.reset();
+}
+
+} // namespace antbms
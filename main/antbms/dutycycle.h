@@ -0,0 +1,69 @@
+#pragma once
+
+// system includes
+#include <cstdint>
+
+// 3rdparty includes
+#include <espchrono.h>
+
+// local includes
+#include "helpers/durationstats.h"
+
+namespace antbms {
+
+/// Sleeps the main loop until the next scheduled poll or telemetry slot
+/// instead of waking every 50ms, but never longer than the latency budget,
+/// which bounds how long received commands wait for handle(). A completed
+/// status frame still wakes the loop right away.
+///
+/// While busy (an alarm waiting for its ACK, a command handled within the last
+/// second, no BMS connection yet) the loop keeps its 50ms cadence and the
+/// radio is kept listening, see espnow::set_radio_awake().
+///
+/// The loop only waits on its task notification, the CPU light sleeps through
+/// that with CONFIG_PM_ENABLE and tickless idle, see enable_light_sleep(). With
+/// BLE running, the controller blocks light sleep unless its low power clock is
+/// a 32kHz crystal, the CPU still drops to 40MHz then.
+class DutyCycle
+{
+public:
+    void set_latency_budget(espchrono::millis_clock::duration budget)
+    { m_latency_budget = budget; }
+
+    [[nodiscard]] espchrono::millis_clock::duration latency_budget() const
+    { return m_latency_budget; }
+
+    /// lets the CPU light sleep whenever all tasks are blocked, false if the
+    /// firmware was built without power management
+    bool enable_light_sleep();
+
+    /// blocks until \p deadline, at most for the latency budget, or until the task gets notified
+    void sleep(espchrono::millis_clock::time_point deadline, bool busy);
+
+    /// logs and resets the stats
+    void log(const char *tag);
+
+    // per stats window
+    int64_t awake_us{};
+    int64_t asleep_us{};
+    int64_t radio_awake_us{};
+    uint32_t wakeups{};
+    // woken early by a completed status frame
+    uint32_t notified{};
+    // deadline further out than the latency budget
+    uint32_t capped{};
+    // sleeps cut short because there was something to do
+    uint32_t busy_sleeps{};
+    helpers::DurationStats sleeps;
+    // woke up after the deadline by, tick granularity
+    helpers::DurationStats lateness;
+
+private:
+    espchrono::millis_clock::duration m_latency_budget = std::chrono::milliseconds{200};
+
+    int64_t m_woke_at = 0;
+    // the radio state itself is espnow::radio_awake()
+    int64_t m_radio_changed_at = 0;
+};
+
+} // namespace antbms
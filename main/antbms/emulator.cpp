@@ -0,0 +1,253 @@
+#include "emulator.h"
+
+// system includes
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+// local includes
+#include "frame.h"
+
+namespace antbms {
+
+namespace {
+constexpr const uint8_t COMMAND_STATUS = 0x01;
+// a register range read, the device info lives at 0x026c
+constexpr const uint8_t COMMAND_DEVICE_INFO = 0x02;
+constexpr const uint16_t DEVICE_INFO_ADDRESS = 0x026c;
+constexpr const uint8_t COMMAND_WRITE_REGISTER = 0x51;
+
+// responses carry the command function + 0x10
+constexpr const uint8_t RESPONSE_OFFSET = 0x10;
+
+constexpr const uint16_t ATT_NOTIFY_OVERHEAD = 3;
+constexpr const uint16_t MIN_NOTIFY_PAYLOAD = 20;
+
+// fixed part of the status frame besides cells and temperature sensors
+constexpr const size_t STATUS_DATA_SIZE = 106;
+
+constexpr const char HARDWARE_VERSION[] = "16ZMB";
+constexpr const char SOFTWARE_VERSION[] = "16ZMUB00-211026A";
+
+void put_16bit(std::vector<uint8_t> &data, size_t i, uint16_t value)
+{
+    data[i + 0] = value >> 0;
+    data[i + 1] = value >> 8;
+}
+
+void put_32bit(std::vector<uint8_t> &data, size_t i, uint32_t value)
+{
+    put_16bit(data, i + 0, value >> 0);
+    put_16bit(data, i + 2, value >> 16);
+}
+
+std::vector<uint8_t> build_frame(uint8_t function, uint16_t address, uint8_t value, std::span<const uint8_t> payload)
+{
+    std::vector<uint8_t> frame(ANT_FRAME_OVERHEAD + payload.size());
+    detail::fill_frame(frame.data(), function, address, value, payload.data(), payload.size());
+    return frame;
+}
+} // namespace
+
+Emulator::Emulator(const Config &config) :
+        m_config{config}, m_random{config.seed}
+{
+    m_config.cells = std::max<uint8_t>(m_config.cells, 1);
+}
+
+void Emulator::write(std::span<const uint8_t> frame, int64_t now_us)
+{
+    if (m_start_us < 0)
+    {
+        m_start_us = now_us;
+    }
+
+    if (frame.size() < ANT_FRAME_OVERHEAD || frame[0] != ANT_PKT_START_1 || frame[1] != ANT_PKT_START_2)
+    {
+        return;
+    }
+
+    const size_t crc_pos = frame.size() - 4;
+    const uint16_t crc = uint16_t(frame[crc_pos + 1]) << 8 | frame[crc_pos];
+    if (helpers::crc16(frame.data() + 1, crc_pos - 1) != crc)
+    {
+        // the real BMS stays silent on corrupted commands as well
+        return;
+    }
+
+    commands++;
+
+    const uint8_t function = frame[2];
+    const uint16_t address = uint16_t(frame[4]) << 8 | frame[3];
+    const uint8_t value = frame[5];
+
+    switch (function)
+    {
+    case COMMAND_STATUS:
+        queue(status_frame(now_us), now_us);
+        break;
+    case COMMAND_DEVICE_INFO:
+        queue(address == DEVICE_INFO_ADDRESS ? device_info_frame() : read_registers_frame(address, value), now_us);
+        break;
+    case COMMAND_WRITE_REGISTER:
+        m_registers[address % m_registers.size()] = value;
+        queue(write_register_frame(address, value), now_us);
+        break;
+    default:
+        // authenticate and friends are not answered
+        break;
+    }
+}
+
+void Emulator::poll(int64_t now_us, const notify_t &notify)
+{
+    while (!m_notifications.empty() && m_notifications.front().due_us <= now_us)
+    {
+        const auto notification = std::move(m_notifications.front());
+        m_notifications.pop_front();
+
+        notify(notification.data.data(), notification.data.size());
+    }
+}
+
+void Emulator::queue(const std::vector<uint8_t> &frame, int64_t now_us)
+{
+    const size_t chunk_size = std::max<uint16_t>(m_config.mtu - ATT_NOTIFY_OVERHEAD, MIN_NOTIFY_PAYLOAD);
+
+    // a busy BMS answers one command after the other
+    int64_t due_us = now_us + m_config.latency_us;
+    if (!m_notifications.empty())
+    {
+        due_us = std::max(due_us, m_notifications.back().due_us + m_config.notification_interval_us);
+    }
+
+    std::uniform_real_distribution<float> chance{0.f, 1.f};
+
+    for (size_t pos = 0; pos < frame.size(); pos += chunk_size)
+    {
+        if (m_config.loss_rate > 0.f && chance(m_random) < m_config.loss_rate)
+        {
+            notifications_dropped++;
+        }
+        else
+        {
+            const auto end = frame.begin() + std::min(pos + chunk_size, frame.size());
+            m_notifications.push_back(Notification{
+                .due_us = due_us,
+                .data = std::vector<uint8_t>(frame.begin() + pos, end),
+            });
+            notifications_sent++;
+        }
+
+        due_us += m_config.notification_interval_us;
+    }
+}
+
+std::vector<uint8_t> Emulator::status_frame(int64_t now_us)
+{
+    const uint8_t cells = m_config.cells;
+    const uint8_t sensors = m_config.temperature_sensors;
+    const float t = (now_us - m_start_us) / 1'000'000.f;
+
+    // slow charge / discharge cycle, cells sag and rise with the current
+    const float current = 12.f * std::sin(2.f * std::numbers::pi_v<float> * t / 120.f);
+    const float state_of_charge = 60.f + 20.f * std::sin(2.f * std::numbers::pi_v<float> * t / 3600.f);
+
+    std::vector<uint16_t> cell_mv(cells);
+    std::normal_distribution<float> noise{0.f, 1.5f};
+    for (uint8_t i = 0; i < cells; i++)
+    {
+        cell_mv[i] = static_cast<uint16_t>(3290.f + (i * 7 % 13) + current * 2.5f + noise(m_random));
+    }
+
+    const auto [min_it, max_it] = std::minmax_element(cell_mv.begin(), cell_mv.end());
+    uint32_t total_mv = 0;
+    for (const auto mv : cell_mv)
+    {
+        total_mv += mv;
+    }
+
+    // layout documented in AntBms::on_status_data_(), indices relative to byte 6
+    std::vector<uint8_t> data(STATUS_DATA_SIZE + cells * 2 + sensors * 2);
+    const auto at = [](size_t i) { return i - ANT_FRAME_HEADER_SIZE; };
+
+    data[at(6)] = 0x05;
+    data[at(7)] = current > 0.5f ? 2 : current < -0.5f ? 3 : 1;
+    data[at(8)] = sensors;
+    data[at(9)] = cells;
+
+    for (uint8_t i = 0; i < cells; i++)
+    {
+        put_16bit(data, at(34 + i * 2), cell_mv[i]);
+    }
+
+    size_t offset = cells * 2;
+    for (uint8_t i = 0; i < sensors; i++)
+    {
+        put_16bit(data, at(34 + offset + i * 2), static_cast<int16_t>(24 + i + std::abs(current) / 4));
+    }
+
+    offset += sensors * 2;
+    put_16bit(data, at(34 + offset), static_cast<int16_t>(28 + std::abs(current) / 2));
+    put_16bit(data, at(36 + offset), 27);
+    put_16bit(data, at(38 + offset), total_mv / 10);
+    put_16bit(data, at(40 + offset), static_cast<int16_t>(current * 10.f));
+    put_16bit(data, at(42 + offset), static_cast<uint16_t>(state_of_charge));
+    put_16bit(data, at(44 + offset), 100);
+    data[at(46 + offset)] = 0x01;
+    data[at(47 + offset)] = 0x01;
+    data[at(48 + offset)] = 0x00;
+    put_32bit(data, at(50 + offset), 30'000'000);
+    put_32bit(data, at(54 + offset), static_cast<uint32_t>(30'000'000 * state_of_charge / 100.f));
+    put_32bit(data, at(58 + offset), 21'256);
+    put_32bit(data, at(62 + offset), static_cast<int32_t>(total_mv / 1000.f * current));
+    put_32bit(data, at(66 + offset), 1'190'000 + static_cast<uint32_t>(t));
+    put_32bit(data, at(70 + offset), 0);
+    put_16bit(data, at(74 + offset), *max_it);
+    put_16bit(data, at(76 + offset), std::distance(cell_mv.begin(), max_it) + 1);
+    put_16bit(data, at(78 + offset), *min_it);
+    put_16bit(data, at(80 + offset), std::distance(cell_mv.begin(), min_it) + 1);
+    put_16bit(data, at(82 + offset), *max_it - *min_it);
+    put_16bit(data, at(84 + offset), total_mv / cells);
+    put_16bit(data, at(94 + offset), 0xfaf2);
+    put_32bit(data, at(96 + offset), 11'901);
+    put_32bit(data, at(100 + offset), 30'612);
+    put_32bit(data, at(104 + offset), 2'014 + static_cast<uint32_t>(t / 2));
+    put_32bit(data, at(108 + offset), 30'327 + static_cast<uint32_t>(t / 2));
+
+    return build_frame(COMMAND_STATUS + RESPONSE_OFFSET, 0x0000, data.size(), data);
+}
+
+std::vector<uint8_t> Emulator::device_info_frame() const
+{
+    std::array<uint8_t, 32> data{};
+    std::copy(std::begin(HARDWARE_VERSION), std::end(HARDWARE_VERSION) - 1, data.begin());
+    std::copy(std::begin(SOFTWARE_VERSION), std::end(SOFTWARE_VERSION) - 1, data.begin() + 16);
+
+    auto frame = build_frame(COMMAND_DEVICE_INFO + RESPONSE_OFFSET, DEVICE_INFO_ADDRESS, data.size(), data);
+
+    // the real frame has 6 more bytes between CRC and end of frame, so its length byte does not add up
+    frame.resize(frame.size() - 2);
+    frame.insert(frame.end(), {0xff, 0x0b, 0x00, 0x00, 0x41, 0xf2, ANT_PKT_END_1, ANT_PKT_END_2});
+
+    return frame;
+}
+
+std::vector<uint8_t> Emulator::read_registers_frame(uint16_t address, uint8_t length) const
+{
+    std::vector<uint8_t> data(length);
+    for (size_t i = 0; i < length; i++)
+    {
+        data[i] = register_value(address + i);
+    }
+
+    return build_frame(COMMAND_DEVICE_INFO + RESPONSE_OFFSET, address, data.size(), data);
+}
+
+std::vector<uint8_t> Emulator::write_register_frame(uint16_t address, uint8_t value) const
+{
+    const std::array<uint8_t, 1> data{value};
+    return build_frame(COMMAND_WRITE_REGISTER + RESPONSE_OFFSET, address, data.size(), data);
+}
+
+} // namespace antbms
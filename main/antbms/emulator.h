@@ -0,0 +1,99 @@
+#pragma once
+
+// system includes
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <random>
+#include <span>
+#include <vector>
+
+namespace antbms {
+
+/// Virtual ANT BMS speaking the same protocol as the real one. Answers status
+/// (0x01), device info and register reads (0x02) and write register (0x51)
+/// commands with frames split into MTU sized notifications, optionally
+/// dropping or delaying them.
+///
+/// Plain C++ without ESP-IDF dependencies, AntBms drives it in place of the
+/// BLE characteristic when enable_emulator() was called.
+class Emulator
+{
+public:
+    struct Config
+    {
+        // status frames grow by 2 bytes per cell and sensor, AntBms takes up to
+        // 152 bytes, which is cells + temperature_sensors <= 18
+        uint8_t cells = 14;
+        uint8_t temperature_sensors = 4;
+        uint16_t mtu = 23;
+        // probability for every single notification to get lost
+        float loss_rate = 0.f;
+        // delay between command and first notification
+        int64_t latency_us = 20'000;
+        // delay between two notifications of the same frame
+        int64_t notification_interval_us = 7'500;
+        uint32_t seed = 1;
+    };
+
+    using notify_t = std::function<void(const uint8_t *data, size_t length)>;
+
+    explicit Emulator(const Config &config);
+
+    /// command frame written by the client
+    void write(std::span<const uint8_t> frame, int64_t now_us);
+
+    /// delivers every notification that is due by \p now_us
+    void poll(int64_t now_us, const notify_t &notify);
+
+    /// due time of the next notification, nullopt if nothing is queued
+    [[nodiscard]] std::optional<int64_t> next_due_us() const
+    {
+        if (m_notifications.empty())
+        {
+            return std::nullopt;
+        }
+        return m_notifications.front().due_us;
+    }
+
+    [[nodiscard]] const Config &config() const
+    { return m_config; }
+
+    [[nodiscard]] uint8_t register_value(uint16_t address) const
+    { return m_registers[address % m_registers.size()]; }
+
+    void reset_stats()
+    {
+        commands = 0;
+        notifications_sent = 0;
+        notifications_dropped = 0;
+    }
+
+    uint32_t commands{};
+    uint32_t notifications_sent{};
+    uint32_t notifications_dropped{};
+
+private:
+    struct Notification
+    {
+        int64_t due_us;
+        std::vector<uint8_t> data;
+    };
+
+    std::vector<uint8_t> status_frame(int64_t now_us);
+    std::vector<uint8_t> device_info_frame() const;
+    std::vector<uint8_t> read_registers_frame(uint16_t address, uint8_t length) const;
+    std::vector<uint8_t> write_register_frame(uint16_t address, uint8_t value) const;
+
+    void queue(const std::vector<uint8_t> &frame, int64_t now_us);
+
+    Config m_config;
+    std::minstd_rand m_random;
+    std::deque<Notification> m_notifications;
+    std::array<uint8_t, 0x400> m_registers{};
+    int64_t m_start_us = -1;
+};
+
+} // namespace antbms
@@ -0,0 +1,70 @@
+#include "exportencoder.h"
+
+// system includes
+#include <algorithm>
+#include <cstring>
+
+// local includes
+#include "helpers/crc16.h"
+
+namespace antbms {
+
+size_t encode_export_frame(uint16_t sequence, const GatewayStore::SourceKey &key, const PackSnapshot &snapshot,
+                           std::span<uint8_t> out)
+{
+    std::array<uint8_t, EXPORT_FRAME_SIZE> frame;
+    frame[0] = EXPORT_VERSION;
+    frame[1] = EXPORT_TYPE_SNAPSHOT;
+    frame[2] = sequence & 0xFF;
+    frame[3] = sequence >> 8;
+    std::copy(key.mac.begin(), key.mac.end(), frame.begin() + 4);
+    frame[10] = key.pack_id;
+    std::memcpy(frame.data() + 11, &snapshot, sizeof(snapshot));
+
+    const auto crc = helpers::crc16(frame.data(), EXPORT_FRAME_SIZE - 2);
+    frame[EXPORT_FRAME_SIZE - 2] = crc & 0xFF;
+    frame[EXPORT_FRAME_SIZE - 1] = crc >> 8;
+
+    const auto encoded = helpers::cobs_encode(frame, out);
+    if (!encoded || encoded == out.size())
+    {
+        return 0;
+    }
+
+    out[encoded] = 0x00;
+    return encoded + 1;
+}
+
+void ExportEncoder::export_changed(const flush_t &flush)
+{
+    size_t batch_size = 0;
+    size_t batch_frames = 0;
+
+    const auto count = m_store.size();
+    for (size_t i = 0; i < count; i++)
+    {
+        const auto snapshot = m_store.read(i);
+        if (snapshot.updates == m_exported_updates[i])
+        {
+            continue;
+        }
+        m_exported_updates[i] = snapshot.updates;
+
+        batch_size += encode_export_frame(m_sequence++, m_store.key(i), snapshot, std::span{m_batch}.subspan(batch_size));
+        batch_frames++;
+
+        if (batch_frames == FRAMES_PER_BATCH)
+        {
+            flush(std::span{m_batch}.first(batch_size), batch_frames);
+            batch_size = 0;
+            batch_frames = 0;
+        }
+    }
+
+    if (batch_frames)
+    {
+        flush(std::span{m_batch}.first(batch_size), batch_frames);
+    }
+}
+
+} // namespace antbms
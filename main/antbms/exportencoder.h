@@ -0,0 +1,62 @@
+#pragma once
+
+// system includes
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <span>
+
+// local includes
+#include "gatewaystore.h"
+#include "helpers/cobs.h"
+
+namespace antbms {
+
+// Export frame, COBS encoded and terminated by 0x00
+//
+// Byte Len Description
+//   0   1  Version (1)
+//   1   1  Type (1: pack snapshot)
+//   2   2  Sequence number, little endian, one per frame, gaps mean lost frames
+//   4   6  Sender MAC
+//  10   1  Pack ID
+//  11 136  PackSnapshot as declared, little endian
+// 147   2  CRC16 (Modbus) over bytes 0 - 146, little endian
+//
+// tools/exportreader.py decodes it on the host.
+constexpr static const uint8_t EXPORT_VERSION = 1;
+constexpr static const uint8_t EXPORT_TYPE_SNAPSHOT = 1;
+constexpr static const size_t EXPORT_FRAME_SIZE = 11 + sizeof(PackSnapshot) + 2;
+constexpr static const size_t EXPORT_ENCODED_SIZE = helpers::cobs_encoded_size(EXPORT_FRAME_SIZE) + 1;
+
+/// Encodes one frame including the delimiter, returns the bytes written or 0 if \p out is too small
+size_t encode_export_frame(uint16_t sequence, const GatewayStore::SourceKey &key, const PackSnapshot &snapshot,
+                           std::span<uint8_t> out);
+
+/// Encodes every snapshot of a store that changed since the last call, reading it
+/// like any other consumer. Plain C++, UartExport writes the batches to a UART.
+class ExportEncoder
+{
+public:
+    constexpr static const size_t FRAMES_PER_BATCH = 16;
+
+    // a batch of encoded frames and how many there are
+    using flush_t = std::function<void(std::span<const uint8_t> batch, size_t frames)>;
+
+    explicit ExportEncoder(const GatewayStore &store) :
+            m_store{store}
+    {}
+
+    /// hands the changed snapshots to \p flush, at most FRAMES_PER_BATCH at a time
+    void export_changed(const flush_t &flush);
+
+private:
+    const GatewayStore &m_store;
+
+    uint16_t m_sequence = 0;
+    std::array<uint32_t, GatewayStore::MAX_SOURCES> m_exported_updates{};
+
+    std::array<uint8_t, FRAMES_PER_BATCH * EXPORT_ENCODED_SIZE> m_batch;
+};
+
+} // namespace antbms
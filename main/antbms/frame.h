@@ -0,0 +1,104 @@
+#pragma once
+
+// system includes
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
+
+// local includes
+#include "helpers/crc16.h"
+
+namespace antbms {
+constexpr static const uint8_t ANT_PKT_START_1 = 0x7E;
+constexpr static const uint8_t ANT_PKT_START_2 = 0xA1;
+constexpr static const uint8_t ANT_PKT_END_1 = 0xAA;
+constexpr static const uint8_t ANT_PKT_END_2 = 0x55;
+
+// Command frame layout
+//
+// Byte Len Payload     Description
+//   0   2  0x7E 0xA1   Start of frame
+//   2   1  0x01        Function
+//   3   2  0x00 0x00   Address (little endian)
+//   5   1  0xBE        Value or payload length
+//   6   n  ...         Payload
+// 6+n   2  0x18 0x55   CRC over bytes 1 .. 5+n
+// 8+n   2  0xAA 0x55   End of frame
+constexpr static const size_t ANT_FRAME_HEADER_SIZE = 6;
+constexpr static const size_t ANT_FRAME_OVERHEAD = ANT_FRAME_HEADER_SIZE + 4;
+
+template<size_t PayloadSize>
+using Frame = std::array<uint8_t, ANT_FRAME_OVERHEAD + PayloadSize>;
+
+namespace detail {
+constexpr void fill_frame(uint8_t *frame, uint8_t function, uint16_t address, uint8_t value,
+                          const uint8_t *payload, size_t payload_size)
+{
+    frame[0] = ANT_PKT_START_1;
+    frame[1] = ANT_PKT_START_2;
+    frame[2] = function;
+    frame[3] = address >> 0;
+    frame[4] = address >> 8;
+    frame[5] = value;
+
+    for (size_t i = 0; i < payload_size; i++)
+    {
+        frame[ANT_FRAME_HEADER_SIZE + i] = payload[i];
+    }
+
+    const size_t crc_pos = ANT_FRAME_HEADER_SIZE + payload_size;
+    const auto crc = helpers::crc16(frame + 1, crc_pos - 1);
+    frame[crc_pos + 0] = crc >> 0;
+    frame[crc_pos + 1] = crc >> 8;
+    frame[crc_pos + 2] = ANT_PKT_END_1;
+    frame[crc_pos + 3] = ANT_PKT_END_2;
+}
+} // namespace detail
+
+/// Builds a command frame, usable in constant expressions for fixed commands.
+template<size_t PayloadSize = 0>
+constexpr Frame<PayloadSize> make_frame(uint8_t function, uint16_t address, uint8_t value,
+                                        const std::array<uint8_t, PayloadSize> &payload = {})
+{
+    Frame<PayloadSize> frame{};
+    detail::fill_frame(frame.data(), function, address, value, payload.data(), PayloadSize);
+    return frame;
+}
+
+/// Stack buffer for frames whose payload is only known at runtime. Exposes the
+/// same contiguous range interface as Frame, so both go through the same write path.
+template<size_t MaxPayloadSize>
+class VariableFrame
+{
+public:
+    constexpr static const size_t max_payload_size = MaxPayloadSize;
+
+    /// payload is truncated to MaxPayloadSize, check fits() beforehand
+    constexpr VariableFrame(uint8_t function, uint16_t address, std::span<const uint8_t> payload)
+        : m_size{ANT_FRAME_OVERHEAD + std::min(payload.size(), MaxPayloadSize)}
+    {
+        const auto payload_size = m_size - ANT_FRAME_OVERHEAD;
+        detail::fill_frame(m_buffer.data(), function, address, payload_size, payload.data(), payload_size);
+    }
+
+    constexpr static bool fits(std::span<const uint8_t> payload)
+    { return payload.size() <= MaxPayloadSize; }
+
+    [[nodiscard]] constexpr const uint8_t *data() const
+    { return m_buffer.data(); }
+
+    [[nodiscard]] constexpr size_t size() const
+    { return m_size; }
+
+    [[nodiscard]] constexpr const uint8_t *begin() const
+    { return data(); }
+
+    [[nodiscard]] constexpr const uint8_t *end() const
+    { return data() + size(); }
+
+private:
+    std::array<uint8_t, ANT_FRAME_OVERHEAD + MaxPayloadSize> m_buffer{};
+    size_t m_size;
+};
+} // namespace antbms
@@ -0,0 +1,151 @@
+#include "frameassembler.h"
+
+// esp-idf includes
+#include <esp_log.h>
+
+// local includes
+#include "frame.h"
+
+namespace antbms {
+
+namespace {
+
+constexpr const char * const TAG = "FrameAssembler";
+
+// It looks like the data_len value of the device info frame is wrong
+constexpr const uint8_t ANT_FRAME_TYPE_DEVICE_INFO = 0x12;
+
+} // namespace
+
+std::optional<std::span<const uint8_t>> FrameAssembler::feed(std::span<const uint8_t> notification, int64_t now_us)
+{
+    if (m_complete || m_buffer.size() > MAX_FRAME_SIZE)
+    {
+        if (!m_complete)
+        {
+            ESP_LOGW(TAG, "Maximum response size (%d bytes) exceeded", m_buffer.size());
+            overflows++;
+        }
+        reset();
+    }
+
+    if (notification.empty())
+    {
+        return std::nullopt;
+    }
+
+    if (notification.size() >= 2 && notification[0] == ANT_PKT_START_1 && notification[1] == ANT_PKT_START_2)
+    {
+        if (m_buffer.size() >= ANT_FRAME_HEADER_SIZE && m_buffer.size() < ANT_FRAME_OVERHEAD + m_buffer[5])
+        {
+            // the header expects more, this may be payload
+            m_restart = m_buffer.size();
+            m_restart_notifications = m_notifications;
+            m_restart_us = now_us;
+        }
+        else
+        {
+            reset();
+            m_frame_start_us = now_us;
+        }
+    }
+
+    m_buffer.insert(m_buffer.end(), notification.begin(), notification.end());
+    m_notifications++;
+
+    while (true)
+    {
+        switch (check_())
+        {
+        case Check::Incomplete:
+            return std::nullopt;
+        case Check::Complete:
+            m_frame_notifications = m_notifications;
+            m_complete = true;
+            return std::span<const uint8_t>{m_buffer};
+        case Check::LengthError:
+            if (restart_())
+            {
+                continue;
+            }
+            ESP_LOGW(TAG, "Invalid frame length");
+            length_errors++;
+            reset();
+            return std::nullopt;
+        case Check::CrcError:
+            if (restart_())
+            {
+                continue;
+            }
+            ESP_LOGW(TAG, "CRC Check failed!");
+            crc_errors++;
+            reset();
+            return std::nullopt;
+        }
+    }
+}
+
+void FrameAssembler::reset()
+{
+    m_buffer.clear();
+    m_notifications = 0;
+    m_complete = false;
+    m_restart = 0;
+}
+
+FrameAssembler::Check FrameAssembler::check_() const
+{
+    if (m_buffer.size() < ANT_FRAME_OVERHEAD)
+    {
+        return Check::Incomplete;
+    }
+
+    const uint8_t *raw = m_buffer.data();
+
+    const uint8_t function = raw[2];
+    const uint16_t data_len = raw[5];
+    const uint16_t frame_len = ANT_FRAME_OVERHEAD + data_len;
+
+    // with a restart point pending there is no need to wait for an end marker
+    if (m_buffer.size() > frame_len && m_restart && function != ANT_FRAME_TYPE_DEVICE_INFO)
+    {
+        return Check::LengthError;
+    }
+
+    // an end marker inside the payload can end a chunk as well, wait until the header says we are complete
+    if (m_buffer.back() != ANT_PKT_END_2 || m_buffer.size() < frame_len)
+    {
+        return Check::Incomplete;
+    }
+
+    if (frame_len != m_buffer.size() && function != ANT_FRAME_TYPE_DEVICE_INFO)
+    {
+        return Check::LengthError;
+    }
+
+    const uint16_t computed_crc = helpers::crc16(raw + 1, frame_len - 5);
+    const uint16_t remote_crc = uint16_t(raw[frame_len - 3]) << 8 | (uint16_t(raw[frame_len - 4]) << 0);
+    if (computed_crc != remote_crc)
+    {
+        ESP_LOGD(TAG, "CRC %04X != %04X", computed_crc, remote_crc);
+        return Check::CrcError;
+    }
+
+    return Check::Complete;
+}
+
+bool FrameAssembler::restart_()
+{
+    if (!m_restart)
+    {
+        return false;
+    }
+
+    m_buffer.erase(m_buffer.begin(), m_buffer.begin() + m_restart);
+    m_notifications -= m_restart_notifications;
+    m_frame_start_us = m_restart_us;
+    m_restart = 0;
+    return true;
+}
+
+} // namespace antbms
@@ -0,0 +1,62 @@
+#pragma once
+
+// system includes
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace antbms {
+
+/// Joins BLE notifications into ANT frames. A preamble starts a new frame, a
+/// frame is complete once the length in its header is reached and it ends with
+/// the end marker; it is handed out only if its CRC matches.
+///
+/// Payload bytes can look like a preamble at the start of a notification. While
+/// the header still expects more bytes such a notification is appended and its
+/// position kept, the assembler only restarts there if the longer frame turns
+/// out too long or fails its CRC.
+///
+/// Plain C++, AntBms feeds it from the NimBLE host task.
+class FrameAssembler
+{
+public:
+    // largest response the BMS sends
+    constexpr static const uint8_t MAX_FRAME_SIZE = 152;
+
+    /// complete, CRC checked frame, valid until the next feed()
+    std::optional<std::span<const uint8_t>> feed(std::span<const uint8_t> notification, int64_t now_us);
+
+    void reset();
+
+    /// time the preamble of the current or last completed frame arrived
+    [[nodiscard]] int64_t frame_start_us() const
+    { return m_frame_start_us; }
+
+    /// notifications the last completed frame took
+    [[nodiscard]] uint8_t frame_notifications() const
+    { return m_frame_notifications; }
+
+    uint32_t overflows{};
+    uint32_t length_errors{};
+    uint32_t crc_errors{};
+
+private:
+    enum class Check { Incomplete, Complete, LengthError, CrcError };
+
+    [[nodiscard]] Check check_() const;
+    bool restart_();
+
+    std::vector<uint8_t> m_buffer;
+    bool m_complete = false;
+    uint8_t m_notifications = 0;
+    uint8_t m_frame_notifications = 0;
+    int64_t m_frame_start_us = 0;
+
+    // preamble seen inside a partial frame, 0 if none
+    size_t m_restart = 0;
+    uint8_t m_restart_notifications = 0;
+    int64_t m_restart_us = 0;
+};
+
+} // namespace antbms
@@ -0,0 +1,274 @@
+#include "gatewaystore.h"
+
+// system includes
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// esp-idf includes
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// local includes
+#include "samplebatcher.h"
+
+namespace antbms {
+
+namespace {
+
+constexpr const char * const TAG = "GatewayStore";
+
+// a copy takes about a microsecond, a writer in the way for longer got preempted
+constexpr const uint32_t SPINS_BEFORE_DELAY = 8;
+
+} // namespace
+
+PackSnapshot PackSnapshot::from(const AntBmsData &data, int64_t updated_us, uint32_t updates)
+{
+    PackSnapshot snapshot{
+        .timestamp_us = data.timestamp_us,
+        .updated_us = updated_us,
+        .updates = updates,
+        .total_voltage = data.total_voltage,
+        .current = data.current,
+        .power = data.power,
+        .state_of_charge = data.state_of_charge,
+        .max_cell_voltage = data.max_cell_voltage,
+        .min_cell_voltage = data.min_cell_voltage,
+        .delta_cell_voltage = data.delta_cell_voltage,
+        .mosfet_temperature = data.mosfet_temperature,
+        .temperatures = {},
+        .cells_mv = {},
+        .cell_count = 0,
+        .temperature_count = 0,
+    };
+
+    snapshot.cell_count = std::min(data.cell_voltages.size(), snapshot.cells_mv.size());
+    snapshot.temperature_count = std::min(data.temperatures.size(), snapshot.temperatures.size());
+
+    for (size_t i = 0; i < snapshot.cell_count; i++)
+    {
+        snapshot.cells_mv[i] = static_cast<uint16_t>(std::lround(data.cell_voltages[i] * 1000.f));
+    }
+    std::copy_n(data.temperatures.begin(), snapshot.temperature_count, snapshot.temperatures.begin());
+
+    return snapshot;
+}
+
+GatewayStore::GatewayStore() :
+        m_slots{std::make_unique<std::array<Slot, MAX_SOURCES>>()},
+        m_sources{std::make_unique<std::array<Source, MAX_SOURCES>>()},
+        m_doc{std::make_unique<ArduinoJson::StaticJsonDocument<1024>>()}
+{}
+
+bool GatewayStore::ingest(const uint8_t *mac, std::string_view type, std::string_view content, int64_t now_us)
+{
+    if (type != "BMS" && type != "BAT")
+    {
+        return false;
+    }
+
+    auto &doc = *m_doc;
+    if (const auto error = deserializeJson(doc, content.data(), content.size()); error)
+    {
+        ESP_LOGW(TAG, "Invalid %.*s frame: %s", type.size(), type.data(), error.c_str());
+        rejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    SourceKey key{.mac = {}, .pack_id = doc.containsKey("pid") ? doc["pid"].as<uint8_t>() : uint8_t{0}};
+    std::copy_n(mac, key.mac.size(), key.mac.begin());
+
+    if (type == "BMS")
+    {
+        return update(key, now_us, [&doc](AntBmsData &data) {
+            // frames from unsynced nodes carry no time
+            data.timestamp_us = 0;
+            data.parseDoc(doc);
+        });
+    }
+
+    // the newest sample of the batch is what the snapshot shows
+    const auto samples = doc["s"].as<JsonArrayConst>();
+    if (!samples.size() || samples.size() % SAMPLE_STRIDE)
+    {
+        rejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // "tl" is the node's local clock, useless here
+    const bool synced = doc.containsKey("t");
+    int64_t timestamp_us = synced ? doc["t"].as<int64_t>() : 0;
+
+    std::array<int64_t, SAMPLE_STRIDE> newest{};
+    size_t i = 0;
+    for (const auto &value : samples)
+    {
+        newest[i % SAMPLE_STRIDE] = value.as<int64_t>();
+        if (i % SAMPLE_STRIDE == 0)
+        {
+            timestamp_us += newest[0];
+        }
+        i++;
+    }
+
+    return update(key, now_us, [&](AntBmsData &data) {
+        data.timestamp_us = synced ? timestamp_us : 0;
+        data.total_voltage = newest[1] * 0.01f;
+        data.current = newest[2] * 0.1f;
+        data.state_of_charge = newest[3];
+        data.max_cell_voltage = newest[4] * 0.001f;
+        data.min_cell_voltage = newest[5] * 0.001f;
+        data.delta_cell_voltage = data.max_cell_voltage - data.min_cell_voltage;
+    });
+}
+
+GatewayStore::SourceKey GatewayStore::key(size_t index) const
+{
+    const auto packed = m_keys[index].load(std::memory_order_relaxed);
+
+    SourceKey key{.mac = {}, .pack_id = static_cast<uint8_t>(packed >> 48)};
+    for (size_t i = 0; i < key.mac.size(); i++)
+    {
+        key.mac[i] = static_cast<uint8_t>(packed >> (8 * (key.mac.size() - 1 - i)));
+    }
+    return key;
+}
+
+PackSnapshot GatewayStore::read(size_t index, uint32_t *retries) const
+{
+    const auto &slot = (*m_slots)[index];
+
+    std::array<uint32_t, WORDS> words;
+    for (uint32_t attempt = 0;; attempt++)
+    {
+        if (const auto before = slot.sequence.load(std::memory_order_acquire); !(before & 1))
+        {
+            for (size_t i = 0; i < WORDS; i++)
+            {
+                words[i] = slot.words[i].load(std::memory_order_relaxed);
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if (slot.sequence.load(std::memory_order_relaxed) == before)
+            {
+                if (retries)
+                {
+                    *retries += attempt;
+                }
+                break;
+            }
+        }
+
+        // a reader above the writer's priority would spin forever
+        if (attempt >= SPINS_BEFORE_DELAY)
+        {
+            vTaskDelay(1);
+        }
+    }
+
+    PackSnapshot snapshot;
+    std::memcpy(&snapshot, words.data(), sizeof(snapshot));
+    return snapshot;
+}
+
+std::optional<PackSnapshot> GatewayStore::find(const SourceKey &key, uint32_t *retries) const
+{
+    const auto packed = pack_key(key);
+    const auto count = size();
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (m_keys[i].load(std::memory_order_relaxed) == packed)
+        {
+            return read(i, retries);
+        }
+    }
+
+    return std::nullopt;
+}
+
+uint64_t GatewayStore::pack_key(const SourceKey &key)
+{
+    uint64_t mac = 0;
+    for (const auto byte : key.mac)
+    {
+        mac = (mac << 8) | byte;
+    }
+    return uint64_t{key.pack_id} << 48 | mac;
+}
+
+std::pair<GatewayStore::Source *, bool> GatewayStore::source(const SourceKey &key)
+{
+    const auto packed = pack_key(key);
+    const auto count = m_count.load(std::memory_order_relaxed);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (m_keys[i].load(std::memory_order_relaxed) == packed)
+        {
+            return {&(*m_sources)[i], false};
+        }
+    }
+
+    if (count == MAX_SOURCES)
+    {
+        return {nullptr, false};
+    }
+
+    // readers only see the slot once its first snapshot is published
+    m_keys[count].store(packed, std::memory_order_relaxed);
+    (*m_sources)[count] = Source{};
+    return {&(*m_sources)[count], true};
+}
+
+void GatewayStore::publish(size_t index, bool added, int64_t now_us)
+{
+    auto &source = (*m_sources)[index];
+    const auto snapshot = PackSnapshot::from(source.data, now_us, ++source.updates);
+
+    std::array<uint32_t, WORDS> words;
+    std::memcpy(words.data(), &snapshot, sizeof(snapshot));
+
+    auto &slot = (*m_slots)[index];
+    const auto sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    for (size_t i = 0; i < WORDS; i++)
+    {
+        slot.words[i].store(words[i], std::memory_order_relaxed);
+    }
+
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+
+    if (added)
+    {
+        m_count.store(index + 1, std::memory_order_release);
+    }
+
+    updates.fetch_add(1, std::memory_order_relaxed);
+}
+
+void GatewayStore::log(const char *tag) const
+{
+    ESP_LOGI(tag, "Gateway: sources=%d updates=%ld rejected=%ld full=%ld", size(),
+             updates.load(std::memory_order_relaxed), rejected.load(std::memory_order_relaxed),
+             full.load(std::memory_order_relaxed));
+
+    const auto count = size();
+    for (size_t i = 0; i < count; i++)
+    {
+        const auto key = this->key(i);
+        const auto snapshot = read(i);
+        ESP_LOGI(tag, "Pack %02x:%02x:%02x:%02x:%02x:%02x/%d updates=%ld ts=%lldus tvo=%.2fV cur=%.1fA soc=%.0f%% "
+                      "cells=%d dcv=%.3fV",
+                 key.mac[0], key.mac[1], key.mac[2], key.mac[3], key.mac[4], key.mac[5], key.pack_id,
+                 snapshot.updates, snapshot.timestamp_us, snapshot.total_voltage, snapshot.current,
+                 snapshot.state_of_charge, snapshot.cell_count, snapshot.delta_cell_voltage);
+    }
+}
+
+} // namespace antbms
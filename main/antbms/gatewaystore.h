@@ -0,0 +1,143 @@
+#pragma once
+
+// system includes
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <utility>
+
+// 3rdparty includes
+#include <ArduinoJson.h>
+
+// local includes
+#include "datastructure.h"
+#include "peerregistry.h"
+
+namespace antbms {
+
+/// Latest state of one pack as seen by the gateway. Plain data without
+/// padding, so readers can copy it word by word.
+struct PackSnapshot
+{
+    // synchronized time of the reading as stamped by the node, 0 if it was not synced
+    int64_t timestamp_us;
+    // gateway esp_timer time of the last update
+    int64_t updated_us;
+    uint32_t updates;
+    float total_voltage;
+    float current;
+    float power;
+    float state_of_charge;
+    float max_cell_voltage;
+    float min_cell_voltage;
+    float delta_cell_voltage;
+    float mosfet_temperature;
+    std::array<float, 4> temperatures;
+    std::array<uint16_t, 32> cells_mv;
+    uint16_t cell_count;
+    uint16_t temperature_count;
+
+    static PackSnapshot from(const AntBmsData &data, int64_t updated_us, uint32_t updates);
+};
+
+/// Per source state on a receiver that several nodes broadcast into, keyed by
+/// sender MAC and pack ID ("pid" in the frame, 0 if absent).
+///
+/// Exactly one writer, the ESP-NOW ingest on the main loop, merges every
+/// "BMS:" and "BAT:" frame into a private copy of the source's data and
+/// publishes a PackSnapshot through a per source seqlock. Readers on any task
+/// never block the writer and never take a lock; they retry while an update
+/// is in flight. Sources are never removed, a full store drops new ones.
+class GatewayStore
+{
+public:
+    constexpr static const size_t MAX_SOURCES = 64;
+
+    struct SourceKey
+    {
+        MacAddress mac;
+        uint8_t pack_id;
+    };
+
+    GatewayStore();
+
+    /// writer: decodes one received message, false if it was not telemetry or did not parse
+    bool ingest(const uint8_t *mac, std::string_view type, std::string_view content, int64_t now_us);
+
+    /// writer: applies \p update to the source's data and publishes the result
+    template<typename Update>
+    bool update(const SourceKey &key, int64_t now_us, Update &&update);
+
+    /// number of sources, slots [0, size()) can be read
+    [[nodiscard]] size_t size() const
+    { return m_count.load(std::memory_order_acquire); }
+
+    [[nodiscard]] SourceKey key(size_t index) const;
+
+    /// reader: consistent copy of one slot, \p retries counts the attempts an update got in the way of
+    [[nodiscard]] PackSnapshot read(size_t index, uint32_t *retries = nullptr) const;
+
+    /// reader: looks the source up first
+    [[nodiscard]] std::optional<PackSnapshot> find(const SourceKey &key, uint32_t *retries = nullptr) const;
+
+    /// reads every source and logs one line each
+    void log(const char *tag) const;
+
+    // written by the writer only
+    std::atomic<uint32_t> updates{};
+    std::atomic<uint32_t> rejected{};
+    std::atomic<uint32_t> full{};
+
+private:
+    constexpr static const size_t WORDS = sizeof(PackSnapshot) / sizeof(uint32_t);
+    static_assert(sizeof(PackSnapshot) % sizeof(uint32_t) == 0);
+
+    struct Slot
+    {
+        // odd while the writer is copying
+        std::atomic<uint32_t> sequence{};
+        std::array<std::atomic<uint32_t>, WORDS> words{};
+    };
+
+    struct Source
+    {
+        AntBmsData data;
+        uint32_t updates;
+    };
+
+    static uint64_t pack_key(const SourceKey &key);
+
+    // writer side, nullptr when full; true if the source is new
+    std::pair<Source *, bool> source(const SourceKey &key);
+
+    void publish(size_t index, bool added, int64_t now_us);
+
+    std::unique_ptr<std::array<Slot, MAX_SOURCES>> m_slots;
+    std::array<std::atomic<uint64_t>, MAX_SOURCES> m_keys{};
+    std::atomic<size_t> m_count{};
+
+    // writer only
+    std::unique_ptr<std::array<Source, MAX_SOURCES>> m_sources;
+    // ingest() runs on the main task, its stack has no room for the document
+    std::unique_ptr<ArduinoJson::StaticJsonDocument<1024>> m_doc;
+};
+
+template<typename Update>
+bool GatewayStore::update(const SourceKey &key, int64_t now_us, Update &&update)
+{
+    const auto [source, added] = this->source(key);
+    if (!source)
+    {
+        full.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    update(source->data);
+    publish(source - m_sources->data(), added, now_us);
+    return true;
+}
+
+} // namespace antbms
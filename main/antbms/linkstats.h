@@ -0,0 +1,43 @@
+#pragma once
+
+// system includes
+#include <cstdint>
+
+namespace antbms {
+
+struct LinkStats
+{
+    // how many notifications were needed to assemble one frame
+    uint32_t frames{};
+    uint32_t notifications{};
+    uint32_t single_pdu_frames{};
+    uint8_t max_notifications_per_frame{};
+
+    void frame_completed(uint8_t frame_notifications)
+    {
+        frames++;
+        notifications += frame_notifications;
+
+        if (frame_notifications == 1)
+        {
+            single_pdu_frames++;
+        }
+
+        if (frame_notifications > max_notifications_per_frame)
+        {
+            max_notifications_per_frame = frame_notifications;
+        }
+    }
+
+    [[nodiscard]] float avg_notifications_per_frame() const
+    {
+        return frames ? float(notifications) / frames : 0.f;
+    }
+
+    void reset()
+    {
+        *this = LinkStats{};
+    }
+};
+
+} // namespace antbms
@@ -0,0 +1,176 @@
+#include "peerregistry.h"
+
+// system includes
+#include <algorithm>
+#include <cstring>
+
+// local includes
+#include "espnow.h"
+
+namespace antbms {
+
+PeerRegistry::SubscribeResult PeerRegistry::subscribe(const MacAddress &mac, uint32_t groups,
+                                                      espchrono::millis_clock::duration period,
+                                                      espchrono::millis_clock::time_point now)
+{
+    std::lock_guard lock{m_mutex};
+
+    period = std::max(period, MIN_PERIOD);
+
+    if (auto *subscriber = find(mac.data()))
+    {
+        subscriber->groups = groups;
+        subscriber->period = period;
+        subscriber->last_seen = now;
+        return {.added = false, .evicted = std::nullopt};
+    }
+
+    SubscribeResult result{.added = true, .evicted = std::nullopt};
+
+    if (m_count == m_subscribers.size())
+    {
+        const auto oldest = std::min_element(m_subscribers.begin(), m_subscribers.end(),
+                                             [](const auto &a, const auto &b) { return a.last_seen < b.last_seen; });
+        result.evicted = oldest->mac;
+        remove(std::distance(m_subscribers.begin(), oldest));
+    }
+
+    m_subscribers[m_count++] = Subscriber{
+        .mac = mac,
+        .groups = groups,
+        .period = period,
+        .last_seen = now,
+        .last_sent = {},
+    };
+
+    return result;
+}
+
+bool PeerRegistry::unsubscribe(const MacAddress &mac)
+{
+    std::lock_guard lock{m_mutex};
+
+    if (auto *subscriber = find(mac.data()))
+    {
+        remove(subscriber - m_subscribers.data());
+        return true;
+    }
+
+    return false;
+}
+
+std::optional<MacAddress> PeerRegistry::expire(espchrono::millis_clock::time_point now)
+{
+    std::lock_guard lock{m_mutex};
+
+    for (size_t i = 0; i < m_count; i++)
+    {
+        if (now - m_subscribers[i].last_seen > m_idle_timeout)
+        {
+            const auto mac = m_subscribers[i].mac;
+            remove(i);
+            return mac;
+        }
+    }
+
+    return std::nullopt;
+}
+
+size_t PeerRegistry::due(espchrono::millis_clock::time_point now, std::span<Subscriber, MAX_SUBSCRIBERS> out) const
+{
+    std::lock_guard lock{m_mutex};
+
+    size_t count = 0;
+    for (size_t i = 0; i < m_count; i++)
+    {
+        if (now - m_subscribers[i].last_sent >= m_subscribers[i].period)
+        {
+            out[count++] = m_subscribers[i];
+        }
+    }
+
+    return count;
+}
+
+std::optional<espchrono::millis_clock::time_point> PeerRegistry::next_due() const
+{
+    std::lock_guard lock{m_mutex};
+
+    std::optional<espchrono::millis_clock::time_point> next;
+    for (size_t i = 0; i < m_count; i++)
+    {
+        const auto due = m_subscribers[i].last_sent + m_subscribers[i].period;
+        if (!next || due < *next)
+        {
+            next = due;
+        }
+    }
+
+    return next;
+}
+
+void PeerRegistry::sent(const MacAddress &mac, size_t length, espchrono::millis_clock::time_point now)
+{
+    std::lock_guard lock{m_mutex};
+
+    if (auto *subscriber = find(mac.data()))
+    {
+        subscriber->last_sent = now;
+        subscriber->frames++;
+        subscriber->airtime_us += espnow::airtime_us(length);
+    }
+}
+
+void PeerRegistry::delivered(const uint8_t *mac, bool success)
+{
+    std::lock_guard lock{m_mutex};
+
+    if (auto *subscriber = find(mac))
+    {
+        (success ? subscriber->delivered : subscriber->failed)++;
+    }
+}
+
+size_t PeerRegistry::snapshot(std::span<Subscriber, MAX_SUBSCRIBERS> out) const
+{
+    std::lock_guard lock{m_mutex};
+
+    std::copy_n(m_subscribers.begin(), m_count, out.begin());
+    return m_count;
+}
+
+void PeerRegistry::reset_stats()
+{
+    std::lock_guard lock{m_mutex};
+
+    for (size_t i = 0; i < m_count; i++)
+    {
+        auto &subscriber = m_subscribers[i];
+        subscriber.frames = 0;
+        subscriber.delivered = 0;
+        subscriber.failed = 0;
+        subscriber.airtime_us = 0;
+    }
+}
+
+Subscriber *PeerRegistry::find(const uint8_t *mac)
+{
+    for (size_t i = 0; i < m_count; i++)
+    {
+        if (std::memcmp(m_subscribers[i].mac.data(), mac, ESP_NOW_ETH_ALEN) == 0)
+        {
+            return &m_subscribers[i];
+        }
+    }
+
+    return nullptr;
+}
+
+void PeerRegistry::remove(size_t index)
+{
+    // order does not matter, fill the gap with the last one
+    m_subscribers[index] = m_subscribers[m_count - 1];
+    m_count--;
+}
+
+} // namespace antbms
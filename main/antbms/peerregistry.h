@@ -0,0 +1,100 @@
+#pragma once
+
+// system includes
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <span>
+
+// esp-idf includes
+#include <esp_now.h>
+
+// 3rdparty includes
+#include <espchrono.h>
+
+namespace antbms {
+
+using MacAddress = std::array<uint8_t, ESP_NOW_ETH_ALEN>;
+
+struct Subscriber
+{
+    MacAddress mac;
+    // bit i selects TelemetryScheduler group i
+    uint32_t groups;
+    espchrono::millis_clock::duration period;
+    // subscriptions have to be refreshed, see PeerRegistry::set_idle_timeout()
+    espchrono::millis_clock::time_point last_seen;
+    espchrono::millis_clock::time_point last_sent;
+
+    // per stats window
+    uint32_t frames{};
+    uint32_t delivered{};
+    uint32_t failed{};
+    int64_t airtime_us{};
+
+    [[nodiscard]] float delivery_ratio() const
+    { return delivered + failed ? float(delivered) / (delivered + failed) : 0.f; }
+};
+
+/// Receivers subscribing with "SUB:<group mask hex>,<period ms>" get their own
+/// unicast stream, which ESP-NOW acknowledges and retries on the MAC layer.
+/// The table stays well below the ESP-NOW peer limit; subscribers that stop
+/// refreshing are evicted, and when the table is full the least recently seen
+/// one makes room.
+///
+/// delivered() runs on the Wi-Fi task, everything else on the main loop.
+class PeerRegistry
+{
+public:
+    // ESP-NOW allows 20 peers in total, broadcast takes one
+    constexpr static const size_t MAX_SUBSCRIBERS = 8;
+    static_assert(MAX_SUBSCRIBERS < ESP_NOW_MAX_TOTAL_PEER_NUM);
+
+    constexpr static const espchrono::millis_clock::duration MIN_PERIOD = std::chrono::milliseconds{100};
+
+    struct SubscribeResult
+    {
+        bool added;
+        // peer that had to make room, remove it from ESP-NOW
+        std::optional<MacAddress> evicted;
+    };
+
+    void set_idle_timeout(espchrono::millis_clock::duration timeout)
+    { m_idle_timeout = timeout; }
+
+    SubscribeResult subscribe(const MacAddress &mac, uint32_t groups, espchrono::millis_clock::duration period,
+                              espchrono::millis_clock::time_point now);
+
+    bool unsubscribe(const MacAddress &mac);
+
+    /// removes one subscriber that has not refreshed within the idle timeout
+    std::optional<MacAddress> expire(espchrono::millis_clock::time_point now);
+
+    /// copies all subscribers whose period elapsed into \p out
+    size_t due(espchrono::millis_clock::time_point now, std::span<Subscriber, MAX_SUBSCRIBERS> out) const;
+
+    /// earliest time a subscriber becomes due, nullopt without subscribers
+    std::optional<espchrono::millis_clock::time_point> next_due() const;
+
+    void sent(const MacAddress &mac, size_t length, espchrono::millis_clock::time_point now);
+
+    void delivered(const uint8_t *mac, bool success);
+
+    /// copies all subscribers into \p out
+    size_t snapshot(std::span<Subscriber, MAX_SUBSCRIBERS> out) const;
+
+    void reset_stats();
+
+private:
+    Subscriber *find(const uint8_t *mac);
+
+    void remove(size_t index);
+
+    std::array<Subscriber, MAX_SUBSCRIBERS> m_subscribers{};
+    size_t m_count = 0;
+    espchrono::millis_clock::duration m_idle_timeout = std::chrono::seconds{60};
+    mutable std::mutex m_mutex;
+};
+
+} // namespace antbms
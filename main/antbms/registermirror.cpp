@@ -0,0 +1,184 @@
+#include "registermirror.h"
+
+// system includes
+#include <algorithm>
+
+namespace antbms {
+
+void RegisterMirror::reset()
+{
+    std::lock_guard lock{m_mutex};
+
+    m_valid.reset();
+    m_failed.reset();
+    m_stale.reset();
+    m_in_flight.reset();
+    m_attempts = 0;
+}
+
+std::optional<RegisterRange> RegisterMirror::next_read(int64_t now_us)
+{
+    std::lock_guard lock{m_mutex};
+
+    expire_(now_us);
+    if (m_in_flight)
+    {
+        return std::nullopt;
+    }
+
+    // the first run of missing registers, at most one chunk long
+    size_t start = 0;
+    while (start < SIZE && !pending(start))
+    {
+        start++;
+    }
+    if (start == SIZE)
+    {
+        return std::nullopt;
+    }
+
+    size_t end = start + 1;
+    while (end < std::min<size_t>(start + READ_CHUNK, SIZE) && pending(end))
+    {
+        end++;
+    }
+
+    for (size_t i = start; i < end; i++)
+    {
+        m_stale[i] = false;
+    }
+
+    m_in_flight = RegisterRange{.address = uint16_t(start), .length = uint8_t(end - start)};
+    m_sent_at = now_us;
+    reads++;
+
+    return m_in_flight;
+}
+
+bool RegisterMirror::in_flight(int64_t now_us)
+{
+    std::lock_guard lock{m_mutex};
+
+    expire_(now_us);
+    return m_in_flight.has_value();
+}
+
+std::optional<int64_t> RegisterMirror::next_due_us() const
+{
+    std::lock_guard lock{m_mutex};
+
+    if (m_in_flight)
+    {
+        return m_sent_at + READ_TIMEOUT_US;
+    }
+
+    for (size_t i = 0; i < SIZE; i++)
+    {
+        if (pending(i))
+        {
+            // right away
+            return m_sent_at;
+        }
+    }
+
+    return std::nullopt;
+}
+
+void RegisterMirror::fill(uint16_t address, std::span<const uint8_t> data, int64_t now_us)
+{
+    std::lock_guard lock{m_mutex};
+
+    for (size_t i = 0; i < data.size() && address + i < SIZE; i++)
+    {
+        if (m_stale[address + i])
+        {
+            continue;
+        }
+        m_registers[address + i] = data[i];
+        m_valid[address + i] = true;
+    }
+
+    if (m_in_flight && m_in_flight->address == address)
+    {
+        read_latency.add(now_us - m_sent_at);
+        m_in_flight.reset();
+        m_attempts = 0;
+    }
+}
+
+void RegisterMirror::invalidate(uint16_t address)
+{
+    std::lock_guard lock{m_mutex};
+
+    if (address < SIZE)
+    {
+        m_valid[address] = false;
+        m_stale[address] = true;
+        // a successful write shows the register exists after all
+        m_failed[address] = false;
+    }
+}
+
+bool RegisterMirror::read(uint16_t address, std::span<uint8_t> out)
+{
+    std::lock_guard lock{m_mutex};
+
+    for (size_t i = 0; i < out.size(); i++)
+    {
+        if (address + i >= SIZE || !m_valid[address + i])
+        {
+            misses++;
+            return false;
+        }
+        out[i] = m_registers[address + i];
+    }
+
+    hits++;
+    return true;
+}
+
+size_t RegisterMirror::valid_count() const
+{
+    std::lock_guard lock{m_mutex};
+    return m_valid.count();
+}
+
+bool RegisterMirror::complete() const
+{
+    std::lock_guard lock{m_mutex};
+    return (m_valid | m_failed).all();
+}
+
+void RegisterMirror::reset_stats()
+{
+    std::lock_guard lock{m_mutex};
+
+    reads = 0;
+    read_timeouts = 0;
+    read_latency.reset();
+    hits = 0;
+    misses = 0;
+}
+
+void RegisterMirror::expire_(int64_t now_us)
+{
+    if (!m_in_flight || now_us - m_sent_at <= READ_TIMEOUT_US)
+    {
+        return;
+    }
+
+    read_timeouts++;
+
+    if (++m_attempts >= MAX_READ_ATTEMPTS)
+    {
+        for (size_t i = 0; i < m_in_flight->length; i++)
+        {
+            m_failed[m_in_flight->address + i] = true;
+        }
+        m_attempts = 0;
+    }
+
+    m_in_flight.reset();
+}
+
+} // namespace antbms
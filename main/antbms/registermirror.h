@@ -0,0 +1,91 @@
+#pragma once
+
+// system includes
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <span>
+
+// local includes
+#include "helpers/durationstats.h"
+
+namespace antbms {
+
+struct RegisterRange
+{
+    uint16_t address;
+    uint8_t length;
+};
+
+/// Local copy of the BMS parameter registers, filled with range reads after
+/// connecting. Keeps one read in flight, a write invalidates the registers it
+/// touched so they get read again; a response to a read sent before the write
+/// does not make them valid again. Registers that never answer are given up
+/// after a few attempts until the next connection.
+///
+/// fill() runs on the NimBLE host task, everything else on the main loop.
+class RegisterMirror
+{
+public:
+    // the parameter space up to and including the device info block at 0x026c
+    constexpr static const uint16_t SIZE = 0x400;
+    // a response has to fit into the 152 byte frame buffer
+    constexpr static const uint8_t READ_CHUNK = 128;
+    constexpr static const int64_t READ_TIMEOUT_US = 1'000'000;
+    constexpr static const uint8_t MAX_READ_ATTEMPTS = 3;
+
+    /// everything invalid, to be read again
+    void reset();
+
+    /// range to request now, nullopt while a read is in flight or nothing is left to read
+    std::optional<RegisterRange> next_read(int64_t now_us);
+
+    /// a read is waiting for its response, accounts a timed out one first
+    [[nodiscard]] bool in_flight(int64_t now_us);
+
+    /// when next_read() has work again, nullopt once complete
+    [[nodiscard]] std::optional<int64_t> next_due_us() const;
+
+    /// response to a range read, parts outside the mirror are ignored
+    void fill(uint16_t address, std::span<const uint8_t> data, int64_t now_us);
+
+    void invalidate(uint16_t address);
+
+    /// copies \p out.size() registers from \p address, false if any of them is not mirrored
+    bool read(uint16_t address, std::span<uint8_t> out);
+
+    [[nodiscard]] size_t valid_count() const;
+
+    [[nodiscard]] bool complete() const;
+
+    void reset_stats();
+
+    // per stats window
+    uint32_t reads{};
+    uint32_t read_timeouts{};
+    helpers::DurationStats read_latency;
+    uint32_t hits{};
+    uint32_t misses{};
+
+private:
+    [[nodiscard]] bool pending(size_t address) const
+    { return !m_valid[address] && !m_failed[address]; }
+
+    // accounts a read that timed out, expects the lock held
+    void expire_(int64_t now_us);
+
+    mutable std::mutex m_mutex;
+    std::array<uint8_t, SIZE> m_registers{};
+    std::bitset<SIZE> m_valid;
+    std::bitset<SIZE> m_failed;
+    // invalidated since the last read covering them was sent, responses still carry the old value
+    std::bitset<SIZE> m_stale;
+
+    std::optional<RegisterRange> m_in_flight;
+    int64_t m_sent_at = 0;
+    uint8_t m_attempts = 0;
+};
+
+} // namespace antbms
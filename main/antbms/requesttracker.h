@@ -0,0 +1,100 @@
+#pragma once
+
+// system includes
+#include <atomic>
+#include <cstdint>
+
+// local includes
+#include "helpers/durationstats.h"
+
+namespace antbms {
+
+/// Keeps exactly one status request in flight. A new request is allowed as soon
+/// as the previous response arrived or timed out, but never earlier than
+/// min_interval after the last one.
+///
+/// response_received() may be called from the NimBLE host task, everything else
+/// is expected to run on the main loop.
+class RequestTracker
+{
+public:
+    void set_timeout_us(int64_t timeout_us)
+    { m_timeout_us = timeout_us; }
+
+    void set_min_interval_us(int64_t min_interval_us)
+    { m_min_interval_us = min_interval_us; }
+
+    /// Accounts finished or timed out requests, returns true if the next one may be sent
+    bool poll(int64_t now_us)
+    {
+        if (m_in_flight)
+        {
+            if (const auto response_at = m_response_at.exchange(0); response_at)
+            {
+                m_in_flight = false;
+                responses++;
+                rtt.add(response_at - m_sent_at);
+            }
+            else if (now_us - m_sent_at > m_timeout_us)
+            {
+                m_in_flight = false;
+                timeouts++;
+            }
+            else
+            {
+                return false;
+            }
+        }
+
+        return now_us - m_sent_at >= m_min_interval_us;
+    }
+
+    void request_sent(int64_t now_us)
+    {
+        m_response_at = 0;
+        m_sent_at = now_us;
+        m_in_flight = true;
+        requests++;
+    }
+
+    void response_received(int64_t now_us)
+    {
+        m_response_at = now_us;
+    }
+
+    void reset()
+    {
+        m_in_flight = false;
+        m_response_at = 0;
+    }
+
+    void reset_stats()
+    {
+        requests = 0;
+        responses = 0;
+        timeouts = 0;
+        rtt.reset();
+    }
+
+    [[nodiscard]] bool in_flight() const
+    { return m_in_flight; }
+
+    /// when poll() changes its answer next without a response coming in
+    [[nodiscard]] int64_t next_poll_us() const
+    { return m_sent_at + (m_in_flight ? m_timeout_us : m_min_interval_us); }
+
+    uint32_t requests{};
+    uint32_t responses{};
+    uint32_t timeouts{};
+    helpers::DurationStats rtt;
+
+private:
+    int64_t m_timeout_us = 1'000'000;
+    int64_t m_min_interval_us = 0;
+
+    bool m_in_flight = false;
+    int64_t m_sent_at = 0;
+    std::atomic<int64_t> m_response_at = 0;
+};
+
+} // namespace antbms
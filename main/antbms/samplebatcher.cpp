@@ -0,0 +1,220 @@
+#include "samplebatcher.h"
+
+// system includes
+#include <algorithm>
+#include <cmath>
+
+// local includes
+#include "helpers/jsonwriter.h"
+
+namespace antbms {
+
+namespace {
+
+void encode_sample(helpers::JsonWriter &writer, const CompactSample &sample, int64_t delta_us)
+{
+    writer.add(delta_us);
+    writer.add(sample.total_voltage_cv);
+    writer.add(sample.current_da);
+    writer.add(unsigned{sample.state_of_charge});
+    writer.add(sample.max_cell_mv);
+    writer.add(sample.min_cell_mv);
+}
+
+uint8_t sample_length(const CompactSample &sample, int64_t delta_us)
+{
+    std::array<char, 64> scratch;
+    helpers::JsonWriter writer{scratch};
+    encode_sample(writer, sample, delta_us);
+    return writer.size();
+}
+
+int64_t to_ms(espchrono::millis_clock::duration duration)
+{
+    return std::chrono::milliseconds{duration}.count();
+}
+
+size_t digits(int64_t value)
+{
+    size_t count = value < 0 ? 2 : 1;
+    while (value /= 10)
+    {
+        count++;
+    }
+    return count;
+}
+
+} // namespace
+
+CompactSample CompactSample::from(const AntBmsData &data, espchrono::millis_clock::time_point received,
+                                  int64_t local_us)
+{
+    return CompactSample{
+        .received = received,
+        .timestamp_us = data.timestamp_us ? data.timestamp_us : local_us,
+        .synced = data.timestamp_us != 0,
+        .total_voltage_cv = static_cast<uint16_t>(std::lround(data.total_voltage * 100.f)),
+        .current_da = static_cast<int16_t>(std::lround(data.current * 10.f)),
+        .state_of_charge = static_cast<uint8_t>(std::lround(data.state_of_charge)),
+        .max_cell_mv = static_cast<uint16_t>(std::lround(data.max_cell_voltage * 1000.f)),
+        .min_cell_mv = static_cast<uint16_t>(std::lround(data.min_cell_voltage * 1000.f)),
+    };
+}
+
+void SampleBatcher::set_latency_budget(espchrono::millis_clock::duration budget)
+{
+    std::lock_guard lock{m_mutex};
+
+    m_latency_budget = budget;
+
+    if (!enabled())
+    {
+        m_head = 0;
+        m_count = 0;
+        m_body_size = 0;
+    }
+}
+
+void SampleBatcher::add(const CompactSample &sample)
+{
+    std::lock_guard lock{m_mutex};
+
+    if (!enabled())
+    {
+        return;
+    }
+
+    if (m_count == m_pending.size())
+    {
+        // the main loop fell behind, keep the most recent samples
+        m_body_size -= at(0).length;
+        m_head = (m_head + 1) % m_pending.size();
+        m_count--;
+        dropped++;
+    }
+
+    const auto length = sample_length(sample, sample.timestamp_us - m_last_timestamp_us);
+    m_pending[(m_head + m_count) % m_pending.size()] = Pending{.sample = sample, .length = length};
+    m_count++;
+    m_body_size += length;
+    m_last_timestamp_us = sample.timestamp_us;
+    samples++;
+}
+
+bool SampleBatcher::due(espchrono::millis_clock::time_point now, size_t frame_size) const
+{
+    std::lock_guard lock{m_mutex};
+
+    if (!m_count)
+    {
+        return false;
+    }
+
+    const auto &first = at(0).sample;
+    const auto &last = at(m_count - 1).sample;
+
+    // a batch shares one time base, getting synced starts a new one
+    if (m_count == m_pending.size() || now - first.received >= m_latency_budget || first.synced != last.synced)
+    {
+        return true;
+    }
+
+    // full once another sample the size of the last one would not fit anymore
+    return estimated_size() + 1 + at(m_count - 1).length > frame_size;
+}
+
+std::optional<espchrono::millis_clock::time_point> SampleBatcher::deadline() const
+{
+    std::lock_guard lock{m_mutex};
+
+    if (!m_count)
+    {
+        return std::nullopt;
+    }
+
+    return at(0).sample.received + m_latency_budget;
+}
+
+size_t SampleBatcher::flush(std::span<char> buffer)
+{
+    std::lock_guard lock{m_mutex};
+
+    if (!m_count)
+    {
+        return 0;
+    }
+
+    const auto &first = at(0).sample;
+
+    helpers::JsonWriter writer{buffer};
+    writer.raw("BAT:");
+    writer.begin_object();
+    writer.field(first.synced ? "t" : "tl", first.timestamp_us);
+    writer.begin_array("s");
+
+    // stored lengths are exact, except the first sample's delta which becomes 0
+    constexpr const size_t CLOSING_SIZE = 2;
+    size_t size = writer.size();
+    size_t packed = 0;
+    auto previous_us = first.timestamp_us;
+    for (; packed < m_count; packed++)
+    {
+        const auto &pending = at(packed);
+        const size_t length = packed ? 1 + pending.length : sample_length(pending.sample, 0);
+        if (size + length + CLOSING_SIZE > buffer.size() || pending.sample.synced != first.synced)
+        {
+            break;
+        }
+
+        encode_sample(writer, pending.sample, pending.sample.timestamp_us - previous_us);
+        previous_us = pending.sample.timestamp_us;
+        size = writer.size();
+    }
+
+    writer.end_array();
+    writer.end_object();
+
+    const auto wait_ms = to_ms(espchrono::millis_clock::now() - first.received);
+
+    for (size_t i = 0; i < std::max<size_t>(packed, 1); i++)
+    {
+        m_body_size -= at(0).length;
+        m_head = (m_head + 1) % m_pending.size();
+        m_count--;
+    }
+
+    if (!packed || writer.overflowed())
+    {
+        // cannot happen with ESP-NOW sized buffers, drop rather than block the queue
+        dropped++;
+        return 0;
+    }
+
+    frames++;
+    batched += packed;
+    max_wait_ms = std::max(max_wait_ms, wait_ms);
+    return writer.size();
+}
+
+void SampleBatcher::reset_stats()
+{
+    std::lock_guard lock{m_mutex};
+
+    samples = 0;
+    dropped = 0;
+    frames = 0;
+    batched = 0;
+    max_wait_ms = 0;
+}
+
+size_t SampleBatcher::estimated_size() const
+{
+    // "BAT:{"t":" + timestamp + ","s":[" ... "]}", "tl" is one longer
+    constexpr const size_t FIXED_SIZE = 9 + 6 + 2;
+
+    const auto &first = at(0);
+    return FIXED_SIZE + !first.sample.synced + digits(first.sample.timestamp_us) +
+           m_body_size - first.length + sample_length(first.sample, 0) + (m_count - 1);
+}
+
+} // namespace antbms
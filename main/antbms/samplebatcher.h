@@ -0,0 +1,109 @@
+#pragma once
+
+// system includes
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <span>
+
+// 3rdparty includes
+#include <espchrono.h>
+
+// local includes
+#include "datastructure.h"
+
+namespace antbms {
+
+/// The quantities that move between two status frames, in raw BMS units.
+/// Integers encode shorter than the scaled floats.
+struct CompactSample
+{
+    // local, for the latency budget
+    espchrono::millis_clock::time_point received;
+    // synchronized time of the reading, the local esp_timer time until synced
+    int64_t timestamp_us;
+    bool synced;
+    uint16_t total_voltage_cv;
+    int16_t current_da;
+    uint8_t state_of_charge;
+    uint16_t max_cell_mv;
+    uint16_t min_cell_mv;
+
+    static CompactSample from(const AntBmsData &data, espchrono::millis_clock::time_point received, int64_t local_us);
+};
+
+// Batch frame layout
+//
+//   BAT:{"t":<synchronized us of the first sample>,"s":[<sample>,<sample>,...]}
+//
+// Until the node is synced the key is "tl" and the time local. Each sample adds
+// SAMPLE_STRIDE numbers to the flat "s" array:
+//
+//   us since the previous sample (0 for the first), total voltage in 10mV,
+//   current in 100mA, state of charge in %, max cell voltage in mV, min cell voltage in mV
+constexpr static const size_t SAMPLE_STRIDE = 6;
+
+/// Collects a sample per decoded status frame and packs as many as fit into
+/// one ESP-NOW frame, trading latency for fewer frames on the channel. A batch
+/// is due once the next sample likely no longer fits or the oldest sample has
+/// waited for the latency budget.
+///
+/// add() runs on the NimBLE host task, everything else on the main loop.
+class SampleBatcher
+{
+public:
+    constexpr static const size_t MAX_SAMPLES = 32;
+
+    /// 0 disables batching, pending samples are dropped
+    void set_latency_budget(espchrono::millis_clock::duration budget);
+
+    [[nodiscard]] espchrono::millis_clock::duration latency_budget() const
+    { return m_latency_budget; }
+
+    [[nodiscard]] bool enabled() const
+    { return m_latency_budget.count() > 0; }
+
+    void add(const CompactSample &sample);
+
+    [[nodiscard]] bool due(espchrono::millis_clock::time_point now, size_t frame_size) const;
+
+    /// when the oldest pending sample runs out of latency budget, nullopt if nothing is pending
+    [[nodiscard]] std::optional<espchrono::millis_clock::time_point> deadline() const;
+
+    /// encodes the oldest samples that fit into \p buffer and removes them,
+    /// returns the frame size, 0 if there was nothing to send
+    size_t flush(std::span<char> buffer);
+
+    void reset_stats();
+
+    // per stats window
+    uint32_t samples{};
+    uint32_t dropped{};
+    uint32_t frames{};
+    uint32_t batched{};
+    int64_t max_wait_ms{};
+
+private:
+    struct Pending
+    {
+        CompactSample sample;
+        // encoded length relative to the sample before it, without separator
+        uint8_t length;
+    };
+
+    [[nodiscard]] const Pending &at(size_t index) const
+    { return m_pending[(m_head + index) % m_pending.size()]; }
+
+    [[nodiscard]] size_t estimated_size() const;
+
+    std::array<Pending, MAX_SAMPLES> m_pending{};
+    size_t m_head = 0;
+    size_t m_count = 0;
+    size_t m_body_size = 0;
+    int64_t m_last_timestamp_us = 0;
+    espchrono::millis_clock::duration m_latency_budget{};
+    mutable std::mutex m_mutex;
+};
+
+} // namespace antbms
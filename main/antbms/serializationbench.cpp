@@ -0,0 +1,147 @@
+#include "serializationbench.h"
+
+// system includes
+#include <algorithm>
+#include <array>
+
+// esp-idf includes
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <sdkconfig.h>
+#if CONFIG_HEAP_USE_HOOKS
+#include <esp_heap_caps.h>
+#endif
+
+// local includes
+#include "espnow.h"
+
+namespace antbms {
+
+namespace {
+
+constexpr const char * const TAG = "SerializationBench";
+
+constexpr const uint32_t TASK_STACK_SIZE = 8192;
+
+// allocations of the benchmark task, counted by the heap hooks
+std::atomic<TaskHandle_t> traced_task{nullptr};
+int32_t heap_current = 0;
+int32_t heap_peak = 0;
+
+struct TaskContext
+{
+    const SerializationFormat *format;
+    std::span<const RecordedSample> samples;
+    size_t iterations;
+    SerializationResult *result;
+    TaskHandle_t caller;
+};
+
+void benchmark_task(void *arg)
+{
+    auto &context = *static_cast<TaskContext *>(arg);
+    auto &result = *context.result;
+
+    heap_current = 0;
+    heap_peak = 0;
+    traced_task = xTaskGetCurrentTaskHandle();
+
+    int64_t cpu_us = 0;
+    for (size_t i = 0; i < context.iterations; i++)
+    {
+        SerializationSink sink{.rate = espnow::rate_controller().current()};
+
+        const auto start = esp_timer_get_time();
+        context.format->encode(context.samples, sink);
+        cpu_us += esp_timer_get_time() - start;
+
+        // every iteration produces the same frames
+        result.frames = sink.frames;
+        result.bytes = sink.bytes;
+        result.errors = sink.errors;
+        result.airtime_us = sink.airtime_us;
+
+        // lets the idle task feed the watchdog
+        vTaskDelay(1);
+    }
+
+    traced_task = nullptr;
+
+    result.samples = context.samples.size();
+    result.cpu_ns_per_sample = cpu_us * 1000 / std::max<int64_t>(context.samples.size() * context.iterations, 1);
+    result.stack_peak = TASK_STACK_SIZE - uxTaskGetStackHighWaterMark(nullptr);
+#if CONFIG_HEAP_USE_HOOKS
+    result.heap_peak = heap_peak;
+#endif
+
+    xTaskNotifyGive(context.caller);
+    vTaskDelete(nullptr);
+}
+
+} // namespace
+
+std::vector<SerializationResult> run_serialization_benchmark(std::span<const RecordedSample> samples,
+                                                             size_t iterations)
+{
+    std::vector<SerializationResult> results;
+
+    for (const auto &format : serialization_formats())
+    {
+        auto &result = results.emplace_back(SerializationResult{.name = format.name});
+
+        TaskContext context{
+            .format = &format,
+            .samples = samples,
+            .iterations = iterations,
+            .result = &result,
+            .caller = xTaskGetCurrentTaskHandle(),
+        };
+
+        // same priority as the main task and on either core, the notification is kept
+        // if it finishes before the caller waits for it
+        if (xTaskCreate(&benchmark_task, "serialization", TASK_STACK_SIZE, &context, 1, nullptr) != pdPASS)
+        {
+            ESP_LOGE(TAG, "Failed to create benchmark task for %s", format.name);
+            results.pop_back();
+            continue;
+        }
+
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+
+    return results;
+}
+
+void log_serialization_results(const char *tag, std::span<const SerializationResult> results)
+{
+    for (const auto &result : results)
+    {
+        std::array<char, 384> line;
+        const auto json = format_serialization_result(result, line);
+
+        ESP_LOGI(tag, "BENCH %.*s", int(json.size()), json.data());
+    }
+}
+
+} // namespace antbms
+
+#if CONFIG_HEAP_USE_HOOKS
+extern "C" void esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps)
+{
+    if (antbms::traced_task.load(std::memory_order_relaxed) == xTaskGetCurrentTaskHandle())
+    {
+        antbms::heap_current += size;
+        antbms::heap_peak = std::max(antbms::heap_peak, antbms::heap_current);
+    }
+}
+
+extern "C" void esp_heap_trace_free_hook(void *ptr)
+{
+    if (ptr && antbms::traced_task.load(std::memory_order_relaxed) == xTaskGetCurrentTaskHandle())
+    {
+        antbms::heap_current -= heap_caps_get_allocated_size(ptr);
+    }
+}
+#endif
@@ -0,0 +1,106 @@
+#pragma once
+
+// system includes
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// local includes
+#include "datastructure.h"
+#include "ratecontroller.h"
+
+namespace antbms {
+
+struct RecordedSample
+{
+    // esp_timer time the status frame started arriving
+    int64_t received_us;
+    AntBmsData data;
+};
+
+/// Keeps the first capacity decoded status frames, see AntBms::on_sample().
+/// add() runs on the NimBLE host task, samples() on any other once complete.
+class SampleRecorder
+{
+public:
+    explicit SampleRecorder(size_t capacity)
+    { m_samples.reserve(capacity); }
+
+    void add(const AntBmsData &data, int64_t received_us);
+
+    [[nodiscard]] bool complete() const
+    { return m_complete.load(std::memory_order_acquire); }
+
+    /// empty until complete
+    [[nodiscard]] std::span<const RecordedSample> samples() const
+    { return complete() ? std::span<const RecordedSample>{m_samples} : std::span<const RecordedSample>{}; }
+
+private:
+    std::vector<RecordedSample> m_samples;
+    std::atomic<bool> m_complete{false};
+};
+
+struct SerializationResult
+{
+    const char *name;
+    uint32_t samples{};
+    uint32_t frames{};
+    uint64_t bytes{};
+    uint32_t errors{};
+    int64_t cpu_ns_per_sample{};
+    // bytes of stack the encoder needed at most
+    uint32_t stack_peak{};
+    // bytes allocated at most at the same time, -1 without CONFIG_HEAP_USE_HOOKS
+    int32_t heap_peak{-1};
+    // at the current ESP-NOW rate, frames longer than ESP_NOW_MAX_DATA_LEN count as several
+    int64_t airtime_us{};
+};
+
+/// The frames one encoder produced, frames longer than ESP_NOW_MAX_DATA_LEN count as several
+struct SerializationSink
+{
+    // big enough for every encoder
+    std::array<char, 1024> buffer;
+    const espnow::PhyRate &rate;
+    uint32_t frames{};
+    uint64_t bytes{};
+    uint32_t errors{};
+    int64_t airtime_us{};
+
+    void frame(size_t size);
+};
+
+/// Every wire format in the tree, run over the same recorded samples:
+///
+///   tojson, torarejson      AntBmsData::toJSON()/toRareJSON() serialized as JSON
+///   msgpack, msgpack_rare   the same documents as MessagePack
+///   encode_fast             encodeFields() with the "fast" telemetry group, as sent by default
+///   encode_all              encodeFields() with every field, cells packed
+///   batch                   SampleBatcher "BAT:" frames, delta encoded
+///   snapshot                raw PackSnapshot as exported by the gateway
+///
+/// Plain C++, test/serialization_bench.cpp runs them on the host over captures.
+struct SerializationFormat
+{
+    const char *name;
+    void (*encode)(std::span<const RecordedSample> samples, SerializationSink &sink);
+};
+
+std::span<const SerializationFormat> serialization_formats();
+
+/// Runs every format \p iterations times in a task of its own so its stack
+/// peak can be read from the high water mark. Blocks the caller for a few seconds.
+std::vector<SerializationResult> run_serialization_benchmark(std::span<const RecordedSample> samples,
+                                                             size_t iterations);
+
+/// "{...}" JSON of one result, as tools/benchmark-results expects it after "BENCH "
+std::string_view format_serialization_result(const SerializationResult &result, std::span<char> buffer);
+
+/// one "BENCH {...}" JSON line per result, tools/benchmark-results turns the
+/// monitor output into a results file and compares it against a baseline
+void log_serialization_results(const char *tag, std::span<const SerializationResult> results);
+
+} // namespace antbms
@@ -0,0 +1,187 @@
+#include "serializationbench.h"
+
+// system includes
+#include <cstring>
+
+// esp-idf includes
+#include <esp_now.h>
+
+// 3rdparty includes
+#include <ArduinoJson.h>
+
+// local includes
+#include "gatewaystore.h"
+#include "helpers/jsonwriter.h"
+#include "samplebatcher.h"
+#include "telemetryscheduler.h"
+
+namespace antbms {
+
+namespace {
+
+// same 4 byte type prefix for every format, the receiver has to tell them apart somehow
+template<bool rare, bool msgpack>
+void encode_document(std::span<const RecordedSample> samples, SerializationSink &sink)
+{
+    uint8_t counter = 0;
+
+    for (const auto &sample : samples)
+    {
+        ArduinoJson::StaticJsonDocument<1024> doc;
+        const auto result = rare ? sample.data.toRareJSON(doc, counter) : sample.data.toJSON(doc);
+        if (!result)
+        {
+            sink.errors++;
+            continue;
+        }
+
+        std::memcpy(sink.buffer.data(), "BMS:", 4);
+        const auto size = msgpack ? serializeMsgPack(doc, sink.buffer.data() + 4, sink.buffer.size() - 4) :
+                                    serializeJson(doc, sink.buffer.data() + 4, sink.buffer.size() - 4);
+        sink.frame(4 + size);
+    }
+}
+
+FieldMask fast_fields()
+{
+    const TelemetryScheduler scheduler;
+    for (const auto &group : scheduler.groups())
+    {
+        if (std::string_view{group.name} == "fast")
+        {
+            return group.fields;
+        }
+    }
+    return 0;
+}
+
+template<bool all>
+void encode_fields(std::span<const RecordedSample> samples, SerializationSink &sink)
+{
+    static const FieldMask fields = all ? ALL_FIELDS & ~field_bit(Field::CellVoltages) : fast_fields();
+
+    for (const auto &sample : samples)
+    {
+        if (const auto size = sample.data.encodeFields(sink.buffer, fields))
+        {
+            sink.frame(*size);
+        }
+        else
+        {
+            sink.errors++;
+        }
+    }
+}
+
+void encode_batch(std::span<const RecordedSample> samples, SerializationSink &sink)
+{
+    SampleBatcher batcher;
+    // only full frames go out, the budget would depend on the poll interval
+    batcher.set_latency_budget(std::chrono::hours{1});
+
+    const auto received = [](int64_t us) {
+        return espchrono::millis_clock::time_point{std::chrono::milliseconds{us / 1000}};
+    };
+
+    const auto flush = [&]() {
+        if (const auto size = batcher.flush({sink.buffer.data(), ESP_NOW_MAX_DATA_LEN}))
+        {
+            sink.frame(size);
+        }
+        else
+        {
+            sink.errors++;
+        }
+    };
+
+    for (const auto &sample : samples)
+    {
+        batcher.add(CompactSample::from(sample.data, received(sample.received_us), sample.received_us));
+        while (batcher.due(received(sample.received_us), ESP_NOW_MAX_DATA_LEN))
+        {
+            flush();
+        }
+    }
+
+    while (batcher.deadline())
+    {
+        flush();
+    }
+}
+
+void encode_snapshot(std::span<const RecordedSample> samples, SerializationSink &sink)
+{
+    uint32_t updates = 0;
+    for (const auto &sample : samples)
+    {
+        const auto snapshot = PackSnapshot::from(sample.data, sample.received_us, ++updates);
+        std::memcpy(sink.buffer.data(), &snapshot, sizeof(snapshot));
+        sink.frame(sizeof(snapshot));
+    }
+}
+
+constexpr const SerializationFormat FORMATS[] = {
+        {"tojson", &encode_document<false, false>},
+        {"torarejson", &encode_document<true, false>},
+        {"msgpack", &encode_document<false, true>},
+        {"msgpack_rare", &encode_document<true, true>},
+        {"encode_fast", &encode_fields<false>},
+        {"encode_all", &encode_fields<true>},
+        {"batch", &encode_batch},
+        {"snapshot", &encode_snapshot},
+};
+
+} // namespace
+
+void SerializationSink::frame(size_t size)
+{
+    bytes += size;
+    for (; size > ESP_NOW_MAX_DATA_LEN; size -= ESP_NOW_MAX_DATA_LEN)
+    {
+        frames++;
+        airtime_us += espnow::airtime_us(rate, ESP_NOW_MAX_DATA_LEN);
+    }
+    frames++;
+    airtime_us += espnow::airtime_us(rate, size);
+}
+
+std::span<const SerializationFormat> serialization_formats()
+{
+    return FORMATS;
+}
+
+void SampleRecorder::add(const AntBmsData &data, int64_t received_us)
+{
+    if (complete())
+    {
+        return;
+    }
+
+    m_samples.push_back(RecordedSample{.received_us = received_us, .data = data});
+
+    if (m_samples.size() == m_samples.capacity())
+    {
+        m_complete.store(true, std::memory_order_release);
+    }
+}
+
+std::string_view format_serialization_result(const SerializationResult &result, std::span<char> buffer)
+{
+    helpers::JsonWriter writer{buffer};
+    writer.begin_object();
+    writer.field("name", result.name);
+    writer.field("samples", result.samples);
+    writer.field("frames", result.frames);
+    writer.field("bytes", result.bytes);
+    writer.field("errors", result.errors);
+    writer.field("bytes_per_sample", result.samples ? float(result.bytes) / result.samples : 0.f);
+    writer.field("cpu_ns_per_sample", result.cpu_ns_per_sample);
+    writer.field("stack_peak", result.stack_peak);
+    writer.field("heap_peak", result.heap_peak);
+    writer.field("airtime_us_per_sample", result.samples ? float(result.airtime_us) / result.samples : 0.f);
+    writer.end_object();
+
+    return writer.view();
+}
+
+} // namespace antbms
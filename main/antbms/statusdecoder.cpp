@@ -0,0 +1,214 @@
+#include "statusdecoder.h"
+
+// esp-idf includes
+#include <esp_log.h>
+
+// 3rdparty includes
+#include <fmt/core.h>
+
+// local includes
+#include "frame.h"
+
+namespace antbms {
+
+namespace {
+
+constexpr const char * const TAG = "StatusDecoder";
+
+} // namespace
+
+std::expected<void, std::string> validate_status_frame(std::span<const uint8_t> frame)
+{
+    if (frame.size() < STATUS_FIXED_SIZE)
+    {
+        return std::unexpected(fmt::format("too short ({} bytes)", frame.size()));
+    }
+
+    if (frame.size() != ANT_FRAME_OVERHEAD + frame[5])
+    {
+        return std::unexpected(fmt::format("length byte {} does not match frame size {}", frame[5], frame.size()));
+    }
+
+    const uint8_t temperature_sensors = frame[8];
+    const uint8_t cells = frame[9];
+    if (cells > MAX_CELLS)
+    {
+        return std::unexpected(fmt::format("{} cells exceed maximum of {}", cells, MAX_CELLS));
+    }
+
+    if (frame.size() != STATUS_FIXED_SIZE + cells * 2 + temperature_sensors * 2)
+    {
+        return std::unexpected(fmt::format("{} cells and {} sensors do not fit frame size {}", cells,
+                                           temperature_sensors, frame.size()));
+    }
+
+    return {};
+}
+
+void decode_status_frame(std::span<const uint8_t> frame, AntBmsData &data)
+{
+    // every access below stays within the layout validated above
+    const uint8_t *raw = frame.data();
+    auto ant_get_16bit = [raw](size_t i) -> uint16_t {
+        return (uint16_t(raw[i + 1]) << 8) | (uint16_t(raw[i + 0]) << 0);
+    };
+    auto ant_get_32bit = [&](size_t i) -> uint32_t {
+        return (uint32_t(ant_get_16bit(i + 2)) << 16) | (uint32_t(ant_get_16bit(i + 0)) << 0);
+    };
+
+    // Status request
+    // -> 0x7e 0xa1 0x01 0x00 0x00 0xbe 0x18 0x55 0xaa 0x55
+    //
+    // Status response
+    //
+    // Byte Len Payload     Description                      Unit  Precision
+    //   0   2  0x7E 0xA1   Start of frame
+    //   2   1  0x11        Function
+    //   3   2  0x00 0x00   Address
+    //   5   1  0x8E        Data length
+    //   6   1  0x05        Permissions
+    ESP_LOGV(TAG, "  Permissions: %d", raw[6]);
+
+    //   7   1  0x01        Battery status (0: Unknown, 1: Idle, 2: Charge, 3: Discharge, 4: Standby, 5: Error)
+    ESP_LOGV(TAG, "  Battery status: %d", raw[7]);
+    data.battery_status = static_cast<BatteryStatus>(raw[7]);
+
+    //   8   1  0x04        Number of temperature sensors       max 4.
+    uint8_t temperature_sensors = raw[8];
+    ESP_LOGV(TAG, "  Number of temperature sensors: %d", temperature_sensors);
+
+    //   9   1  0x0E        Number of cells (14)                max 32
+    uint8_t cells = raw[9];
+
+    //  10   8  0x02 0x00 0x00 0x00 0x00 0x00 0x00 0x00   Protection bitmask
+    //  18   8  0x00 0x00 0x00 0x01 0x00 0x00 0x00 0x00   Warning bitmask
+    //  26   8  0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00   Balancing? bitmask
+
+    //  34   2  0x11 0x10   Cell voltage 1             uint16_t
+    //  36   2  0x11 0x10   Cell voltage 2
+    //  38   2  0x11 0x10   Cell voltage 3
+    //  40   2  0x11 0x10   Cell voltage 4
+    //  42   2  0x11 0x10   Cell voltage 5
+    //  44   2  0x11 0x10   Cell voltage 6
+    //  46   2  0x11 0x10   Cell voltage 7
+    //  48   2  0x11 0x10   Cell voltage 8
+    //  50   2  0x11 0x10   Cell voltage 9
+    //  52   2  0x11 0x10   Cell voltage 10
+    //  54   2  0x11 0x10   Cell voltage 11
+    //  56   2  0x11 0x10   Cell voltage 12
+    //  58   2  0x11 0x10   Cell voltage 13
+    //  60   2  0x11 0x10   Cell voltage 14            uint16_t
+    data.cell_voltages.clear();
+    for (uint8_t i = 0; i < cells; i++)
+    {
+        data.cell_voltages.push_back(ant_get_16bit(i * 2 + 34) * 0.001f);
+    }
+
+    size_t offset = cells * 2;
+
+    //  62   2  0x1C 0x00   Temperature sensor 1        int16_t
+    //  64   2  0x1C 0x00   Temperature sensor 2        int16_t
+    //  66   2  0xD8 0xFF   Temperature sensor 3        int16_t
+    //  68   2  0x1C 0x00   Temperature sensor 4        int16_t
+    //  70   2  0x1C 0x00   Mosfet temperature          int16_t
+    //  72   2  0x1C 0x00   Balancer temperature        int16_t
+    data.temperatures.clear();
+    for (uint8_t i = 0; i < temperature_sensors; i++)
+    {
+        data.temperatures.push_back(((int16_t) ant_get_16bit(i * 2 + 34 + offset)) * 1.0f);
+    }
+
+    offset = offset + (temperature_sensors * 2);
+    //  70   2  0x1C 0x00   Mosfet temperature          int16_t
+    data.mosfet_temperature = ((int16_t) ant_get_16bit(34 + offset)) * 1.0f;
+
+    //  72   2  0x1C 0x00   Balancer temperature        int16_t
+    data.balancer_temperature = ((int16_t) ant_get_16bit(36 + offset)) * 1.0f;
+
+    //  74   2  0x7E 0x16   Total voltage              uint16_t
+    data.total_voltage = ant_get_16bit(38 + offset) * 0.01f;
+
+    //  76   2  0x00 0x00   Current                     int16_t
+    data.current = ((int16_t) ant_get_16bit(40 + offset)) * 0.1f;
+
+    //  78   2  0x60 0x00   State of charge            uint16_t
+    data.state_of_charge = ((int16_t) ant_get_16bit(42 + offset)) * 1.0f;
+
+    //  80   2  0x64 0x00   State of health            uint16_t
+    //ESP_LOGI(TAG, "  State of health: %.0f %%", ant_get_16bit(44 + offset) * 1.0f);
+    data.state_of_health = ((int16_t) ant_get_16bit(44 + offset)) * 1.0f;
+
+
+    //  82   1  0x01        Charge MOS status
+    uint8_t raw_charge_mosfet_status = raw[46 + offset];
+    data.charge_mosfet_status = static_cast<ChargeMosfetStatus>(raw_charge_mosfet_status);
+
+    //  83   1  0x02        Discharge MOS status
+    uint8_t raw_discharge_mosfet_status = raw[47 + offset];
+    data.discharge_mosfet_status = static_cast<DischargeMosfetStatus>(raw_discharge_mosfet_status);
+
+    //  84   1  0x00        Balancer status
+    uint8_t raw_balancer_status = raw[48 + offset];
+    data.balancer_status = static_cast<BalancerStatus>(raw_balancer_status);
+
+    //  85   1  0x00        Reserved
+    //  86   4  0x80 0xC3 0xC9 0x01    Battery capacity            uint32_t
+    data.total_battery_capacity_setting = ant_get_32bit(50 + offset) * 0.000001f;
+
+    //  90   4  0x4F 0x55 0xB3 0x01    Battery capacity remaining  uint32_t
+    data.capacity_remaining = ant_get_32bit(54 + offset) * 0.000001f;
+
+    //  94   4  0x08 0x53 0x00 0x00    Total battery cycles capacity     uint32_t
+    data.battery_cycle_capacity = ant_get_32bit(58 + offset) * 0.001f;
+
+    //  98   4  0x00 0x00 0x00 0x00    Power
+    data.power = ((int32_t) ant_get_32bit(62 + offset)) * 1.0f;
+
+
+    // 102   4  0x6B 0x28 0x12 0x00    Total runtime
+    data.total_runtime = ant_get_32bit(66 + offset);
+
+    // 106   4  0x00 0x00 0x00 0x00    Balanced cell bitmask
+    data.balanced_cell_bitmask = ant_get_32bit(70 + offset);
+
+    // 110   2  0x11 0x10              Maximum cell voltage
+    data.max_cell_voltage = ant_get_16bit(74 + offset) * 0.001f;
+
+    // 112   2  0x01 0x00              Maximum voltage cell
+    data.max_voltage_cell = ant_get_16bit(76 + offset) * 1.0f;
+
+    // 114   2  0x11 0x10              Minimum cell voltage
+    data.min_cell_voltage = ant_get_16bit(78 + offset) * 0.001f;
+
+    // 116   2  0x01 0x00              Minimum voltage cell
+    data.min_voltage_cell = ant_get_16bit(80 + offset) * 1.0f;
+
+    // 118   2  0x00 0x00              Delta cell voltage
+    data.delta_cell_voltage = ant_get_16bit(82 + offset) * 0.001f;
+
+    // 120   2  0x11 0x10              Average cell voltage
+    data.average_cell_voltage = ant_get_16bit(84 + offset) * 0.001f;
+
+    // 122   2  0x02 0x00              Discharge MOSFET, voltage between D-S
+    // 124   2  0x70 0x00              Drive voltage (discharge MOSFET)
+    // 126   2  0x03 0x00              Drive voltage (charge MOSFET)
+    // 128   2  0xAC 0x02              F40com
+    // 130   2  0xF1 0xFA              Battery type (0xfaf1: Ternary Lithium, 0xfaf2: Lithium Iron Phosphate,
+    //                                               0xfaf3: Lithium Titanate, 0xfaf4: Custom)
+    // 132   4  0x7D 0x2E 0x00 0x00    Accumulated discharging capacity
+    data.accumulated_discharging_capacity = ant_get_32bit(96 + offset) * 0.001f;
+
+    // 136   4  0x94 0x77 0x00 0x00    Accumulated charging capacity
+    data.accumulated_charging_capacity = ant_get_32bit(100 + offset) * 0.001f;
+
+    // 140   4  0xDE 0x07 0x00 0x00    Accumulated discharging time
+    data.accumulated_discharging_time = ant_get_32bit(104 + offset);
+
+    // 144   4  0x77 0x76 0x00 0x00    Accumulated charging time
+    data.accumulated_charging_time = ant_get_32bit(108 + offset);
+
+    // 148   2  0x35 0xE2              CRC
+    // 150   2  0xAA 0x55              End of frame
+}
+
+} // namespace antbms
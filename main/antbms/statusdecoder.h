@@ -0,0 +1,26 @@
+#pragma once
+
+// system includes
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <span>
+#include <string>
+
+// local includes
+#include "datastructure.h"
+
+namespace antbms {
+
+// a status frame is 116 bytes plus 2 per cell and 2 per temperature sensor
+constexpr static const size_t STATUS_FIXED_SIZE = 116;
+constexpr static const uint8_t MAX_CELLS = 32;
+
+/// Checks everything decode_status_frame() derives offsets from, so the decode itself needs no checks
+std::expected<void, std::string> validate_status_frame(std::span<const uint8_t> frame);
+
+/// Decodes a complete status frame into \p data, the frame has to pass validate_status_frame().
+/// Leaves the timestamp and the fields derived on the node alone.
+void decode_status_frame(std::span<const uint8_t> frame, AntBmsData &data);
+
+} // namespace antbms
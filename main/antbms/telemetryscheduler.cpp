@@ -0,0 +1,179 @@
+#include "telemetryscheduler.h"
+
+// system includes
+#include <algorithm>
+
+namespace antbms {
+
+using namespace std::chrono_literals;
+
+TelemetryScheduler::TelemetryScheduler()
+{
+    // defaults reproduce the old fast/rare alternation: fast fields every
+    // second slot, each rare group once per full rotation
+    constexpr const std::array<TelemetryGroup, 11> DEFAULT_GROUPS{{
+            {.name = "fast", .fields = field_mask(
+                    Field::Power, Field::TotalVoltage, Field::Current, Field::StateOfCharge, Field::CapacityRemaining,
+                    Field::ChargeMosfetStatus, Field::DischargeMosfetStatus, Field::BalancerStatus,
+                    Field::DeltaCellVoltage, Field::MaxCellVoltage, Field::MinCellVoltage, Field::PackedCellVoltages),
+             .period = 200ms, .priority = 4},
+            {.name = "health", .fields = field_mask(
+                    Field::BalancerTemperature, Field::MosfetTemperature, Field::StateOfHealth),
+             .period = 2s, .priority = 2},
+            {.name = "capacity", .fields = field_mask(
+                    Field::TotalBatteryCapacitySetting, Field::BatteryCycleCapacity, Field::TotalRuntime),
+             .period = 2s, .priority = 1},
+            {.name = "balance", .fields = field_mask(
+                    Field::BalancedCellBitmask, Field::MaxVoltageCell, Field::MinVoltageCell),
+             .period = 2s, .priority = 1},
+            {.name = "accumulated", .fields = field_mask(
+                    Field::AccumulatedChargingCapacity, Field::AccumulatedDischargingTime,
+                    Field::AccumulatedChargingTime, Field::AccumulatedDischargingCapacity),
+             .period = 2s, .priority = 1},
+            {.name = "average", .fields = field_mask(Field::AverageCellVoltage),
+             .period = 2s, .priority = 1},
+            {.name = "status_text", .fields = field_mask(
+                    Field::ChargeMosfetStatusString, Field::DischargeMosfetStatusString, Field::BalancerStatusString),
+             .period = 2s, .priority = 1},
+            {.name = "info", .fields = field_mask(
+                    Field::AccumulatedDischargingTimeFormatted, Field::AccumulatedChargingTimeFormatted,
+                    Field::HardwareVersion, Field::SoftwareVersion, Field::TotalRuntimeFormatted),
+             .period = 2s, .priority = 1},
+            {.name = "cells", .fields = field_mask(Field::CellVoltages),
+             .period = 2s, .priority = 1},
+            {.name = "temperatures", .fields = field_mask(Field::Temperatures),
+             .period = 2s, .priority = 2},
+            {.name = "analytics", .fields = field_mask(
+                    Field::EnergyIn, Field::EnergyOut, Field::AverageCurrent, Field::CRate, Field::ImbalanceTrend,
+                    Field::InternalResistance),
+             .period = 2s, .priority = 1},
+    }};
+
+    std::copy(DEFAULT_GROUPS.begin(), DEFAULT_GROUPS.end(), m_groups.begin());
+    m_group_count = DEFAULT_GROUPS.size();
+}
+
+TelemetryGroup *TelemetryScheduler::find(std::string_view name)
+{
+    for (size_t i = 0; i < m_group_count; i++)
+    {
+        if (name == m_groups[i].name)
+        {
+            return &m_groups[i];
+        }
+    }
+
+    return nullptr;
+}
+
+bool TelemetryScheduler::set_period(std::string_view name, espchrono::millis_clock::duration period)
+{
+    if (auto *group = find(name); group)
+    {
+        group->period = period;
+        return true;
+    }
+
+    return false;
+}
+
+bool TelemetryScheduler::set_priority(std::string_view name, uint8_t priority)
+{
+    if (auto *group = find(name); group)
+    {
+        group->priority = priority;
+        return true;
+    }
+
+    return false;
+}
+
+bool TelemetryScheduler::set_min_period(std::string_view name, espchrono::millis_clock::duration min_period)
+{
+    if (auto *group = find(name); group)
+    {
+        group->min_period = min_period;
+        return true;
+    }
+
+    return false;
+}
+
+size_t TelemetryScheduler::due(espchrono::millis_clock::time_point now, std::span<size_t, MAX_GROUPS> out) const
+{
+    std::array<float, MAX_GROUPS> weights;
+    size_t count = 0;
+
+    for (size_t i = 0; i < m_group_count; i++)
+    {
+        const auto &group = m_groups[i];
+        const auto period = effective_period(group);
+        const auto elapsed = now - group.last_handled;
+        if (elapsed < period)
+        {
+            continue;
+        }
+
+        const float overdue = float(elapsed.count()) / std::max<espchrono::millis_clock::rep>(period.count(), 1);
+        weights[i] = overdue * group.priority;
+        out[count++] = i;
+    }
+
+    std::sort(out.begin(), out.begin() + count, [&weights](size_t a, size_t b) { return weights[a] > weights[b]; });
+
+    return count;
+}
+
+std::optional<espchrono::millis_clock::time_point> TelemetryScheduler::next_due() const
+{
+    std::optional<espchrono::millis_clock::time_point> next;
+
+    for (size_t i = 0; i < m_group_count; i++)
+    {
+        const auto due = m_groups[i].last_handled + effective_period(m_groups[i]);
+        if (!next || due < *next)
+        {
+            next = due;
+        }
+    }
+
+    return next;
+}
+
+void TelemetryScheduler::sent(size_t index, espchrono::millis_clock::time_point now)
+{
+    auto &group = m_groups[index];
+    handled(group, now);
+    group.last_sent = now;
+    group.sent++;
+}
+
+void TelemetryScheduler::unchanged(size_t index, espchrono::millis_clock::time_point now)
+{
+    auto &group = m_groups[index];
+    handled(group, now);
+    group.unchanged++;
+}
+
+void TelemetryScheduler::handled(TelemetryGroup &group, espchrono::millis_clock::time_point now)
+{
+    if (group.last_handled != espchrono::millis_clock::time_point{})
+    {
+        group.max_staleness = std::max(group.max_staleness, now - group.last_handled);
+    }
+
+    group.last_handled = now;
+}
+
+void TelemetryScheduler::reset_stats()
+{
+    for (size_t i = 0; i < m_group_count; i++)
+    {
+        auto &group = m_groups[i];
+        group.sent = 0;
+        group.unchanged = 0;
+        group.max_staleness = {};
+    }
+}
+
+} // namespace antbms
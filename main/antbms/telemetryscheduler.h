@@ -0,0 +1,87 @@
+#pragma once
+
+// system includes
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+
+// 3rdparty includes
+#include <espchrono.h>
+
+// local includes
+#include "datastructure.h"
+
+namespace antbms {
+
+struct TelemetryGroup
+{
+    const char *name;
+    FieldMask fields;
+    espchrono::millis_clock::duration period;
+    // lower bound on period while someone else carries the data, see set_min_period()
+    espchrono::millis_clock::duration min_period{};
+    // weighs how overdue a group is against the others
+    uint8_t priority;
+
+    // bookkeeping, handled covers both sent and found unchanged
+    espchrono::millis_clock::time_point last_handled{};
+    espchrono::millis_clock::time_point last_sent{};
+    // longest gap between two handled slots, compare against period
+    espchrono::millis_clock::duration max_staleness{};
+    uint32_t sent{};
+    uint32_t unchanged{};
+};
+
+/// Decides which field groups go into the next telemetry slot. A group is due
+/// once its period elapsed; due groups are offered most overdue first, where
+/// overdue is elapsed / period scaled by priority.
+class TelemetryScheduler
+{
+public:
+    constexpr static const size_t MAX_GROUPS = 16;
+
+    TelemetryScheduler();
+
+    bool set_period(std::string_view name, espchrono::millis_clock::duration period);
+
+    bool set_priority(std::string_view name, uint8_t priority);
+
+    /// slows a group down without touching its configured period, 0 lifts the limit
+    bool set_min_period(std::string_view name, espchrono::millis_clock::duration min_period);
+
+    static espchrono::millis_clock::duration effective_period(const TelemetryGroup &group)
+    { return std::max(group.period, group.min_period); }
+
+    /// writes the indices of all due groups into \p out, most overdue first
+    size_t due(espchrono::millis_clock::time_point now, std::span<size_t, MAX_GROUPS> out) const;
+
+    /// earliest time any group becomes due, nullopt without groups
+    std::optional<espchrono::millis_clock::time_point> next_due() const;
+
+    /// group went out in this slot
+    void sent(size_t index, espchrono::millis_clock::time_point now);
+
+    /// group was due, but nothing in it changed
+    void unchanged(size_t index, espchrono::millis_clock::time_point now);
+
+    [[nodiscard]] const TelemetryGroup &group(size_t index) const
+    { return m_groups[index]; }
+
+    [[nodiscard]] std::span<const TelemetryGroup> groups() const
+    { return {m_groups.data(), m_group_count}; }
+
+    void reset_stats();
+
+private:
+    TelemetryGroup *find(std::string_view name);
+
+    static void handled(TelemetryGroup &group, espchrono::millis_clock::time_point now);
+
+    std::array<TelemetryGroup, MAX_GROUPS> m_groups{};
+    size_t m_group_count = 0;
+};
+
+} // namespace antbms
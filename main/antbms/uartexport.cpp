@@ -0,0 +1,106 @@
+#include "uartexport.h"
+
+// esp-idf includes
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+namespace antbms {
+
+namespace {
+
+constexpr const char * const TAG = "UartExport";
+
+} // namespace
+
+bool UartExport::start(const Config &config)
+{
+    m_config = config;
+
+    // field by field, the layout of uart_config_t differs between targets
+    uart_config_t uart_config{};
+    uart_config.baud_rate = config.baud_rate;
+    uart_config.data_bits = UART_DATA_8_BITS;
+    uart_config.parity = UART_PARITY_DISABLE;
+    uart_config.stop_bits = UART_STOP_BITS_1;
+    uart_config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+    uart_config.source_clk = UART_SCLK_DEFAULT;
+
+    // the driver wants an RX buffer even though nothing is read
+    if (auto err = uart_driver_install(config.port, 256, config.tx_buffer_size, 0, nullptr, 0); err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "uart_driver_install failed: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    if (auto err = uart_param_config(config.port, &uart_config); err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "uart_param_config failed: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    if (auto err = uart_set_pin(config.port, config.tx_pin, config.rx_pin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+        err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "uart_set_pin failed: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    if (xTaskCreate(&UartExport::task, "uart_export", 4096, this, 3, nullptr) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed to create export task");
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Exporting on UART%d at %d baud", config.port, config.baud_rate);
+    return true;
+}
+
+void UartExport::log(const char *tag)
+{
+    const auto elapsed_s = std::chrono::duration_cast<std::chrono::duration<float>>(
+            espchrono::millis_clock::now() - m_window_start).count();
+    m_window_start = espchrono::millis_clock::now();
+
+    const auto sent_frames = frames.exchange(0);
+    const auto sent_bytes = bytes.exchange(0);
+    const auto skipped_batches = skipped.exchange(0);
+    // 10 bit times per byte with 8N1
+    const auto capacity = m_config.baud_rate / 10.f;
+
+    ESP_LOGI(tag, "UART export: frames=%ld (%.0f/s) bytes=%ld (%.0f/s, %.1f%% of line) skipped=%ld",
+             sent_frames, sent_frames / elapsed_s, sent_bytes, sent_bytes / elapsed_s,
+             sent_bytes / elapsed_s / capacity * 100.f, skipped_batches);
+}
+
+void UartExport::task(void *arg)
+{
+    auto &self = *static_cast<UartExport *>(arg);
+
+    TickType_t last_wake = xTaskGetTickCount();
+    while (true)
+    {
+        self.m_encoder.export_changed([&self](std::span<const uint8_t> batch, size_t batch_frames) {
+            self.flush_(batch, batch_frames);
+        });
+
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(std::chrono::milliseconds{self.m_config.interval}.count()));
+    }
+}
+
+void UartExport::flush_(std::span<const uint8_t> batch, size_t batch_frames)
+{
+    // uart_write_bytes() would block until the ring has room, the host sees the gap in the sequence numbers
+    size_t free = 0;
+    if (uart_get_tx_buffer_free_size(m_config.port, &free) != ESP_OK || free < batch.size())
+    {
+        skipped += batch_frames;
+    }
+    else if (const auto written = uart_write_bytes(m_config.port, batch.data(), batch.size()); written > 0)
+    {
+        frames += batch_frames;
+        bytes += written;
+    }
+}
+
+} // namespace antbms
@@ -0,0 +1,64 @@
+#pragma once
+
+// system includes
+#include <atomic>
+#include <cstdint>
+#include <span>
+
+// esp-idf includes
+#include <driver/uart.h>
+
+// 3rdparty includes
+#include <espchrono.h>
+
+// local includes
+#include "exportencoder.h"
+#include "gatewaystore.h"
+
+namespace antbms {
+
+/// Streams every pack snapshot that changed out of a UART, encoded by an
+/// ExportEncoder, so the ingest path never waits for the export. The UART
+/// driver's TX ring buffer is drained by interrupt while the export task
+/// encodes the next batch; a batch that does not fit into the ring is skipped
+/// rather than waited for.
+class UartExport
+{
+public:
+    struct Config
+    {
+        // UART0 carries the log
+        uart_port_t port = UART_NUM_1;
+        int tx_pin = 17;
+        int rx_pin = UART_PIN_NO_CHANGE;
+        int baud_rate = 2'000'000;
+        espchrono::millis_clock::duration interval = std::chrono::milliseconds{50};
+        int tx_buffer_size = 8192;
+    };
+
+    explicit UartExport(const GatewayStore &store) :
+            m_encoder{store}
+    {}
+
+    /// installs the UART driver and starts the export task
+    bool start(const Config &config);
+
+    void log(const char *tag);
+
+    // per stats window
+    std::atomic<uint32_t> frames{};
+    std::atomic<uint32_t> bytes{};
+    std::atomic<uint32_t> skipped{};
+
+private:
+    static void task(void *arg);
+
+    void flush_(std::span<const uint8_t> batch, size_t batch_frames);
+
+    ExportEncoder m_encoder;
+    Config m_config;
+
+    espchrono::millis_clock::time_point m_window_start = espchrono::millis_clock::now();
+};
+
+} // namespace antbms
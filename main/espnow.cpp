@@ -1,27 +1,115 @@
 #include "espnow.h"
 
 // system includes
+#include <algorithm>
+#include <array>
+#include <charconv>
 #include <cstring>
 #include <string_view>
 #include <deque>
+#include <mutex>
+#include <tuple>
+#include <utility>
+#include <vector>
 
 // esp-idf includes
 #include <esp_log.h>
 #include <esp_netif.h>
 #include <esp_wifi.h>
 #include <esp_now.h>
+#include <esp_random.h>
+#include <esp_timer.h>
 #include <nvs_flash.h>
 
 // 3rd party includes
 #include <fmt/core.h>
 #include <espchrono.h>
 
+// local includes
+#include "helpers/durationstats.h"
+#include "ratecontroller.h"
+
 constexpr const char * const TAG = "espnow";
 
 namespace espnow {
 
 std::deque<espnow_recv_param_t> message_queue;
 
+std::vector<std::pair<std::string, message_handler_t>> message_handlers;
+
+send_status_handler_t send_status_handler;
+
+bool loopback_enabled = false;
+uint32_t loopback_loss_threshold = 0;
+loopback_stats_t loopback_counters{};
+
+RateController rate_control;
+bool adaptive_rate = false;
+
+TimeSync time_sync_state;
+
+// connectionless power save, only available in station mode
+bool power_save = false;
+uint16_t power_save_interval_ms = 0;
+uint16_t power_save_window_ms = 0;
+bool radio_awake_state = true;
+
+int64_t last_message_at = 0;
+helpers::DurationStats rx_latency_stats;
+
+using mac_t = std::array<uint8_t, ESP_NOW_ETH_ALEN>;
+
+// send_reliable() messages until acknowledged, onSend() runs on the Wi-Fi task
+struct retry_t
+{
+    uint32_t id;
+    mac_t mac_addr;
+    std::string msg;
+    int64_t deadline_us;
+    int64_t next_attempt_us;
+    bool in_flight;
+    bool delivered;
+};
+
+// every send() waiting for its status, with the retry it belongs to (0: none). ESP-NOW
+// reports sends in order, so the oldest entry of a peer is the one onSend() reports.
+struct pending_send_t
+{
+    mac_t mac_addr;
+    uint32_t retry_id;
+};
+
+constexpr const int64_t RETRY_INTERVAL_US = 10'000;
+// a status that never came must not grow the queue forever
+constexpr const size_t MAX_PENDING_SENDS = 32;
+
+std::mutex retry_mutex;
+std::vector<retry_t> retries;
+// 0 is a send() without retry
+uint32_t next_retry_id = 1;
+std::deque<pending_send_t> pending_sends;
+// peers send_reliable() added itself, removed again with their last retry
+std::vector<mac_t> temporary_peers;
+
+mac_t to_mac(const uint8_t *mac_addr)
+{
+    mac_t mac;
+    std::memcpy(mac.data(), mac_addr, ESP_NOW_ETH_ALEN);
+    return mac;
+}
+
+// true if the peer was one of send_reliable()'s, the caller takes it over
+bool release_temporary_peer(const uint8_t *mac_addr)
+{
+    std::lock_guard lock{retry_mutex};
+    return std::erase(temporary_peers, to_mac(mac_addr)) != 0;
+}
+
+wifi_interface_t wifi_interface()
+{
+    return power_save ? WIFI_IF_STA : WIFI_IF_AP;
+}
+
 void wifi_init()
 {
     if (auto err = nvs_flash_init(); err != ESP_OK)
@@ -73,7 +161,8 @@ void wifi_init()
         return;
     }
 
-    if (auto err = esp_wifi_set_mode(WIFI_MODE_AP); err != ESP_OK)
+    // an unconnected station may sleep between wake windows, an AP never does
+    if (auto err = esp_wifi_set_mode(power_save ? WIFI_MODE_STA : WIFI_MODE_AP); err != ESP_OK)
     {
         ESP_LOGE(TAG, "esp_wifi_set_mode failed: %s", esp_err_to_name(err));
         return;
@@ -85,7 +174,7 @@ void wifi_init()
         return;
     }
 
-    if (auto err = esp_wifi_set_ps(WIFI_PS_NONE); err != ESP_OK)
+    if (auto err = esp_wifi_set_ps(power_save ? WIFI_PS_MIN_MODEM : WIFI_PS_NONE); err != ESP_OK)
     {
         ESP_LOGE(TAG, "esp_wifi_set_ps failed: %s", esp_err_to_name(err));
         return;
@@ -94,6 +183,9 @@ void wifi_init()
 
 void onRecv(const esp_now_recv_info* info, const uint8_t* data, int data_len)
 {
+    // first thing, time sync depends on it
+    const auto received_us = esp_timer_get_time();
+
     const std::string_view data_str{reinterpret_cast<const char *>(data), static_cast<size_t>(data_len)};
 
     size_t sep_pos = data_str.find_first_of(':');
@@ -106,7 +198,16 @@ void onRecv(const esp_now_recv_info* info, const uint8_t* data, int data_len)
     auto msg = espnow_recv_param_t{
         .content = std::string{data_str.substr(sep_pos + 1)},
         .type = std::string{data_str.substr(0, sep_pos)},
+        .mac_addr = {},
+        .received_us = received_us,
     };
+    std::memcpy(msg.mac_addr.data(), info->src_addr, ESP_NOW_ETH_ALEN);
+
+    // loopback has no radio metadata
+    if (info->rx_ctrl)
+    {
+        rate_control.rssi(info->src_addr, info->rx_ctrl->rssi);
+    }
 
     message_queue.push_back(msg);
 }
@@ -119,6 +220,41 @@ void onSend(const uint8_t* mac_addr, esp_now_send_status_t status)
     {
         ESP_LOGE(TAG, "send_cb, status: %d", status);
     }
+
+    // broadcasts are never acknowledged, only unicast tells us how the rate is doing
+    if (std::memcmp(mac_addr, broadcast_address, ESP_NOW_ETH_ALEN) != 0)
+    {
+        rate_control.delivered(mac_addr, status == ESP_NOW_SEND_SUCCESS);
+    }
+
+    {
+        std::lock_guard lock{retry_mutex};
+
+        const auto mac = to_mac(mac_addr);
+        const auto pending = std::find_if(pending_sends.begin(), pending_sends.end(),
+                                          [&mac](const pending_send_t &send) { return send.mac_addr == mac; });
+        if (pending != pending_sends.end())
+        {
+            const auto retry_id = pending->retry_id;
+            pending_sends.erase(pending);
+
+            // any other unicast to the same peer leaves the retry alone
+            for (auto &retry : retries)
+            {
+                if (retry_id && retry.id == retry_id && retry.in_flight)
+                {
+                    retry.in_flight = false;
+                    retry.delivered = status == ESP_NOW_SEND_SUCCESS;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (send_status_handler)
+    {
+        send_status_handler(mac_addr, status == ESP_NOW_SEND_SUCCESS);
+    }
 }
 
 void init()
@@ -141,29 +277,90 @@ void init()
         return;
     }
 
+    if (power_save)
+    {
+        if (auto err = esp_now_set_wake_window(power_save_window_ms); err != ESP_OK)
+        {
+            ESP_LOGE(TAG, "esp_now_set_wake_window failed: %s", esp_err_to_name(err));
+        }
+
+        if (auto err = esp_wifi_connectionless_module_set_wake_interval(power_save_interval_ms); err != ESP_OK)
+        {
+            ESP_LOGE(TAG, "esp_wifi_connectionless_module_set_wake_interval failed: %s", esp_err_to_name(err));
+        }
+
+        radio_awake_state = false;
+    }
+
     // add BROADCAST peer
     addPeer(broadcast_address);
 }
 
-void addPeer(const uint8_t* peer_addr)
+bool addPeer(const uint8_t* peer_addr)
 {
+    // already there for an acknowledge, stays now
+    if (release_temporary_peer(peer_addr))
+    {
+        return true;
+    }
+
     esp_now_peer_info_t peer_info;
     std::memset(&peer_info, 0, sizeof(esp_now_peer_info_t));
     std::memcpy(peer_info.peer_addr, peer_addr, ESP_NOW_ETH_ALEN);
     peer_info.channel = 0;
 
-    peer_info.ifidx = WIFI_IF_AP;
+    peer_info.ifidx = wifi_interface();
 
     if (auto err = esp_now_add_peer(&peer_info); err != ESP_OK)
     {
         ESP_LOGE(TAG, "esp_now_add_peer failed: %s", esp_err_to_name(err));
-        return;
+        return false;
     }
 
     ESP_LOGI(TAG, "peer added");
+    return true;
 }
 
-bool send(const uint8_t* peer_addr, std::string_view msg)
+bool removePeer(const uint8_t* peer_addr)
+{
+    release_temporary_peer(peer_addr);
+
+    if (auto err = esp_now_del_peer(peer_addr); err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "esp_now_del_peer failed: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    ESP_LOGI(TAG, "peer removed");
+    return true;
+}
+
+bool send_loopback(const uint8_t* peer_addr, std::string_view msg)
+{
+    // like on air, a lost message still counts as sent
+    if (esp_random() < loopback_loss_threshold)
+    {
+        loopback_counters.lost++;
+        onSend(peer_addr, ESP_NOW_SEND_FAIL);
+        return true;
+    }
+
+    uint8_t src_addr[ESP_NOW_ETH_ALEN];
+    std::memcpy(src_addr, peer_addr, ESP_NOW_ETH_ALEN);
+
+    esp_now_recv_info_t info{};
+    info.src_addr = src_addr;
+    info.des_addr = src_addr;
+
+    onRecv(&info, reinterpret_cast<const uint8_t *>(msg.data()), msg.size());
+    onSend(peer_addr, ESP_NOW_SEND_SUCCESS);
+
+    loopback_counters.delivered++;
+    return true;
+}
+
+// send() for a retry, onSend() settles the retry with this attempt's status only
+bool send_tagged(const uint8_t* peer_addr, std::string_view msg, uint32_t retry_id)
 {
     if (msg.size() > ESP_NOW_MAX_DATA_LEN)
     {
@@ -171,9 +368,35 @@ bool send(const uint8_t* peer_addr, std::string_view msg)
         return false;
     }
 
+    // queued before sending, the status can arrive before esp_now_send() returns
+    {
+        std::lock_guard lock{retry_mutex};
+        if (pending_sends.size() == MAX_PENDING_SENDS)
+        {
+            pending_sends.pop_front();
+        }
+        pending_sends.push_back(pending_send_t{.mac_addr = to_mac(peer_addr), .retry_id = retry_id});
+    }
+
+    if (loopback_enabled)
+    {
+        return send_loopback(peer_addr, msg);
+    }
+
     if (auto err = esp_now_send(peer_addr, reinterpret_cast<const uint8_t *>(msg.data()), msg.size()); err != ESP_OK)
     {
         ESP_LOGE(TAG, "esp_now_send failed: %s (%.*s) to %02x:%02x:%02x:%02x:%02x:%02x", esp_err_to_name(err), msg.size(), msg.data(), peer_addr[0], peer_addr[1], peer_addr[2], peer_addr[3], peer_addr[4], peer_addr[5]);
+
+        // no status will come for it
+        std::lock_guard lock{retry_mutex};
+        const auto mac = to_mac(peer_addr);
+        const auto pending = std::find_if(pending_sends.rbegin(), pending_sends.rend(), [&](const pending_send_t &send) {
+            return send.mac_addr == mac && send.retry_id == retry_id;
+        });
+        if (pending != pending_sends.rend())
+        {
+            pending_sends.erase(std::next(pending).base());
+        }
         return false;
     }
 
@@ -182,10 +405,203 @@ bool send(const uint8_t* peer_addr, std::string_view msg)
     return true;
 }
 
+bool send(const uint8_t* peer_addr, std::string_view msg)
+{
+    return send_tagged(peer_addr, msg, 0);
+}
+
+// resends what the peer did not acknowledge yet, one attempt per peer in flight
+void handle_retries()
+{
+    const auto now_us = esp_timer_get_time();
+
+    std::vector<std::tuple<uint32_t, mac_t, std::string>> due;
+    std::vector<mac_t> unused_peers;
+
+    {
+        std::lock_guard lock{retry_mutex};
+
+        std::erase_if(retries, [now_us](const retry_t &retry) {
+            if (retry.delivered)
+            {
+                return true;
+            }
+            if (!retry.in_flight && now_us >= retry.deadline_us)
+            {
+                ESP_LOGW(TAG, "not acknowledged, giving up: %s", retry.msg.c_str());
+                return true;
+            }
+            return false;
+        });
+
+        // ESP-NOW has room for 20 peers, the ones only added for a retry go again with it
+        std::erase_if(temporary_peers, [&unused_peers](const mac_t &mac) {
+            const auto used = std::any_of(retries.begin(), retries.end(),
+                                          [&mac](const retry_t &retry) { return retry.mac_addr == mac; });
+            if (!used)
+            {
+                unused_peers.push_back(mac);
+            }
+            return !used;
+        });
+
+        for (auto &retry : retries)
+        {
+            const auto busy = std::any_of(retries.begin(), retries.end(), [&retry](const retry_t &other) {
+                return other.in_flight && other.mac_addr == retry.mac_addr;
+            });
+            if (busy || now_us < retry.next_attempt_us)
+            {
+                continue;
+            }
+
+            retry.in_flight = true;
+            retry.next_attempt_us = now_us + RETRY_INTERVAL_US;
+            due.emplace_back(retry.id, retry.mac_addr, retry.msg);
+        }
+    }
+
+    for (const auto &mac_addr : unused_peers)
+    {
+        removePeer(mac_addr.data());
+    }
+
+    // without the lock, loopback calls onSend() from within send()
+    for (const auto &[id, mac_addr, msg] : due)
+    {
+        if (send_tagged(mac_addr.data(), msg, id))
+        {
+            continue;
+        }
+
+        std::lock_guard lock{retry_mutex};
+        for (auto &retry : retries)
+        {
+            if (retry.id == id)
+            {
+                retry.in_flight = false;
+                break;
+            }
+        }
+    }
+}
+
+bool send_reliable(const uint8_t* peer_addr, std::string_view msg, std::chrono::milliseconds retry_for)
+{
+    if (msg.size() > ESP_NOW_MAX_DATA_LEN)
+    {
+        ESP_LOGE(TAG, "send_reliable failed: message too long (%d>%d)", msg.size(), ESP_NOW_MAX_DATA_LEN);
+        return false;
+    }
+
+    const bool temporary_peer = !esp_now_is_peer_exist(peer_addr);
+    if (temporary_peer && !addPeer(peer_addr))
+    {
+        return false;
+    }
+
+    const auto now_us = esp_timer_get_time();
+
+    {
+        std::lock_guard lock{retry_mutex};
+        if (temporary_peer)
+        {
+            temporary_peers.push_back(to_mac(peer_addr));
+        }
+
+        retries.emplace_back(retry_t{
+            .id = next_retry_id++,
+            .mac_addr = to_mac(peer_addr),
+            .msg = std::string{msg},
+            .deadline_us = now_us + std::chrono::duration_cast<std::chrono::microseconds>(retry_for).count(),
+            .next_attempt_us = now_us,
+            .in_flight = false,
+            .delivered = false,
+        });
+    }
+
+    // first attempt right away
+    handle_retries();
+
+    return true;
+}
+
+bool set_rate(wifi_phy_rate_t rate)
+{
+    if (auto err = esp_wifi_config_espnow_rate(wifi_interface(), rate); err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "esp_wifi_config_espnow_rate failed: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    return true;
+}
+
+// comma separated integers, false unless there are exactly N
+template<size_t N>
+bool parse_integers(std::string_view content, std::array<int64_t, N> &out)
+{
+    const char *pos = content.data();
+    const char *end = content.data() + content.size();
+
+    for (size_t i = 0; i < N; i++)
+    {
+        const auto [ptr, ec] = std::from_chars(pos, end, out[i]);
+        if (ec != std::errc{} || (i + 1 < N ? ptr == end || *ptr != ',' : ptr != end))
+        {
+            return false;
+        }
+        pos = ptr + 1;
+    }
+
+    return true;
+}
+
+// master side: "TSQ:<seq>,<t1>" -> "TSR:<seq>,<t1>,<t2>,<t3>"
+void on_time_request(const espnow_recv_param_t &msg)
+{
+    std::array<int64_t, 2> request;
+    if (!parse_integers(msg.content, request))
+    {
+        ESP_LOGW(TAG, "invalid time request: %s", msg.content.c_str());
+        return;
+    }
+
+    // answered by broadcast as well, nodes pick their own by sequence number and t1
+    send(broadcast_address, fmt::format("TSR:{},{},{},{}", request[0], request[1], msg.received_us, esp_timer_get_time()));
+}
+
+void on_time_response(const espnow_recv_param_t &msg)
+{
+    std::array<int64_t, 4> response;
+    if (!parse_integers(msg.content, response))
+    {
+        ESP_LOGW(TAG, "invalid time response: %s", msg.content.c_str());
+        return;
+    }
+
+    time_sync_state.response(static_cast<uint16_t>(response[0]), response[1], response[2], response[3], msg.received_us);
+}
+
 void handle()
 {
     using namespace std::chrono_literals;
 
+    if (const auto request = time_sync_state.poll(esp_timer_get_time()))
+    {
+        send(broadcast_address, fmt::format("TSQ:{},{}", request->seq, request->t1));
+    }
+
+    handle_retries();
+
+    if (adaptive_rate && !loopback_enabled)
+    {
+        if (const auto rate = rate_control.evaluate(esp_timer_get_time()); rate && set_rate(*rate))
+        {
+            ESP_LOGI(TAG, "phy rate %s", rate_control.current().name);
+        }
+    }
+
     if (message_queue.empty())
     {
         return;
@@ -194,7 +610,145 @@ void handle()
     auto msg = message_queue.front();
     message_queue.pop_front();
 
+    last_message_at = esp_timer_get_time();
+    rx_latency_stats.add(last_message_at - msg.received_us);
+
     ESP_LOGI(TAG, "handle message [%s]: %s", msg.type.c_str(), msg.content.c_str());
+
+    if (msg.type == "TSQ" && time_sync_state.role() == TimeSync::Role::Master)
+    {
+        on_time_request(msg);
+        return;
+    }
+
+    if (msg.type == "TSR" && time_sync_state.role() == TimeSync::Role::Node)
+    {
+        on_time_response(msg);
+        return;
+    }
+
+    for (const auto &[type, handler] : message_handlers)
+    {
+        if (type == msg.type)
+        {
+            handler(msg.mac_addr.data(), msg.content);
+        }
+    }
+}
+
+void set_loopback(bool enabled, float loss_rate)
+{
+    loopback_enabled = enabled;
+    loopback_loss_threshold = static_cast<uint32_t>(std::clamp<double>(loss_rate, 0., 1.) * UINT32_MAX);
+
+    ESP_LOGI(TAG, "loopback %s (loss rate %.2f)", enabled ? "enabled" : "disabled", loss_rate);
+}
+
+const loopback_stats_t &loopback_stats()
+{
+    return loopback_counters;
+}
+
+void enable_power_save(std::chrono::milliseconds wake_interval, std::chrono::milliseconds wake_window)
+{
+    power_save = true;
+    power_save_interval_ms = static_cast<uint16_t>(wake_interval.count());
+    power_save_window_ms = static_cast<uint16_t>(std::min(wake_window, wake_interval).count());
+
+    ESP_LOGI(TAG, "power save: %dms wake window every %dms", power_save_window_ms, power_save_interval_ms);
+}
+
+bool power_save_enabled()
+{
+    return power_save;
+}
+
+float radio_listen_ratio()
+{
+    return power_save_interval_ms ? float(power_save_window_ms) / power_save_interval_ms : 1.f;
+}
+
+void set_radio_awake(bool awake)
+{
+    if (!power_save || awake == radio_awake_state)
+    {
+        return;
+    }
+
+    if (auto err = esp_wifi_set_ps(awake ? WIFI_PS_NONE : WIFI_PS_MIN_MODEM); err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "esp_wifi_set_ps failed: %s", esp_err_to_name(err));
+        return;
+    }
+
+    radio_awake_state = awake;
+}
+
+bool radio_awake()
+{
+    return !power_save || radio_awake_state;
+}
+
+int64_t last_message_us()
+{
+    return last_message_at;
+}
+
+helpers::DurationStats &rx_latency()
+{
+    return rx_latency_stats;
+}
+
+void set_adaptive_rate(bool enabled, bool long_range)
+{
+    if (long_range)
+    {
+        // LR only decodes on receivers that enabled it as well
+        if (auto err = esp_wifi_set_protocol(wifi_interface(), WIFI_PROTOCOL_11B | WIFI_PROTOCOL_11G |
+                                                               WIFI_PROTOCOL_11N | WIFI_PROTOCOL_LR); err != ESP_OK)
+        {
+            ESP_LOGE(TAG, "esp_wifi_set_protocol failed: %s", esp_err_to_name(err));
+            long_range = false;
+        }
+    }
+
+    adaptive_rate = enabled;
+    rate_control.set_long_range_fallback(long_range);
+
+    if (!enabled)
+    {
+        // back to the ESP-NOW default every receiver can hear
+        rate_control.reset();
+    }
+
+    set_rate(rate_control.current().rate);
+
+    ESP_LOGI(TAG, "adaptive rate %s (long range %s)", enabled ? "enabled" : "disabled", long_range ? "on" : "off");
+}
+
+RateController &rate_controller()
+{
+    return rate_control;
+}
+
+TimeSync &time_sync()
+{
+    return time_sync_state;
+}
+
+int64_t airtime_us(size_t length)
+{
+    return airtime_us(rate_control.current(), length);
+}
+
+void on_send_status(send_status_handler_t handler)
+{
+    send_status_handler = std::move(handler);
+}
+
+void on_message(std::string_view type, message_handler_t handler)
+{
+    message_handlers.emplace_back(type, std::move(handler));
 }
 
 } // namespace espnow
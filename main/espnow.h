@@ -1,14 +1,24 @@
 #pragma once
 
 // system includes
+#include <array>
+#include <chrono>
 #include <cstdint>
+#include <functional>
 #include <string>
+#include <string_view>
 
 // esp-idf includes
 #include <esp_now.h>
 
+// local includes
+#include "helpers/durationstats.h"
+#include "timesync.h"
+
 namespace espnow {
 
+class RateController;
+
 constexpr const uint8_t broadcast_address[] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
 
 typedef enum
@@ -76,16 +86,84 @@ typedef struct
 {
     std::string content;
     std::string type;
+    std::array<uint8_t, ESP_NOW_ETH_ALEN> mac_addr;
+    int64_t received_us;
 } espnow_recv_param_t;
 
+typedef std::function<void(const uint8_t *mac_addr, std::string_view content)> message_handler_t;
+
+// runs on the Wi-Fi task
+typedef std::function<void(const uint8_t *mac_addr, bool success)> send_status_handler_t;
+
+typedef struct
+{
+    uint32_t delivered;
+    uint32_t lost;
+} loopback_stats_t;
+
 void wifi_init();
 
 void init();
 
 void handle();
 
-void addPeer(const uint8_t* peer_addr);
+bool addPeer(const uint8_t* peer_addr);
+
+bool removePeer(const uint8_t* peer_addr);
 
 bool send(const uint8_t* peer_addr, std::string_view msg);
 
+// unicast to a peer that might be power saving: handle() repeats msg every 10ms until the peer
+// acknowledges it or retry_for elapsed, pass at least the peer's wake interval. A peer that is
+// not added yet is added for the retry and removed again after it, unless addPeer() claims it.
+bool send_reliable(const uint8_t* peer_addr, std::string_view msg, std::chrono::milliseconds retry_for);
+
+// send() hands messages straight back to the own receive path instead of the radio,
+// dropping each with probability loss_rate. For running against the emulated BMS.
+void set_loopback(bool enabled, float loss_rate = 0.f);
+
+const loopback_stats_t &loopback_stats();
+
+// the radio only listens for wake_window out of every wake_interval unless kept awake. Nothing
+// buffers messages for a sleeping radio, whatever arrives outside the window is lost, so senders
+// have to repeat for a whole wake_interval, see send_reliable(). Runs Wi-Fi in station mode, call
+// before wifi_init().
+void enable_power_save(std::chrono::milliseconds wake_interval, std::chrono::milliseconds wake_window);
+
+bool power_save_enabled();
+
+// share of time the radio listens while power saving, 1 without power save
+float radio_listen_ratio();
+
+// keeps the radio listening while an exchange is in flight, no-op without power save
+void set_radio_awake(bool awake);
+
+// always true without power save, false from init() until set_radio_awake(true) with it
+bool radio_awake();
+
+// esp_timer time handle() dispatched the last received message
+int64_t last_message_us();
+
+// how long received messages waited for handle()
+helpers::DurationStats &rx_latency();
+
+// steers the PHY rate by unicast delivery and peer RSSI, see RateController. Broadcast-only
+// listeners give no feedback, only enable this when every receiver subscribes. long_range
+// allows falling back to LR mode, which receivers have to enable as well.
+// Disabling returns to 1 Mbps.
+void set_adaptive_rate(bool enabled, bool long_range = false);
+
+RateController &rate_controller();
+
+// clock of the master node, handle() runs the "TSQ"/"TSR" exchange for the configured role
+TimeSync &time_sync();
+
+// time on air of one ESP-NOW frame carrying length payload bytes at the current rate
+int64_t airtime_us(size_t length);
+
+void on_send_status(send_status_handler_t handler);
+
+// handle() passes every received "<type>:<content>" message to the handler registered for its type
+void on_message(std::string_view type, message_handler_t handler);
+
 } // namespace espnow
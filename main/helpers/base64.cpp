@@ -0,0 +1,98 @@
+#include "base64.h"
+
+// 3rdparty includes
+#include <fmt/format.h>
+
+namespace helpers {
+namespace {
+constexpr const char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+int8_t base64_value(char c)
+{
+    if (c >= 'A' && c <= 'Z')
+        return c - 'A';
+    if (c >= 'a' && c <= 'z')
+        return c - 'a' + 26;
+    if (c >= '0' && c <= '9')
+        return c - '0' + 52;
+    if (c == '+')
+        return 62;
+    if (c == '/')
+        return 63;
+    return -1;
+}
+} // namespace
+
+size_t base64_encode(std::span<const uint8_t> in, std::span<char> out)
+{
+    const auto size = base64_encoded_size(in.size());
+    if (size > out.size())
+    {
+        return 0;
+    }
+
+    size_t pos = 0;
+    for (size_t i = 0; i < in.size(); i += 3)
+    {
+        const uint32_t remaining = in.size() - i;
+        const uint32_t triple = (uint32_t(in[i]) << 16) |
+                                (remaining > 1 ? uint32_t(in[i + 1]) << 8 : 0) |
+                                (remaining > 2 ? uint32_t(in[i + 2]) : 0);
+
+        out[pos++] = ALPHABET[(triple >> 18) & 0x3F];
+        out[pos++] = ALPHABET[(triple >> 12) & 0x3F];
+        out[pos++] = remaining > 1 ? ALPHABET[(triple >> 6) & 0x3F] : '=';
+        out[pos++] = remaining > 2 ? ALPHABET[triple & 0x3F] : '=';
+    }
+
+    return pos;
+}
+
+std::expected<size_t, std::string> base64_decode(std::string_view in, std::span<uint8_t> out)
+{
+    if (in.size() % 4 != 0)
+    {
+        return std::unexpected(fmt::format("invalid base64 length {}", in.size()));
+    }
+
+    size_t pos = 0;
+    for (size_t i = 0; i < in.size(); i += 4)
+    {
+        uint32_t quad = 0;
+        uint8_t padding = 0;
+
+        for (size_t j = 0; j < 4; j++)
+        {
+            const char c = in[i + j];
+            if (c == '=' && i + 4 == in.size() && j >= 2)
+            {
+                padding++;
+                quad <<= 6;
+                continue;
+            }
+
+            const auto value = base64_value(c);
+            if (value < 0 || padding)
+            {
+                return std::unexpected(fmt::format("invalid base64 character at {}", i + j));
+            }
+
+            quad = (quad << 6) | value;
+        }
+
+        const size_t bytes = 3 - padding;
+        if (pos + bytes > out.size())
+        {
+            return std::unexpected(std::string{"base64 output buffer too small"});
+        }
+
+        out[pos++] = quad >> 16;
+        if (bytes > 1)
+            out[pos++] = quad >> 8;
+        if (bytes > 2)
+            out[pos++] = quad;
+    }
+
+    return pos;
+}
+} // namespace helpers
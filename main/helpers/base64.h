@@ -0,0 +1,18 @@
+#pragma once
+
+// system includes
+#include <cstdint>
+#include <expected>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace helpers {
+constexpr size_t base64_encoded_size(size_t size) { return (size + 2) / 3 * 4; }
+
+/// Standard alphabet with padding, returns the number of characters written or 0 if \p out is too small.
+size_t base64_encode(std::span<const uint8_t> in, std::span<char> out);
+
+/// Returns the number of bytes written to \p out.
+std::expected<size_t, std::string> base64_decode(std::string_view in, std::span<uint8_t> out);
+} // namespace helpers
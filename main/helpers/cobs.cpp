@@ -0,0 +1,37 @@
+#include "cobs.h"
+
+namespace helpers {
+
+size_t cobs_encode(std::span<const uint8_t> in, std::span<uint8_t> out)
+{
+    if (out.size() < cobs_encoded_size(in.size()))
+    {
+        return 0;
+    }
+
+    // every block starts with the distance to the next zero, or 0xFF for 254 data bytes without one
+    size_t code_pos = 0;
+    size_t pos = 1;
+    uint8_t code = 1;
+
+    for (const auto byte : in)
+    {
+        if (byte)
+        {
+            out[pos++] = byte;
+            code++;
+        }
+
+        if (!byte || code == 0xFF)
+        {
+            out[code_pos] = code;
+            code_pos = pos++;
+            code = 1;
+        }
+    }
+
+    out[code_pos] = code;
+    return pos;
+}
+
+} // namespace helpers
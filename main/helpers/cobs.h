@@ -0,0 +1,15 @@
+#pragma once
+
+// system includes
+#include <cstdint>
+#include <span>
+
+namespace helpers {
+// one overhead byte per started 254 bytes
+constexpr size_t cobs_encoded_size(size_t size) { return size + size / 254 + 1; }
+
+/// Consistent overhead byte stuffing, the output contains no 0x00 so that byte can
+/// delimit frames. Does not write the delimiter, returns the number of bytes written
+/// or 0 if \p out is too small.
+size_t cobs_encode(std::span<const uint8_t> in, std::span<uint8_t> out);
+} // namespace helpers
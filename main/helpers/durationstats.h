@@ -0,0 +1,49 @@
+#pragma once
+
+// system includes
+#include <cstdint>
+#include <limits>
+
+namespace helpers {
+
+/// Running min / max / average over microsecond samples, O(1) per sample.
+struct DurationStats
+{
+    uint32_t count{};
+    int64_t sum_us{};
+    int64_t min_us{std::numeric_limits<int64_t>::max()};
+    int64_t max_us{};
+
+    void add(int64_t us)
+    {
+        count++;
+        sum_us += us;
+
+        if (us < min_us)
+        {
+            min_us = us;
+        }
+
+        if (us > max_us)
+        {
+            max_us = us;
+        }
+    }
+
+    [[nodiscard]] int64_t avg_us() const
+    {
+        return count ? sum_us / count : 0;
+    }
+
+    [[nodiscard]] int64_t min_or_zero_us() const
+    {
+        return count ? min_us : 0;
+    }
+
+    void reset()
+    {
+        *this = DurationStats{};
+    }
+};
+
+} // namespace helpers
@@ -0,0 +1,42 @@
+#include "formatduration.h"
+
+// system includes
+#include <charconv>
+
+namespace helpers {
+
+FormattedDuration::FormattedDuration(uint32_t seconds)
+{
+    const uint32_t years = seconds / (24 * 3600 * 365);
+    seconds = seconds % (24 * 3600 * 365);
+    const uint32_t days = seconds / (24 * 3600);
+    seconds = seconds % (24 * 3600);
+    const uint32_t hours = seconds / 3600;
+
+    if (years)
+        append(years, 'y', true);
+    if (days)
+        append(days, 'd', true);
+    if (hours)
+        append(hours, 'h', false);
+}
+
+void FormattedDuration::append(uint32_t value, char unit, bool space)
+{
+    // leave room for unit, space and terminator
+    auto *begin = m_buffer.data() + m_size;
+    auto *end = m_buffer.data() + m_buffer.size() - 3;
+
+    if (const auto [ptr, ec] = std::to_chars(begin, end, value); ec == std::errc{})
+    {
+        m_size = ptr - m_buffer.data();
+        m_buffer[m_size++] = unit;
+        if (space)
+        {
+            m_buffer[m_size++] = ' ';
+        }
+        m_buffer[m_size] = '\0';
+    }
+}
+
+} // namespace helpers
@@ -0,0 +1,30 @@
+#pragma once
+
+// system includes
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace helpers {
+
+/// Formats seconds as "1y 12d 5h" into an inline buffer, nothing is allocated.
+class FormattedDuration
+{
+public:
+    explicit FormattedDuration(uint32_t seconds);
+
+    [[nodiscard]] std::string_view view() const
+    { return {m_buffer.data(), m_size}; }
+
+    [[nodiscard]] const char *c_str() const
+    { return m_buffer.data(); }
+
+private:
+    void append(uint32_t value, char unit, bool space);
+
+    // "136y 364d 23h" is the longest uint32_t can get
+    std::array<char, 16> m_buffer{};
+    uint8_t m_size = 0;
+};
+
+} // namespace helpers
@@ -0,0 +1,51 @@
+#include "histogram.h"
+
+// 3rdparty includes
+#include <fmt/core.h>
+
+namespace helpers {
+
+namespace {
+
+std::string format_bound(int64_t us)
+{
+    if (us >= 1'000'000 && us % 1'000'000 == 0)
+    {
+        return fmt::format("{}s", us / 1'000'000);
+    }
+    return fmt::format("{}ms", us / 1000);
+}
+
+} // namespace
+
+void Histogram::add(int64_t us)
+{
+    stats.add(us);
+
+    size_t bucket = 0;
+    for (auto bound = m_first_bound_us; bucket < BUCKETS - 1 && us >= bound; bound *= 2)
+    {
+        bucket++;
+    }
+    counts[bucket]++;
+}
+
+std::string Histogram::to_string() const
+{
+    if (!stats.count)
+    {
+        return "-";
+    }
+
+    std::string result;
+    auto bound = m_first_bound_us;
+    for (size_t i = 0; i < BUCKETS - 1; i++, bound *= 2)
+    {
+        result += fmt::format("<{}:{} ", format_bound(bound), counts[i]);
+    }
+    result += fmt::format(">={}:{} (min/avg/max {}/{}/{}ms)", format_bound(bound / 2), counts[BUCKETS - 1],
+                          stats.min_or_zero_us() / 1000, stats.avg_us() / 1000, stats.max_us / 1000);
+    return result;
+}
+
+} // namespace helpers
@@ -0,0 +1,42 @@
+#pragma once
+
+// system includes
+#include <array>
+#include <cstdint>
+#include <string>
+
+// local includes
+#include "durationstats.h"
+
+namespace helpers {
+
+/// Counts microsecond samples into buckets doubling from first_bound_us, the
+/// first takes everything below it and the last everything beyond the others.
+class Histogram
+{
+public:
+    constexpr static const size_t BUCKETS = 10;
+
+    explicit Histogram(int64_t first_bound_us) :
+            m_first_bound_us{first_bound_us}
+    {}
+
+    void add(int64_t us);
+
+    /// "<250ms:0 <500ms:3 ... >=64s:0 (min/avg/max 310/420/612ms)", "-" while empty
+    [[nodiscard]] std::string to_string() const;
+
+    void reset()
+    {
+        counts = {};
+        stats.reset();
+    }
+
+    std::array<uint32_t, BUCKETS> counts{};
+    DurationStats stats;
+
+private:
+    int64_t m_first_bound_us;
+};
+
+} // namespace helpers
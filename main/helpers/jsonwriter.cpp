@@ -0,0 +1,138 @@
+#include "jsonwriter.h"
+
+// system includes
+#include <cstdlib>
+#include <cstring>
+
+namespace helpers {
+
+static char hex_digit(uint8_t v) { return v >= 10 ? 'a' + (v - 10) : '0' + v; }
+
+void JsonWriter::raw(std::string_view str)
+{
+    if (m_overflowed || str.size() > m_buffer.size() - m_size)
+    {
+        m_overflowed = true;
+        return;
+    }
+
+    std::memcpy(m_buffer.data() + m_size, str.data(), str.size());
+    m_size += str.size();
+}
+
+void JsonWriter::put(char c)
+{
+    if (m_overflowed || m_size == m_buffer.size())
+    {
+        m_overflowed = true;
+        return;
+    }
+
+    m_buffer[m_size++] = c;
+}
+
+void JsonWriter::separator()
+{
+    if (m_need_separator)
+    {
+        put(',');
+    }
+
+    m_need_separator = true;
+}
+
+void JsonWriter::write_key(std::string_view key)
+{
+    separator();
+    string_(key);
+    put(':');
+}
+
+void JsonWriter::begin_object()
+{
+    put('{');
+    m_need_separator = false;
+}
+
+void JsonWriter::end_object()
+{
+    put('}');
+    m_need_separator = true;
+}
+
+void JsonWriter::begin_array(std::string_view key)
+{
+    write_key(key);
+    put('[');
+    m_need_separator = false;
+}
+
+void JsonWriter::end_array()
+{
+    put(']');
+    m_need_separator = true;
+}
+
+void JsonWriter::add_milli(int32_t thousandths)
+{
+    separator();
+
+    if (thousandths < 0)
+    {
+        put('-');
+    }
+
+    const auto magnitude = static_cast<uint32_t>(std::abs(int64_t{thousandths}));
+    value_(magnitude / 1000);
+    put('.');
+
+    const auto fraction = magnitude % 1000;
+    put('0' + fraction / 100);
+    put('0' + fraction / 10 % 10);
+    put('0' + fraction % 10);
+}
+
+void JsonWriter::value_(const char *str)
+{
+    if (!str)
+    {
+        raw("null");
+        return;
+    }
+
+    // same as ArduinoJson with c_str(): stop at the first NUL
+    string_(std::string_view{str, std::strlen(str)});
+}
+
+void JsonWriter::string_(std::string_view str)
+{
+    put('"');
+
+    for (const char c : str)
+    {
+        switch (c)
+        {
+        case '"':
+            raw("\\\"");
+            break;
+        case '\\':
+            raw("\\\\");
+            break;
+        default:
+            if (static_cast<uint8_t>(c) < 0x20)
+            {
+                raw("\\u00");
+                put(hex_digit(static_cast<uint8_t>(c) >> 4));
+                put(hex_digit(static_cast<uint8_t>(c) & 0x0F));
+            }
+            else
+            {
+                put(c);
+            }
+        }
+    }
+
+    put('"');
+}
+
+} // namespace helpers
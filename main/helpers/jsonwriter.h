@@ -0,0 +1,110 @@
+#pragma once
+
+// system includes
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <type_traits>
+
+namespace helpers {
+
+/// Streams compact JSON straight into a fixed caller-provided buffer, without
+/// building a document first. Once the buffer is full every further write is
+/// dropped and overflowed() stays true, the output must then be discarded.
+class JsonWriter
+{
+public:
+    explicit JsonWriter(std::span<char> buffer)
+        : m_buffer{buffer}
+    {}
+
+    void raw(std::string_view str);
+
+    void begin_object();
+    void end_object();
+
+    void begin_array(std::string_view key);
+    void end_array();
+
+    template<typename T>
+    void field(std::string_view key, T value)
+    {
+        write_key(key);
+        value_(value);
+    }
+
+    template<typename T>
+    void add(T value)
+    {
+        separator();
+        value_(value);
+    }
+
+    /// an array element of \p thousandths / 1000 with three decimals, cheaper than a float
+    void add_milli(int32_t thousandths);
+
+    [[nodiscard]] bool overflowed() const
+    { return m_overflowed; }
+
+    [[nodiscard]] size_t size() const
+    { return m_size; }
+
+    [[nodiscard]] size_t capacity() const
+    { return m_buffer.size(); }
+
+    [[nodiscard]] std::string_view view() const
+    { return {m_buffer.data(), m_size}; }
+
+private:
+    void separator();
+    void write_key(std::string_view key);
+    void put(char c);
+    void string_(std::string_view str);
+
+    void value_(const char *str);
+    void value_(std::string_view str)
+    { string_(str); }
+
+    template<typename T> requires std::is_arithmetic_v<T>
+    void value_(T value)
+    {
+        if constexpr (std::is_floating_point_v<T>)
+        {
+            if (!std::isfinite(value))
+            {
+                raw("null");
+                return;
+            }
+        }
+
+        if (m_overflowed)
+        {
+            return;
+        }
+
+        auto *begin = m_buffer.data() + m_size;
+        auto *end = m_buffer.data() + m_buffer.size();
+
+        if (const auto [ptr, ec] = std::to_chars(begin, end, value); ec == std::errc{})
+        {
+            m_size = ptr - m_buffer.data();
+        }
+        else
+        {
+            m_overflowed = true;
+        }
+    }
+
+    template<typename T> requires std::is_enum_v<T>
+    void value_(T value)
+    { value_(static_cast<std::underlying_type_t<T>>(value)); }
+
+    std::span<char> m_buffer;
+    size_t m_size = 0;
+    bool m_overflowed = false;
+    bool m_need_separator = false;
+};
+
+} // namespace helpers
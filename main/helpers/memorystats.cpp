@@ -0,0 +1,78 @@
+#include "memorystats.h"
+
+// esp-idf includes
+#include <esp_heap_caps.h>
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <sdkconfig.h>
+
+namespace helpers {
+
+namespace {
+struct MonitoredTask
+{
+    const char *name;
+    uint32_t size;
+};
+
+constexpr const MonitoredTask MONITORED_TASKS[] = {
+        {"main", CONFIG_ESP_MAIN_TASK_STACK_SIZE},
+        {"nimble_host", CONFIG_BT_NIMBLE_HOST_TASK_STACK_SIZE},
+        // stack size is internal to the Wi-Fi driver
+        {"wifi", 0},
+};
+} // namespace
+
+std::optional<TaskStackUsage> task_stack_usage(const char *name, uint32_t size)
+{
+    const auto handle = xTaskGetHandle(name);
+    if (!handle)
+    {
+        return std::nullopt;
+    }
+
+    // ESP-IDF counts stack in bytes, not words
+    return TaskStackUsage{
+        .name = name,
+        .size = size,
+        .min_free = static_cast<uint32_t>(uxTaskGetStackHighWaterMark(handle)),
+    };
+}
+
+HeapUsage heap_usage()
+{
+    return HeapUsage{
+        .free = heap_caps_get_free_size(MALLOC_CAP_8BIT),
+        .minimum_free = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT),
+        .largest_free_block = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT),
+    };
+}
+
+void log_memory_stats(const char *tag)
+{
+    const auto heap = heap_usage();
+    ESP_LOGI(tag, "Heap: free=%d min_free=%d largest_block=%d", heap.free, heap.minimum_free,
+             heap.largest_free_block);
+
+    for (const auto &task : MONITORED_TASKS)
+    {
+        const auto usage = task_stack_usage(task.name, task.size);
+        if (!usage)
+        {
+            continue;
+        }
+
+        if (usage->size)
+        {
+            ESP_LOGI(tag, "Stack %-12s min_free=%ld of %ld (peak %ld%%)", usage->name, usage->min_free, usage->size,
+                     (usage->size - usage->min_free) * 100 / usage->size);
+        }
+        else
+        {
+            ESP_LOGI(tag, "Stack %-12s min_free=%ld", usage->name, usage->min_free);
+        }
+    }
+}
+
+} // namespace helpers
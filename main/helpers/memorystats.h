@@ -0,0 +1,34 @@
+#pragma once
+
+// system includes
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace helpers {
+
+struct TaskStackUsage
+{
+    const char *name;
+    // configured stack size in bytes, 0 if not known at build time
+    uint32_t size;
+    // high water mark: the least free stack the task ever had, in bytes
+    uint32_t min_free;
+};
+
+struct HeapUsage
+{
+    size_t free;
+    size_t minimum_free;
+    size_t largest_free_block;
+};
+
+/// std::nullopt if no task with that name is running (yet)
+std::optional<TaskStackUsage> task_stack_usage(const char *name, uint32_t size);
+
+HeapUsage heap_usage();
+
+/// Logs heap usage and the stack high water marks of the main, NimBLE host and Wi-Fi (ESP-NOW callback) tasks
+void log_memory_stats(const char *tag);
+
+} // namespace helpers
@@ -1,27 +1,155 @@
 #include <esp_log.h>
+#include <esp_now.h>
+#include <esp_timer.h>
+
+// 3rdparty includes
+#include <espchrono.h>
+#include <fmt/core.h>
 
 // local includes
 #include "antbms/antbms.h"
+#include "antbms/dutycycle.h"
+#include "antbms/gatewaystore.h"
+#include "antbms/serializationbench.h"
+#include "antbms/uartexport.h"
 #include "espnow.h"
 
+using namespace std::chrono_literals;
+
+namespace {
+// radio wake interval of power saving nodes, anything sent to them is repeated for that long
+constexpr const auto NODE_WAKE_INTERVAL = 200ms;
+} // namespace
+
 extern "C" void app_main()
 {
     esp_log_level_set("*", ESP_LOG_DEBUG);
 
-    antbms::AntBms antbms;
+    // several KB of tables and buffers, more than the 3584 byte main task stack holds
+    static antbms::AntBms antbms;
+
+#ifdef ANTBMS_EMULATOR
+    // no hardware needed: virtual BMS on one end, ESP-NOW looped back on the other
+    antbms.enable_emulator({});
+    espnow::set_loopback(true);
+#endif
+
+#ifdef NODE_POWER_SAVE
+    // battery powered node: one poll a second, the radio listens 10ms out of every 200ms and the
+    // loop sleeps until the next poll or slot. Senders repeat commands for a whole wake interval.
+    espnow::enable_power_save(NODE_WAKE_INTERVAL, 10ms);
+    antbms.set_interval(1s);
+    antbms.set_telemetry_period("fast", 1s);
+
+    antbms::DutyCycle duty_cycle;
+    duty_cycle.set_latency_budget(200ms);
+    duty_cycle.enable_light_sleep();
+    auto last_duty_cycle_log = espchrono::millis_clock::now();
+#endif
+
+#ifdef SERIALIZATION_BENCHMARK
+    // every wire format over the same 200 decoded status frames, from the BMS or the emulator
+    antbms::SampleRecorder recorder{200};
+    antbms.on_sample([&recorder](const antbms::AntBmsData &data, int64_t received_us) {
+        recorder.add(data, received_us);
+    });
+    bool benchmark_done = false;
+#endif
 
     espnow::wifi_init();
 
     espnow::init();
 
+#ifdef ESPNOW_GATEWAY
+    // receiver for several nodes: the latest state of every pack we hear,
+    // static to keep it off the main task stack
+    static antbms::GatewayStore gateway;
+    for (const auto type : {"BMS", "BAT"})
+    {
+        espnow::on_message(type, [type](const uint8_t *mac_addr, std::string_view content) {
+            gateway.ingest(mac_addr, type, content, esp_timer_get_time());
+        });
+    }
+
+    // acknowledge alarms, repeated so a power saving node gets it in one of its wake windows
+    espnow::on_message("ALM", [](const uint8_t *mac_addr, std::string_view content) {
+        const auto seq = antbms::AlarmEngine::parse_seq(content);
+        if (!seq)
+        {
+            ESP_LOGW("gateway", "Invalid alarm: %.*s", content.size(), content.data());
+            return;
+        }
+
+        // adds the node as a peer only until the acknowledge is through
+        if (!espnow::send_reliable(mac_addr, fmt::format("ACK:{}", *seq), 2 * NODE_WAKE_INTERVAL))
+        {
+            ESP_LOGW("gateway", "Cannot acknowledge alarm %u", unsigned{*seq});
+        }
+    });
+
+    auto last_gateway_log = espchrono::millis_clock::now();
+
+#ifdef GATEWAY_UART_EXPORT
+    // binary stream for a host, read it with tools/export-reader. Static, the batch buffer
+    // alone takes 2.4 KB
+    static antbms::UartExport uart_export{gateway};
+    uart_export.start({});
+#endif
+#endif
+
+#ifdef ESPNOW_TIME_MASTER
+    // every other node takes its clock from this one
+    espnow::time_sync().set_role(espnow::TimeSync::Role::Master);
+#else
+    espnow::time_sync().set_role(espnow::TimeSync::Role::Node);
+#endif
+
+#ifdef ESPNOW_ADAPTIVE_RATE
+    // only when every receiver subscribes, broadcast listeners are not asked
+    espnow::set_adaptive_rate(true);
+#endif
+
     while (true)
     {
         antbms.update();
 
         espnow::handle();
 
+#ifdef ESPNOW_GATEWAY
+        if (espchrono::ago(last_gateway_log) > 30s)
+        {
+            last_gateway_log = espchrono::millis_clock::now();
+            gateway.log("gateway");
+#ifdef GATEWAY_UART_EXPORT
+            uart_export.log("gateway");
+#endif
+        }
+#endif
+
+#ifdef SERIALIZATION_BENCHMARK
+        if (!benchmark_done && recorder.complete())
+        {
+            benchmark_done = true;
+            const auto results = antbms::run_serialization_benchmark(recorder.samples(), 5);
+            antbms::log_serialization_results("bench", results);
+        }
+#endif
+
+#ifdef NODE_POWER_SAVE
+        if (espchrono::ago(last_duty_cycle_log) > 30s)
+        {
+            last_duty_cycle_log = espchrono::millis_clock::now();
+            duty_cycle.log("power");
+        }
+#endif
+
         vPortYield();
 
-        vTaskDelay(50/portTICK_PERIOD_MS); // 50ms
+#ifdef NODE_POWER_SAVE
+        duty_cycle.sleep(antbms.next_wakeup(), antbms.busy());
+#else
+        // sleeps at most 50ms, a completed status frame wakes us up early
+        ulTaskNotifyTake(pdTRUE, 50/portTICK_PERIOD_MS);
+#endif
     }
 }
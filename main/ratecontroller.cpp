@@ -0,0 +1,256 @@
+#include "ratecontroller.h"
+
+// system includes
+#include <algorithm>
+#include <cstring>
+
+// esp-idf includes
+#include <esp_timer.h>
+
+namespace espnow {
+
+namespace {
+
+// slowest first, evaluate() steps through it one rate at a time
+constexpr const std::array<PhyRate, RateController::RATE_COUNT> RATES{{
+    {WIFI_PHY_RATE_LORA_250K, "LR 250K", 0.25f, false, -102},
+    {WIFI_PHY_RATE_1M_L, "1M", 1.f, false, -98},
+    {WIFI_PHY_RATE_2M_L, "2M", 2.f, false, -95},
+    {WIFI_PHY_RATE_6M, "6M", 6.f, true, -93},
+    {WIFI_PHY_RATE_12M, "12M", 12.f, true, -90},
+    {WIFI_PHY_RATE_24M, "24M", 24.f, true, -86},
+    {WIFI_PHY_RATE_36M, "36M", 36.f, true, -82},
+    {WIFI_PHY_RATE_54M, "54M", 54.f, true, -75},
+}};
+
+constexpr const uint32_t PROBE_AFTER_MIN = 3;
+constexpr const uint32_t PROBE_AFTER_MAX = 60;
+constexpr const int64_t PEER_TIMEOUT_US = 30'000'000;
+
+} // namespace
+
+int64_t airtime_us(const PhyRate &rate, size_t length)
+{
+    // MAC header, vendor action frame header and FCS
+    constexpr const size_t FRAME_OVERHEAD = 43;
+
+    const auto bits = (FRAME_OVERHEAD + length) * 8;
+
+    if (rate.ofdm)
+    {
+        // 20us preamble and SIGNAL, 4us symbols carrying SERVICE, data and tail, 6us signal extension
+        const auto bits_per_symbol = static_cast<size_t>(rate.mbps * 4);
+        const auto symbols = (16 + bits + 6 + bits_per_symbol - 1) / bits_per_symbol;
+        return 20 + symbols * 4 + 6;
+    }
+
+    // DSSS with long preamble, LR framing is not documented and treated the same
+    return 192 + static_cast<int64_t>(bits / rate.mbps);
+}
+
+std::span<const PhyRate, RateController::RATE_COUNT> RateController::rates()
+{
+    return RATES;
+}
+
+// long range is off until set_long_range_fallback(), 1M is the slowest regular rate
+RateController::RateController() : m_index{1}, m_probe_after{PROBE_AFTER_MIN}
+{}
+
+void RateController::set_long_range_fallback(bool enabled)
+{
+    std::lock_guard lock{m_mutex};
+
+    m_long_range = enabled;
+    m_index = std::max(m_index, lowest_index());
+}
+
+void RateController::reset()
+{
+    std::lock_guard lock{m_mutex};
+
+    m_index = 1;
+    m_probing = false;
+    m_good_windows = 0;
+    m_probe_after = PROBE_AFTER_MIN;
+}
+
+void RateController::delivered(const uint8_t *mac, bool success)
+{
+    std::lock_guard lock{m_mutex};
+
+    auto &p = peer(mac);
+    p.sent++;
+    p.delivered += success;
+
+    m_stats[m_index].sent++;
+    m_stats[m_index].delivered += success;
+}
+
+void RateController::rssi(const uint8_t *mac, int8_t rssi)
+{
+    std::lock_guard lock{m_mutex};
+
+    // only peers we unicast to, gateways and other nodes on the channel must not evict them
+    if (const auto p = find_peer(mac))
+    {
+        p->rssi = rssi;
+        p->last_seen_us = esp_timer_get_time();
+    }
+}
+
+std::optional<wifi_phy_rate_t> RateController::evaluate(int64_t now_us)
+{
+    if (now_us - m_window_start_us < WINDOW_US)
+    {
+        return std::nullopt;
+    }
+
+    m_window_start_us = now_us;
+
+    std::lock_guard lock{m_mutex};
+
+    std::optional<float> worst;
+    for (size_t i = 0; i < m_peer_count;)
+    {
+        auto &p = m_peers[i];
+
+        if (p.sent >= MIN_SAMPLES)
+        {
+            const auto ratio = float(p.delivered) / p.sent;
+            worst = std::min(worst.value_or(ratio), ratio);
+        }
+
+        p.sent = 0;
+        p.delivered = 0;
+
+        if (now_us - p.last_seen_us > PEER_TIMEOUT_US)
+        {
+            p = m_peers[--m_peer_count];
+            continue;
+        }
+
+        i++;
+    }
+
+    const auto previous = m_index;
+
+    if (worst && *worst < m_target)
+    {
+        if (m_probing)
+        {
+            m_probe_after = std::min(m_probe_after * 2, PROBE_AFTER_MAX);
+        }
+
+        m_index = std::max(m_index, lowest_index() + 1) - 1;
+        m_good_windows = 0;
+        m_probing = false;
+    }
+    else if (worst)
+    {
+        if (m_probing)
+        {
+            m_probe_after = PROBE_AFTER_MIN;
+            m_probing = false;
+        }
+
+        if (++m_good_windows >= m_probe_after && m_index + 1 < RATE_COUNT)
+        {
+            m_index++;
+            m_good_windows = 0;
+            m_probing = true;
+        }
+    }
+
+    // no peer should have to listen below its sensitivity, whatever the statistics say
+    if (const auto cap = rssi_cap(); m_index > cap)
+    {
+        m_index = cap;
+        m_probing = false;
+    }
+
+    if (m_index == previous)
+    {
+        return std::nullopt;
+    }
+
+    return RATES[m_index].rate;
+}
+
+std::array<RateController::RateStats, RateController::RATE_COUNT> RateController::stats() const
+{
+    std::lock_guard lock{m_mutex};
+
+    return m_stats;
+}
+
+void RateController::reset_stats()
+{
+    std::lock_guard lock{m_mutex};
+
+    m_stats = {};
+}
+
+RateController::Peer *RateController::find_peer(const uint8_t *mac)
+{
+    const auto end = m_peers.begin() + m_peer_count;
+    const auto it = std::find_if(m_peers.begin(), end, [mac](const Peer &p) {
+        return std::memcmp(p.mac.data(), mac, ESP_NOW_ETH_ALEN) == 0;
+    });
+
+    return it == end ? nullptr : &*it;
+}
+
+RateController::Peer &RateController::peer(const uint8_t *mac)
+{
+    const auto now_us = esp_timer_get_time();
+
+    auto p = find_peer(mac);
+    if (!p)
+    {
+        // table full, the least recently seen peer makes room
+        if (m_peer_count == m_peers.size())
+        {
+            p = &*std::min_element(m_peers.begin(), m_peers.end(), [](const Peer &a, const Peer &b) {
+                return a.last_seen_us < b.last_seen_us;
+            });
+        }
+        else
+        {
+            p = &m_peers[m_peer_count++];
+        }
+
+        *p = Peer{};
+        std::memcpy(p->mac.data(), mac, ESP_NOW_ETH_ALEN);
+    }
+
+    p->last_seen_us = now_us;
+    return *p;
+}
+
+size_t RateController::rssi_cap() const
+{
+    std::optional<int8_t> weakest;
+    for (size_t i = 0; i < m_peer_count; i++)
+    {
+        if (const auto rssi = m_peers[i].rssi)
+        {
+            weakest = std::min(weakest.value_or(*rssi), *rssi);
+        }
+    }
+
+    if (!weakest)
+    {
+        return RATE_COUNT - 1;
+    }
+
+    size_t cap = lowest_index();
+    while (cap + 1 < RATE_COUNT && RATES[cap + 1].sensitivity_dbm + RSSI_MARGIN_DB <= *weakest)
+    {
+        cap++;
+    }
+
+    return cap;
+}
+
+} // namespace espnow
@@ -0,0 +1,118 @@
+#pragma once
+
+// system includes
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <span>
+
+// esp-idf includes
+#include <esp_now.h>
+#include <esp_wifi.h>
+
+namespace espnow {
+
+struct PhyRate
+{
+    wifi_phy_rate_t rate;
+    const char *name;
+    float mbps;
+    bool ofdm;
+    // receiver sensitivity from the ESP32 datasheet
+    int8_t sensitivity_dbm;
+};
+
+// time on air of one ESP-NOW frame carrying length payload bytes
+int64_t airtime_us(const PhyRate &rate, size_t length);
+
+/// Picks the fastest PHY rate that keeps unicast delivery at or above target
+/// for the worst peer. A window below target steps down right away, a run of
+/// good windows probes one step up, and every failed probe doubles the number
+/// of good windows needed before the next one. The weakest peer's RSSI caps
+/// the rate, long range mode is the last step if enabled. Only peers that get
+/// unicast frames count, RSSI from anyone else on the channel is ignored.
+///
+/// ESP-IDF 5.2 only has one ESP-NOW rate per interface, all peers share it.
+///
+/// delivered() and rssi() run on the Wi-Fi task, everything else on the main loop.
+class RateController
+{
+public:
+    // LORA_250K, 1M, 2M, 6M, 12M, 24M, 36M, 54M
+    constexpr static const size_t RATE_COUNT = 8;
+    constexpr static const size_t MAX_PEERS = 8;
+    // windows with fewer unicast frames per peer do not count
+    constexpr static const uint32_t MIN_SAMPLES = 5;
+    constexpr static const int64_t WINDOW_US = 1'000'000;
+    constexpr static const int8_t RSSI_MARGIN_DB = 10;
+
+    struct RateStats
+    {
+        uint32_t sent{};
+        uint32_t delivered{};
+
+        [[nodiscard]] float delivery_ratio() const
+        { return sent ? float(delivered) / sent : 0.f; }
+    };
+
+    static std::span<const PhyRate, RATE_COUNT> rates();
+
+    RateController();
+
+    void set_target(float delivery_ratio)
+    { m_target = delivery_ratio; }
+
+    void set_long_range_fallback(bool enabled);
+
+    void delivered(const uint8_t *mac, bool success);
+
+    void rssi(const uint8_t *mac, int8_t rssi);
+
+    /// back to the slowest regular rate, probing starts over
+    void reset();
+
+    /// closes the window once it elapsed, returns the new rate if it changed
+    std::optional<wifi_phy_rate_t> evaluate(int64_t now_us);
+
+    [[nodiscard]] const PhyRate &current() const
+    { return rates()[m_index]; }
+
+    /// per rate totals since the last reset_stats()
+    [[nodiscard]] std::array<RateStats, RATE_COUNT> stats() const;
+
+    void reset_stats();
+
+private:
+    struct Peer
+    {
+        std::array<uint8_t, ESP_NOW_ETH_ALEN> mac;
+        uint32_t sent;
+        uint32_t delivered;
+        std::optional<int8_t> rssi;
+        int64_t last_seen_us;
+    };
+
+    Peer *find_peer(const uint8_t *mac);
+    Peer &peer(const uint8_t *mac);
+
+    [[nodiscard]] size_t lowest_index() const
+    { return m_long_range ? 0 : 1; }
+
+    [[nodiscard]] size_t rssi_cap() const;
+
+    std::array<Peer, MAX_PEERS> m_peers{};
+    size_t m_peer_count = 0;
+    std::array<RateStats, RATE_COUNT> m_stats{};
+
+    size_t m_index;
+    float m_target = 0.9f;
+    bool m_long_range = false;
+    bool m_probing = false;
+    uint32_t m_good_windows = 0;
+    uint32_t m_probe_after;
+    int64_t m_window_start_us = 0;
+    mutable std::mutex m_mutex;
+};
+
+} // namespace espnow
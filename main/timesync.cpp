@@ -0,0 +1,140 @@
+#include "timesync.h"
+
+// system includes
+#include <algorithm>
+#include <cstdlib>
+
+namespace espnow {
+
+namespace {
+
+// the fastest exchange ages out slowly, so a changed path is picked up again
+constexpr const int64_t MIN_DELAY_AGING_US = 100;
+constexpr const int64_t DELAY_TOLERANCE_US = 1'000;
+constexpr const double DRIFT_SMOOTHING = 0.25;
+
+} // namespace
+
+void TimeSync::set_role(Role role)
+{
+    std::lock_guard lock{m_mutex};
+
+    m_role = role;
+    m_outstanding.reset();
+    m_synced = false;
+    m_exchanges = 0;
+    m_drift = 0.;
+    m_min_delay_us = MAX_DELAY_US;
+}
+
+std::optional<TimeSync::Request> TimeSync::poll(int64_t now_us)
+{
+    if (m_role != Role::Node)
+    {
+        return std::nullopt;
+    }
+
+    const auto interval = m_exchanges < FAST_EXCHANGES ? FAST_INTERVAL_US : INTERVAL_US;
+    if (m_last_request_us && now_us - m_last_request_us < interval)
+    {
+        return std::nullopt;
+    }
+
+    m_last_request_us = now_us;
+
+    std::lock_guard lock{m_mutex};
+
+    // an unanswered request is simply superseded
+    m_outstanding = Request{.seq = ++m_seq, .t1 = now_us};
+    m_stats.requests++;
+
+    return m_outstanding;
+}
+
+void TimeSync::response(uint16_t seq, int64_t t1, int64_t t2, int64_t t3, int64_t t4)
+{
+    std::lock_guard lock{m_mutex};
+
+    // other nodes' answers arrive here as well
+    if (!m_outstanding || m_outstanding->seq != seq || m_outstanding->t1 != t1)
+    {
+        return;
+    }
+
+    m_outstanding.reset();
+
+    const auto delay = (t4 - t1) - (t3 - t2);
+    const auto offset = ((t2 - t1) + (t3 - t4)) / 2;
+
+    if (delay < 0 || delay > m_min_delay_us * 2 + DELAY_TOLERANCE_US)
+    {
+        m_stats.rejected++;
+        m_min_delay_us = std::min(m_min_delay_us + MIN_DELAY_AGING_US, MAX_DELAY_US);
+        return;
+    }
+
+    m_min_delay_us = std::min(delay, m_min_delay_us + MIN_DELAY_AGING_US);
+    m_stats.delay.add(delay);
+
+    if (m_synced)
+    {
+        const auto predicted = m_offset_us + static_cast<int64_t>(m_drift * (t4 - m_reference_us));
+        m_stats.error.add(std::abs(offset - predicted));
+
+        const auto raw_drift = double(offset - m_offset_us) / (t4 - m_reference_us);
+        m_drift = m_exchanges < 2 ? raw_drift : m_drift + DRIFT_SMOOTHING * (raw_drift - m_drift);
+    }
+
+    m_offset_us = offset;
+    m_reference_us = t4;
+    m_synced = true;
+    m_exchanges++;
+
+    m_stats.accepted++;
+    m_stats.offset_us = offset;
+    m_stats.drift_ppm = m_drift * 1e6;
+}
+
+std::optional<int64_t> TimeSync::to_synced(int64_t local_us) const
+{
+    std::lock_guard lock{m_mutex};
+
+    if (m_role == Role::Master)
+    {
+        return local_us;
+    }
+
+    if (!m_synced)
+    {
+        return std::nullopt;
+    }
+
+    return local_us + m_offset_us + static_cast<int64_t>(m_drift * (local_us - m_reference_us));
+}
+
+bool TimeSync::synced() const
+{
+    std::lock_guard lock{m_mutex};
+
+    return m_role == Role::Master || m_synced;
+}
+
+TimeSync::Stats TimeSync::stats() const
+{
+    std::lock_guard lock{m_mutex};
+
+    return m_stats;
+}
+
+void TimeSync::reset_stats()
+{
+    std::lock_guard lock{m_mutex};
+
+    m_stats.requests = 0;
+    m_stats.accepted = 0;
+    m_stats.rejected = 0;
+    m_stats.error.reset();
+    m_stats.delay.reset();
+}
+
+} // namespace espnow
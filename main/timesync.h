@@ -0,0 +1,98 @@
+#pragma once
+
+// system includes
+#include <cstdint>
+#include <mutex>
+#include <optional>
+
+// local includes
+#include "helpers/durationstats.h"
+
+namespace espnow {
+
+/// Two-way time exchange against a master, NTP style. The node broadcasts
+/// "TSQ:<seq>,<t1>" and the master answers "TSR:<seq>,<t1>,<t2>,<t3>" with its
+/// receive and send times; t4 is the node's receive time. All times are
+/// esp_timer microseconds, taken in the ESP-NOW callbacks.
+///
+///   offset = ((t2 - t1) + (t3 - t4)) / 2, delay = (t4 - t1) - (t3 - t2)
+///
+/// Exchanges that took much longer than the fastest recent one were queued
+/// somewhere and are dropped. Drift comes from the offset change between
+/// accepted exchanges. The sync error is the difference between the offset an
+/// exchange measured and the one the model predicted for that moment.
+///
+/// to_synced() runs on the NimBLE host task, everything else on the main loop.
+class TimeSync
+{
+public:
+    enum class Role
+    {
+        Off,
+        Node,
+        Master,
+    };
+
+    struct Request
+    {
+        uint16_t seq;
+        int64_t t1;
+    };
+
+    constexpr static const int64_t MAX_DELAY_US = 20'000;
+    // a fresh node asks every second until it has a drift estimate
+    constexpr static const int64_t FAST_INTERVAL_US = 1'000'000;
+    constexpr static const int64_t INTERVAL_US = 10'000'000;
+    constexpr static const uint32_t FAST_EXCHANGES = 4;
+
+    void set_role(Role role);
+
+    [[nodiscard]] Role role() const
+    { return m_role; }
+
+    /// node: the request to send now, if one is due
+    std::optional<Request> poll(int64_t now_us);
+
+    /// node: t4 is the local receive time of the response
+    void response(uint16_t seq, int64_t t1, int64_t t2, int64_t t3, int64_t t4);
+
+    /// master time for a local timestamp, std::nullopt until synced. The master is synced by definition.
+    [[nodiscard]] std::optional<int64_t> to_synced(int64_t local_us) const;
+
+    [[nodiscard]] bool synced() const;
+
+    struct Stats
+    {
+        uint32_t requests{};
+        uint32_t accepted{};
+        uint32_t rejected{};
+        int64_t offset_us{};
+        float drift_ppm{};
+        // absolute value of measured minus predicted offset
+        helpers::DurationStats error;
+        helpers::DurationStats delay;
+    };
+
+    [[nodiscard]] Stats stats() const;
+
+    void reset_stats();
+
+private:
+    Role m_role = Role::Off;
+
+    uint16_t m_seq = 0;
+    std::optional<Request> m_outstanding;
+    int64_t m_last_request_us = 0;
+
+    bool m_synced = false;
+    uint32_t m_exchanges = 0;
+    int64_t m_offset_us = 0;
+    int64_t m_reference_us = 0;
+    double m_drift = 0.;
+    int64_t m_min_delay_us = MAX_DELAY_US;
+
+    Stats m_stats;
+    mutable std::mutex m_mutex;
+};
+
+} // namespace espnow
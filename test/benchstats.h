@@ -0,0 +1,102 @@
+#pragma once
+
+// system includes
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace bench {
+
+inline int64_t now_ns()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+/// Every sample of one measured step, for percentiles rather than just the mean
+class Samples
+{
+public:
+    void add(int64_t value)
+    { m_values.push_back(value); }
+
+    void merge(const Samples &other)
+    { m_values.insert(m_values.end(), other.m_values.begin(), other.m_values.end()); }
+
+    template<typename Function>
+    void measure(Function &&function)
+    {
+        const auto start = now_ns();
+        function();
+        add(now_ns() - start);
+    }
+
+    /// times \p function, which handles \p items items, as one block and adds the time per
+    /// item: two clock reads around every item would cost about as much as the item itself
+    template<typename Function>
+    void measure_each(size_t items, Function &&function)
+    {
+        const auto start = now_ns();
+        function();
+        add((now_ns() - start) / int64_t(std::max<size_t>(items, 1)));
+    }
+
+    [[nodiscard]] size_t count() const
+    { return m_values.size(); }
+
+    [[nodiscard]] int64_t sum() const
+    {
+        int64_t sum = 0;
+        for (const auto value : m_values)
+        {
+            sum += value;
+        }
+        return sum;
+    }
+
+    [[nodiscard]] double mean() const
+    { return m_values.empty() ? 0. : double(sum()) / m_values.size(); }
+
+    [[nodiscard]] int64_t percentile(double p) const
+    {
+        if (m_values.empty())
+        {
+            return 0;
+        }
+
+        auto sorted = m_values;
+        const auto index = std::min(sorted.size() - 1, static_cast<size_t>(p / 100. * sorted.size()));
+        std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+        return sorted[index];
+    }
+
+    [[nodiscard]] int64_t max() const
+    { return m_values.empty() ? 0 : *std::max_element(m_values.begin(), m_values.end()); }
+
+    /// one line, values in the unit they were added in
+    void print(const char *name, const char *unit = "ns") const
+    {
+        std::printf("  %-24s n=%-8zu avg=%.0f%s p50=%lld%s p99=%lld%s max=%lld%s\n", name, count(), mean(), unit,
+                    static_cast<long long>(percentile(50)), unit, static_cast<long long>(percentile(99)), unit,
+                    static_cast<long long>(max()), unit);
+    }
+
+private:
+    std::vector<int64_t> m_values;
+};
+
+inline int failures = 0;
+
+/// records a failed expectation, main() returns failures != 0
+inline void check(bool condition, const char *what)
+{
+    if (!condition)
+    {
+        std::fprintf(stderr, "FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+} // namespace bench
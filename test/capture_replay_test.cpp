@@ -0,0 +1,273 @@
+// Records emulator sessions into a CaptureRing and replays them with CaptureReplay,
+// every replayed status frame has to decode to what the live path decoded.
+//
+//   capture_replay_test [capture files...]
+//
+// Capture files are binary or a device log with the "CAP " lines of CAP:dump, they
+// are replayed as fast as possible and must not contain invalid frames.
+
+// system includes
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+// local includes
+#include "antbms/capture.h"
+#include "antbms/capturereplay.h"
+#include "antbms/datastructure.h"
+#include "antbms/emulator.h"
+#include "antbms/frame.h"
+#include "antbms/frameassembler.h"
+#include "antbms/statusdecoder.h"
+#include "benchstats.h"
+#include "capturefile.h"
+
+using namespace antbms;
+
+namespace {
+
+constexpr const auto STATUS_REQUEST_FRAME = make_frame(0x01, 0x0000, 0xbe);
+constexpr const int64_t POLL_INTERVAL_US = 500'000;
+constexpr const int64_t NO_LIMIT = std::numeric_limits<int64_t>::max();
+
+struct Snapshot
+{
+    float total_voltage;
+    float current;
+    float state_of_charge;
+    std::vector<float> cell_voltages;
+    std::vector<float> temperatures;
+
+    bool operator==(const Snapshot &) const = default;
+};
+
+Snapshot snapshot(const AntBmsData &data)
+{
+    return {data.total_voltage, data.current, data.state_of_charge, data.cell_voltages, data.temperatures};
+}
+
+/// polls the emulator like AntBms does, records everything and returns what the live path decoded
+std::vector<Snapshot> record_session(const Emulator::Config &config, size_t polls, CaptureRing &ring)
+{
+    Emulator emulator{config};
+    FrameAssembler assembler;
+    AntBmsData data{};
+    std::vector<Snapshot> decoded;
+
+    ring.record(CaptureEvent::Connected, 0, std::array<uint8_t, 2>{uint8_t(config.mtu), uint8_t(config.mtu >> 8)});
+
+    for (size_t i = 0; i < polls; i++)
+    {
+        const int64_t request_us = 1'000 + int64_t(i) * POLL_INTERVAL_US;
+        ring.record(CaptureEvent::Write, request_us, STATUS_REQUEST_FRAME);
+        emulator.write(STATUS_REQUEST_FRAME, request_us);
+
+        while (const auto due_us = emulator.next_due_us())
+        {
+            emulator.poll(*due_us, [&](const uint8_t *notification, size_t length) {
+                ring.record(CaptureEvent::Notification, *due_us, {notification, length});
+
+                const auto frame = assembler.feed({notification, length}, *due_us);
+                if (frame && validate_status_frame(*frame))
+                {
+                    decode_status_frame(*frame, data);
+                    decoded.push_back(snapshot(data));
+                }
+            });
+        }
+    }
+
+    return decoded;
+}
+
+CaptureReplay open_replay(const std::vector<uint8_t> &capture)
+{
+    auto replay = CaptureReplay::open(capture);
+    if (!replay)
+    {
+        std::fprintf(stderr, "open failed: %s\n", replay.error().c_str());
+        std::exit(EXIT_FAILURE);
+    }
+    return std::move(*replay);
+}
+
+void replay_matches_live_decode()
+{
+    CaptureRing ring;
+    ring.start(64 * 1024);
+    const auto expected = record_session({.cells = 14, .temperature_sensors = 4, .mtu = 23}, 200, ring);
+    const auto capture = ring.serialize();
+
+    auto replay = open_replay(capture);
+    std::vector<Snapshot> replayed;
+    replay.on_status([&](const AntBmsData &data, int64_t) { replayed.push_back(snapshot(data)); });
+
+    const auto done = replay.step(NO_LIMIT);
+    bench::check(done && *done, "replay runs to the end");
+    bench::check(ring.overwritten == 0, "ring holds the whole session");
+    bench::check(replayed.size() == 200 && replayed == expected, "replay decodes what the live path decoded");
+    bench::check(replay.stats().invalid_frames == 0, "no invalid frames");
+    bench::check(replay.mtu() == 23, "MTU taken from the connect record");
+
+    std::printf("replay: %zu bytes, %lu records, %lu frames, %.1fs captured\n", capture.size(),
+                static_cast<unsigned long>(replay.stats().records),
+                static_cast<unsigned long>(replay.stats().frames), replay.stats().captured_us / 1e6);
+}
+
+void paced_replay()
+{
+    CaptureRing ring;
+    ring.start(16 * 1024);
+    const auto expected = record_session({.cells = 16, .temperature_sensors = 2, .mtu = 247}, 20, ring);
+    auto replay = open_replay(ring.serialize());
+
+    int64_t until_us = 0;
+    bool early = false;
+    replay.on_status([&](const AntBmsData &, int64_t captured_us) { early |= captured_us > until_us; });
+
+    size_t steps = 0;
+    while (true)
+    {
+        const auto done = replay.step(until_us);
+        if (!done || *done)
+        {
+            bench::check(done.has_value(), "paced replay succeeds");
+            break;
+        }
+        until_us += POLL_INTERVAL_US / 4;
+        steps++;
+    }
+
+    bench::check(!early, "no record replayed before its time");
+    bench::check(steps >= 4 * 19, "paced replay spreads over the capture time");
+    bench::check(replay.stats().status_frames == expected.size(), "paced replay delivers every frame");
+
+    auto bounded = open_replay(ring.serialize());
+    bench::check(bounded.step(NO_LIMIT, 5) == false && bounded.stats().records == 5, "max_records bounds a step");
+}
+
+void overwritten_ring()
+{
+    CaptureRing ring;
+    ring.start(2 * 1024);
+    const auto expected = record_session({.cells = 14, .temperature_sensors = 4, .mtu = 23}, 100, ring);
+    bench::check(ring.overwritten > 0, "small ring overwrites");
+
+    auto replay = open_replay(ring.serialize());
+    const auto done = replay.step(NO_LIMIT);
+    bench::check(done && *done, "overwritten ring replays");
+    bench::check(replay.stats().invalid_frames == 0, "cut off first frame is dropped, not decoded");
+    bench::check(replay.stats().status_frames > 0 && snapshot(replay.data()) == expected.back(),
+                 "last frame of an overwritten ring decodes");
+}
+
+void reconnect_drops_partial_frame()
+{
+    Emulator emulator{{.cells = 14, .temperature_sensors = 4, .mtu = 23}};
+    std::vector<std::vector<uint8_t>> notifications;
+    emulator.write(STATUS_REQUEST_FRAME, 0);
+    while (const auto due_us = emulator.next_due_us())
+    {
+        emulator.poll(*due_us, [&](const uint8_t *data, size_t length) { notifications.emplace_back(data, data + length); });
+    }
+
+    CaptureRing ring;
+    ring.start(4 * 1024);
+    int64_t now_us = 0;
+    ring.record(CaptureEvent::Connected, now_us, std::array<uint8_t, 2>{23, 0});
+    for (size_t i = 0; i < notifications.size() / 2; i++)
+    {
+        ring.record(CaptureEvent::Notification, now_us += 7'500, notifications[i]);
+    }
+    ring.record(CaptureEvent::Disconnected, now_us += 1'000, std::array<uint8_t, 2>{0x08, 0x02});
+    ring.record(CaptureEvent::Connected, now_us += 1'000'000, std::array<uint8_t, 2>{23, 0});
+    // the tail of the old frame after a reconnect would complete nothing
+    for (size_t i = notifications.size() / 2; i < notifications.size(); i++)
+    {
+        ring.record(CaptureEvent::Notification, now_us += 7'500, notifications[i]);
+    }
+    for (const auto &notification : notifications)
+    {
+        ring.record(CaptureEvent::Notification, now_us += 7'500, notification);
+    }
+
+    auto replay = open_replay(ring.serialize());
+    const auto done = replay.step(NO_LIMIT);
+    bench::check(done && *done, "reconnect capture replays");
+    bench::check(replay.stats().status_frames == 1, "only the frame after the reconnect completes");
+}
+
+void broken_captures()
+{
+    CaptureRing ring;
+    ring.start(4 * 1024);
+    record_session({}, 2, ring);
+    auto capture = ring.serialize();
+
+    auto magic = capture;
+    magic[0] = 'X';
+    bench::check(!CaptureReplay::open(magic), "bad magic is refused");
+
+    capture.resize(capture.size() - 3);
+    auto replay = open_replay(capture);
+    bench::check(!replay.step(NO_LIMIT), "truncated capture is an error");
+}
+
+bool replay_file(const char *path)
+{
+    const auto capture = bench::load_capture(path);
+    if (!capture)
+    {
+        std::fprintf(stderr, "%s\n", capture.error().c_str());
+        return false;
+    }
+
+    auto replay = open_replay(*capture);
+    bench::Samples decode;
+    auto last_ns = bench::now_ns();
+    replay.on_status([&](const AntBmsData &, int64_t) {
+        const auto now = bench::now_ns();
+        decode.add(now - last_ns);
+        last_ns = now;
+    });
+
+    const auto done = replay.step(NO_LIMIT);
+    if (!done)
+    {
+        std::fprintf(stderr, "%s: %s\n", path, done.error().c_str());
+        return false;
+    }
+
+    const auto &stats = replay.stats();
+    std::printf("%s: mtu=%u records=%lu notifications=%lu frames=%lu status=%lu invalid=%lu captured=%.1fs\n", path,
+                replay.mtu(), static_cast<unsigned long>(stats.records),
+                static_cast<unsigned long>(stats.notifications), static_cast<unsigned long>(stats.frames),
+                static_cast<unsigned long>(stats.status_frames), static_cast<unsigned long>(stats.invalid_frames),
+                stats.captured_us / 1e6);
+    decode.print("replay per status frame");
+
+    return stats.invalid_frames == 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            bench::check(replay_file(argv[i]), argv[i]);
+        }
+        return bench::failures ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    replay_matches_live_decode();
+    paced_replay();
+    overwritten_ring();
+    reconnect_drops_partial_frame();
+    broken_captures();
+
+    return bench::failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
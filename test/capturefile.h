@@ -0,0 +1,69 @@
+#pragma once
+
+// system includes
+#include <array>
+#include <cstdint>
+#include <expected>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// local includes
+#include "antbms/capture.h"
+#include "helpers/base64.h"
+
+namespace bench {
+
+/// Loads a capture file, either binary or a device log with the "CAP " lines of CAP:dump
+inline std::expected<std::vector<uint8_t>, std::string> load_capture(const char *path)
+{
+    std::ifstream file{path, std::ios::binary};
+    if (!file)
+    {
+        return std::unexpected(std::string{"cannot open "} + path);
+    }
+
+    const std::string content{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+    if (content.starts_with("ANTC"))
+    {
+        return std::vector<uint8_t>(content.begin(), content.end());
+    }
+
+    std::vector<uint8_t> capture;
+    std::string_view rest{content};
+    while (!rest.empty())
+    {
+        const auto end = rest.find('\n');
+        auto line = rest.substr(0, end);
+        rest = end == std::string_view::npos ? std::string_view{} : rest.substr(end + 1);
+
+        const auto marker = line.find("CAP ");
+        if (marker == std::string_view::npos)
+        {
+            continue;
+        }
+
+        line = line.substr(marker + 4);
+        // the log may colour the line
+        line = line.substr(0, line.find_first_of("\r\x1b "));
+
+        std::array<uint8_t, 96> chunk;
+        const auto size = helpers::base64_decode(line, chunk);
+        if (!size)
+        {
+            return std::unexpected(path + std::string{": "} + size.error());
+        }
+        capture.insert(capture.end(), chunk.begin(), chunk.begin() + *size);
+    }
+
+    if (capture.size() < antbms::CAPTURE_HEADER_SIZE)
+    {
+        return std::unexpected(std::string{path} + ": no capture found");
+    }
+
+    return capture;
+}
+
+} // namespace bench
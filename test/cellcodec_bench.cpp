@@ -0,0 +1,108 @@
+// cellcodec::pack() and unpack() over cell vectors of growing size and spread, with
+// the packed size against the JSON "vol" array it replaces.
+//
+//   cellcodec_bench [rounds]
+//
+// Every round packs and unpacks a set of distinct vectors.
+
+// system includes
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+// local includes
+#include "antbms/cellcodec.h"
+#include "helpers/base64.h"
+#include "helpers/jsonwriter.h"
+#include "benchstats.h"
+
+using namespace antbms;
+
+namespace {
+
+constexpr const size_t VECTORS_PER_ROUND = 256;
+
+using packed_t = std::array<uint8_t, cellcodec::max_packed_size(cellcodec::MAX_CELLS)>;
+
+void run(size_t cells, uint16_t spread_mv, size_t rounds)
+{
+    std::mt19937 random{uint32_t(cells * 1000 + spread_mv)};
+    std::uniform_int_distribution<uint16_t> offset{0, spread_mv};
+
+    std::vector<std::vector<uint16_t>> vectors(VECTORS_PER_ROUND);
+    for (auto &cells_mv : vectors)
+    {
+        for (size_t i = 0; i < cells; i++)
+        {
+            cells_mv.push_back(3200 + offset(random));
+        }
+    }
+
+    std::vector<packed_t> packed(VECTORS_PER_ROUND);
+    std::vector<size_t> packed_sizes(VECTORS_PER_ROUND);
+    std::array<uint16_t, cellcodec::MAX_CELLS> unpacked;
+
+    bench::Samples pack;
+    bench::Samples unpack;
+    size_t errors = 0;
+    size_t mismatches = 0;
+
+    for (size_t round = 0; round < rounds; round++)
+    {
+        pack.measure_each(VECTORS_PER_ROUND, [&]() {
+            for (size_t i = 0; i < VECTORS_PER_ROUND; i++)
+            {
+                const auto size = cellcodec::pack(vectors[i], packed[i]);
+                errors += !size.has_value();
+                packed_sizes[i] = size.value_or(0);
+            }
+        });
+
+        unpack.measure_each(VECTORS_PER_ROUND, [&]() {
+            for (size_t i = 0; i < VECTORS_PER_ROUND; i++)
+            {
+                const auto count = cellcodec::unpack({packed[i].data(), packed_sizes[i]}, unpacked);
+                errors += !count.has_value();
+                mismatches += !count || !std::equal(vectors[i].begin(), vectors[i].end(), unpacked.begin(),
+                                                    unpacked.begin() + *count);
+            }
+        });
+    }
+
+    // what goes over the air: base64 in "cvp", against the "vol" array of encodeFields()
+    std::array<char, 1024> json;
+    helpers::JsonWriter vol{json};
+    vol.begin_array("vol");
+    for (const auto cell_mv : vectors.front())
+    {
+        vol.add_milli(cell_mv);
+    }
+    vol.end_array();
+
+    std::printf("%zu cells within %umV: %zu bytes packed, %zu as base64, \"vol\" %zu bytes\n", cells, spread_mv,
+                packed_sizes.front(), helpers::base64_encoded_size(packed_sizes.front()), vol.size());
+    pack.print("pack");
+    unpack.print("unpack");
+
+    bench::check(errors == 0, "every vector packs and unpacks");
+    bench::check(mismatches == 0, "unpack returns what was packed");
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    const size_t rounds = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20'000;
+
+    for (const size_t cells : {8, 16, 24, 32})
+    {
+        for (const uint16_t spread_mv : {15, 63, 500})
+        {
+            run(cells, spread_mv, rounds);
+        }
+    }
+
+    return bench::failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,81 @@
+// validate_status_frame() and decode_status_frame() over emulator frames of growing
+// cell counts.
+//
+//   decode_bench [rounds]
+//
+// Every round validates and decodes a set of distinct frames.
+
+// system includes
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// local includes
+#include "antbms/datastructure.h"
+#include "antbms/emulator.h"
+#include "antbms/statusdecoder.h"
+#include "benchstats.h"
+#include "emulatorframes.h"
+
+using namespace antbms;
+
+namespace {
+
+constexpr const size_t FRAMES_PER_ROUND = 256;
+
+void run(uint8_t cells, uint8_t sensors, size_t rounds)
+{
+    Emulator emulator{{.cells = cells, .temperature_sensors = sensors, .mtu = 247}};
+    std::vector<std::vector<uint8_t>> frames;
+    for (size_t i = 0; i < FRAMES_PER_ROUND; i++)
+    {
+        frames.push_back(bench::emulator_status_frame(emulator, int64_t(i) * 1'000'000));
+    }
+
+    AntBmsData data{};
+    bench::Samples validate;
+    bench::Samples decode;
+    size_t invalid = 0;
+    float checksum = 0.f;
+
+    for (size_t round = 0; round < rounds; round++)
+    {
+        validate.measure_each(FRAMES_PER_ROUND, [&]() {
+            for (const auto &frame : frames)
+            {
+                invalid += !validate_status_frame(frame).has_value();
+            }
+        });
+
+        decode.measure_each(FRAMES_PER_ROUND, [&]() {
+            for (const auto &frame : frames)
+            {
+                decode_status_frame(frame, data);
+                checksum += data.total_voltage;
+            }
+        });
+    }
+
+    std::printf("%u cells, %u sensors, %zu byte frames: %.0f frames/s decoded (checksum %.0f)\n", cells, sensors,
+                frames.front().size(), decode.mean() ? 1e9 / decode.mean() : 0., checksum);
+    validate.print("validate");
+    decode.print("decode");
+
+    bench::check(invalid == 0, "emulator frames validate");
+    bench::check(data.cell_voltages.size() == cells, "decoded cell count");
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    const size_t rounds = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2'000;
+
+    run(8, 2, rounds);
+    run(14, 4, rounds);
+    run(16, 2, rounds);
+    run(24, 4, rounds);
+    run(32, 4, rounds);
+
+    return bench::failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+// system includes
+#include <cstdint>
+#include <vector>
+
+// local includes
+#include "antbms/emulator.h"
+#include "antbms/frame.h"
+
+namespace bench {
+
+/// The emulator's complete answer to one status request at \p now_us, notifications joined
+inline std::vector<uint8_t> emulator_status_frame(antbms::Emulator &emulator, int64_t now_us)
+{
+    constexpr auto STATUS_REQUEST_FRAME = antbms::make_frame(0x01, 0x0000, 0xbe);
+
+    std::vector<uint8_t> frame;
+    emulator.write(STATUS_REQUEST_FRAME, now_us);
+    while (const auto due_us = emulator.next_due_us())
+    {
+        emulator.poll(*due_us, [&](const uint8_t *data, size_t length) { frame.insert(frame.end(), data, data + length); });
+    }
+    return frame;
+}
+
+} // namespace bench
@@ -0,0 +1,153 @@
+// The old ESP-NOW telemetry path, toString()/toRareString() through a
+// StaticJsonDocument, std::string and fmt::format(), against encodeFields() into
+// the 250 byte transmit buffer. Same fields on both sides, encode time and peak stack.
+//
+//   encode_bench [rounds]
+//
+// The stack peak is taken on a painted thread stack, less what an empty function
+// on the same thread touches. Both sides include their transmit buffer, the
+// std::string on one side and the tx_buffer of AntBms::send_telemetry_slot_() on the other.
+
+// system includes
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// 3rdparty includes
+#include <ArduinoJson.h>
+
+// local includes
+#include "antbms/datastructure.h"
+#include "antbms/emulator.h"
+#include "antbms/statusdecoder.h"
+#include "benchstats.h"
+#include "emulatorframes.h"
+#include "stackpeak.h"
+
+using namespace antbms;
+
+namespace {
+
+// ESP_NOW_MAX_DATA_LEN
+constexpr const size_t TX_BUFFER_SIZE = 250;
+
+// what toJSON() writes
+constexpr const FieldMask TO_JSON_FIELDS = field_mask(
+        Field::Power, Field::TotalVoltage, Field::Current, Field::StateOfCharge, Field::CapacityRemaining,
+        Field::ChargeMosfetStatus, Field::DischargeMosfetStatus, Field::BalancerStatus, Field::DeltaCellVoltage,
+        Field::MaxCellVoltage, Field::MinCellVoltage);
+
+// what toRareJSON() writes for every value of its counter
+constexpr const std::array<FieldMask, 9> TO_RARE_JSON_FIELDS{
+        field_mask(Field::BalancerTemperature, Field::MosfetTemperature, Field::StateOfHealth),
+        field_mask(Field::TotalBatteryCapacitySetting, Field::BatteryCycleCapacity, Field::TotalRuntime),
+        field_mask(Field::BalancedCellBitmask, Field::MaxVoltageCell, Field::MinVoltageCell),
+        field_mask(Field::AccumulatedChargingCapacity, Field::AccumulatedDischargingTime,
+                   Field::AccumulatedChargingTime),
+        field_mask(Field::AverageCellVoltage, Field::AccumulatedDischargingCapacity,
+                   Field::ChargeMosfetStatusString),
+        field_mask(Field::DischargeMosfetStatusString, Field::BalancerStatusString,
+                   Field::AccumulatedDischargingTimeFormatted),
+        field_mask(Field::AccumulatedChargingTimeFormatted, Field::HardwareVersion, Field::SoftwareVersion,
+                   Field::TotalRuntimeFormatted),
+        field_mask(Field::CellVoltages),
+        field_mask(Field::Temperatures),
+};
+
+// keeps the encoders from being optimised away
+volatile size_t sink;
+
+// one rotation: toString() plus every toRareString() step, as the node used to send them
+size_t old_path(const AntBmsData &data)
+{
+    size_t bytes = 0;
+    const std::string fast = data.toString();
+    bytes += fast.size();
+    for (size_t i = 0; i < TO_RARE_JSON_FIELDS.size(); i++)
+    {
+        const std::string rare = data.toRareString();
+        bytes += rare.size();
+    }
+    return bytes;
+}
+
+// the same rotation with encodeFields(), 0 on any error
+size_t new_path(const AntBmsData &data)
+{
+    std::array<char, TX_BUFFER_SIZE> tx_buffer;
+
+    size_t bytes = 0;
+    const auto fast = data.encodeFields(tx_buffer, TO_JSON_FIELDS);
+    if (!fast)
+    {
+        return 0;
+    }
+    bytes += *fast;
+
+    for (const auto fields : TO_RARE_JSON_FIELDS)
+    {
+        const auto rare = data.encodeFields(tx_buffer, fields);
+        if (!rare)
+        {
+            return 0;
+        }
+        bytes += *rare;
+    }
+    return bytes;
+}
+
+void run(uint8_t cells, uint8_t sensors, size_t rounds)
+{
+    Emulator emulator{{.cells = cells, .temperature_sensors = sensors, .mtu = 247}};
+    AntBmsData data{};
+    decode_status_frame(bench::emulator_status_frame(emulator, 1'000'000), data);
+    data.hardware_version = "16ZMB1";
+    data.software_version = "2.1.1516";
+    // toJSON() has no timestamp, leave it out of encodeFields() as well
+    data.timestamp_us = 0;
+
+    bench::Samples old_ns;
+    bench::Samples new_ns;
+    size_t old_bytes = 0;
+    size_t new_bytes = 0;
+
+    for (size_t round = 0; round < rounds; round++)
+    {
+        old_ns.measure([&]() { old_bytes = old_path(data); });
+        new_ns.measure([&]() { new_bytes = new_path(data); });
+    }
+
+    const auto baseline = bench::stack_peak([]() { sink = 0; });
+    const auto old_stack = bench::stack_peak([&]() { sink = old_path(data); }) - baseline;
+    const auto new_stack = bench::stack_peak([&]() { sink = new_path(data); }) - baseline;
+
+    std::printf("%u cells, %u sensors: %zu bytes old, %zu bytes new per rotation of %zu frames\n", cells, sensors,
+                old_bytes, new_bytes, TO_RARE_JSON_FIELDS.size() + 1);
+    old_ns.print("toString/toRareString");
+    new_ns.print("encodeFields");
+    std::printf("  stack peak: %zu bytes old, %zu bytes new, sizeof(StaticJsonDocument<1024>) %zu\n", old_stack,
+                new_stack, sizeof(ArduinoJson::StaticJsonDocument<1024>));
+
+    bench::check(new_bytes != 0, "encodeFields fits every frame into the transmit buffer");
+    bench::check(new_stack < old_stack, "encodeFields needs less stack than toString");
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    const size_t rounds = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20'000;
+
+    if (sizeof(ArduinoJson::StaticJsonDocument<1024>) < 1024)
+    {
+        std::printf("ArduinoJson.h is a stand-in, the old path leaves out the document and its serialization\n");
+    }
+
+    run(8, 2, rounds);
+    run(16, 4, rounds);
+    run(32, 4, rounds);
+
+    return bench::failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+# Reads the export stream of export_stream through a pty with tools/exportreader.py,
+# the way tools/export-reader reads the gateway's UART.
+#
+#   export_reader_test.py <export_stream binary> [duration ms]
+#
+# Every frame written has to arrive and decode, sequence gaps may only come from
+# batches the writer skipped. Reports throughput against the line rate.
+
+import os
+import pty
+import select
+import subprocess
+import sys
+import time
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.realpath(__file__)), '..', 'tools'))
+
+from exportreader import Reader, open_port  # noqa: E402
+
+SENDERS = 50
+CELLS = 16
+
+# name, baud (0: as fast as the pty takes it), export interval in ms
+SCENARIOS = [
+    ('2 Mbaud, 50 senders every 50ms', 2_000_000, 50),
+    ('5 Mbaud saturated', 5_000_000, 2),
+    ('pty unpaced', 0, 2),
+]
+
+
+def run(binary, name, baud, interval_ms, duration_ms):
+    master, slave = pty.openpty()
+    # the reader opens the slave by name like a serial adapter
+    fd = open_port(os.ttyname(slave), baud or 4000000)
+    os.close(slave)
+
+    writer = subprocess.Popen([binary, str(baud), str(duration_ms), str(SENDERS), str(interval_ms)],
+                              stdout=master, stderr=subprocess.PIPE)
+
+    reader = Reader()
+    failures = []
+    start = time.monotonic()
+    while True:
+        # the master stays open here, closing it would drop what the reader has not read yet
+        if not select.select([fd], [], [], 0.2)[0]:
+            if writer.poll() is not None:
+                break
+            continue
+
+        data = os.read(fd, 65536)
+
+        for snapshot in reader.feed(data):
+            sender = int(snapshot['mac'].split(':')[-1], 16)
+            if not snapshot['mac'].startswith('02:00:00:00') or len(snapshot['cells_mv']) != CELLS or \
+                    snapshot['cells_mv'][0] != 3300 + sender or abs(snapshot['total_voltage'] - (40 + sender * 0.25)) > 1e-3:
+                failures.append(f'unexpected snapshot {snapshot}')
+    # without the idle wait at the end
+    elapsed = time.monotonic() - start - 0.2
+    os.close(fd)
+    os.close(master)
+
+    _, stderr = writer.communicate()
+    written = dict(item.split('=') for item in stderr.decode().split())
+    written = {key: int(value) for key, value in written.items()}
+
+    line = f' {reader.bytes / elapsed / (baud / 10) * 100:.0f}% of line' if baud else ''
+    print(f'{name}: {reader.frames} frames in {elapsed:.2f}s, {reader.frames / elapsed:.0f} frames/s, '
+          f'{reader.bytes / elapsed / 1000:.0f} kB/s{line}, lost={reader.lost} bad={reader.bad}, '
+          f'writer skipped={written["skipped"]}')
+
+    if writer.returncode != 0:
+        failures.append(f'writer exited with {writer.returncode}')
+    if reader.frames != written['frames']:
+        failures.append(f'{written["frames"]} frames written, {reader.frames} read')
+    if reader.bytes != written['bytes']:
+        failures.append(f'{written["bytes"]} bytes written, {reader.bytes} read')
+    if reader.bad:
+        failures.append(f'{reader.bad} bad frames')
+    if reader.lost > written['skipped']:
+        failures.append(f'{reader.lost} frames lost, only {written["skipped"]} skipped')
+
+    for failure in failures[:5]:
+        print(f'FAILED: {name}: {failure}', file=sys.stderr)
+    return not failures
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(f'usage: {sys.argv[0]} <export_stream binary> [duration ms]', file=sys.stderr)
+        return 1
+
+    duration_ms = int(sys.argv[2]) if len(sys.argv) > 2 else 3000
+    results = [run(sys.argv[1], name, baud, interval, duration_ms) for name, baud, interval in SCENARIOS]
+    return 0 if all(results) else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
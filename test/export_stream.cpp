@@ -0,0 +1,126 @@
+// Writes the gateway's UART export stream to stdout, for export_reader_test.py to read
+// from a pty. Simulated senders update a GatewayStore every interval, the
+// ExportEncoder output is paced like a UART at the given baud rate behind a TX ring
+// of the device's size; batches that do not fit are skipped as UartExport does.
+//
+//   export_stream <baud, 0 for unpaced> <duration ms> [senders] [interval ms]
+//
+// Prints "frames=<n> skipped=<n> bytes=<n>" to stderr at the end.
+
+// system includes
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+// posix includes
+#include <unistd.h>
+
+// local includes
+#include "antbms/datastructure.h"
+#include "antbms/exportencoder.h"
+#include "antbms/gatewaystore.h"
+
+using namespace antbms;
+
+namespace {
+
+// UartExport::Config::tx_buffer_size
+constexpr const double TX_RING_SIZE = 8192;
+constexpr const size_t CELLS = 16;
+
+bool write_all(std::span<const uint8_t> data)
+{
+    while (!data.empty())
+    {
+        const auto written = ::write(STDOUT_FILENO, data.data(), data.size());
+        if (written <= 0)
+        {
+            return false;
+        }
+        data = data.subspan(written);
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        std::fprintf(stderr, "usage: %s <baud> <duration ms> [senders] [interval ms]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    using clock = std::chrono::steady_clock;
+
+    const double baud = std::strtod(argv[1], nullptr);
+    const auto duration = std::chrono::milliseconds{std::strtol(argv[2], nullptr, 10)};
+    const size_t senders = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 50;
+    const auto interval = std::chrono::milliseconds{argc > 4 ? std::strtol(argv[4], nullptr, 10) : 50};
+
+    GatewayStore store;
+    ExportEncoder encoder{store};
+
+    size_t frames = 0;
+    size_t skipped = 0;
+    size_t bytes = 0;
+    bool failed = false;
+
+    // bytes in the simulated TX ring, drained at 10 bit times per byte
+    double ring = 0;
+    auto ring_at = clock::now();
+
+    const auto start = clock::now();
+    auto next = start;
+    for (uint32_t cycle = 1; clock::now() - start < duration && !failed; cycle++)
+    {
+        for (size_t sender = 0; sender < senders; sender++)
+        {
+            const GatewayStore::SourceKey key{
+                .mac = {0x02, 0x00, 0x00, 0x00, static_cast<uint8_t>(sender >> 8), static_cast<uint8_t>(sender)},
+                .pack_id = static_cast<uint8_t>(sender % 3),
+            };
+
+            store.update(key, cycle, [&](AntBmsData &data) {
+                data.total_voltage = 40.f + sender * 0.25f;
+                data.state_of_charge = cycle % 100;
+                data.cell_voltages.assign(CELLS, 3.3f + sender * 0.001f);
+            });
+        }
+
+        encoder.export_changed([&](std::span<const uint8_t> batch, size_t batch_frames) {
+            if (baud > 0)
+            {
+                const auto now = clock::now();
+                ring = std::max(0., ring - std::chrono::duration<double>(now - ring_at).count() * baud / 10.);
+                ring_at = now;
+
+                if (ring + batch.size() > TX_RING_SIZE)
+                {
+                    skipped += batch_frames;
+                    return;
+                }
+                ring += batch.size();
+            }
+
+            failed |= !write_all(batch);
+            frames += batch_frames;
+            bytes += batch.size();
+        });
+
+        next += interval;
+        std::this_thread::sleep_until(next);
+    }
+
+    // the line drains what is left in the ring
+    if (baud > 0)
+    {
+        std::this_thread::sleep_for(std::chrono::duration<double>(ring * 10. / baud));
+    }
+
+    std::fprintf(stderr, "frames=%zu skipped=%zu bytes=%zu\n", frames, skipped, bytes);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
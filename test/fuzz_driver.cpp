@@ -0,0 +1,146 @@
+// Stand-in for libFuzzer when the compiler has none: feeds LLVMFuzzerTestOneInput()
+// with emulator status frames, mutated deterministically, and with the files given.
+//
+//   fuzz_status_frame [iterations] [corpus files...]
+
+// system includes
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+// esp-idf includes
+#include <esp_log.h>
+
+// local includes
+#include "antbms/emulator.h"
+#include "antbms/frame.h"
+#include "antbms/statusdecoder.h"
+#include "emulatorframes.h"
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+namespace {
+
+std::vector<std::vector<uint8_t>> seed_frames()
+{
+    std::vector<std::vector<uint8_t>> seeds;
+    for (uint8_t cells : {1, 8, 14, 16, 24, 32})
+    {
+        for (uint8_t sensors : {0, 2, 4})
+        {
+            antbms::Emulator emulator{{.cells = cells, .temperature_sensors = sensors, .mtu = 247}};
+            seeds.push_back(bench::emulator_status_frame(emulator, 1'000'000));
+        }
+    }
+    return seeds;
+}
+
+// CRC and end marker where the length byte says, so mutants get past the assembler's checks
+void fix_up(std::vector<uint8_t> &input)
+{
+    if (input.size() < antbms::ANT_FRAME_OVERHEAD)
+    {
+        return;
+    }
+
+    const size_t frame_len = std::min(input.size(), antbms::ANT_FRAME_OVERHEAD + input[5]);
+    const auto crc = helpers::crc16(input.data() + 1, frame_len - 5);
+    input[frame_len - 4] = crc >> 0;
+    input[frame_len - 3] = crc >> 8;
+    input[frame_len - 2] = antbms::ANT_PKT_END_1;
+    input[frame_len - 1] = antbms::ANT_PKT_END_2;
+}
+
+void mutate(std::vector<uint8_t> &input, std::minstd_rand &random)
+{
+    std::uniform_int_distribution<int> byte{0, 255};
+    const auto at = [&] { return std::uniform_int_distribution<size_t>{0, input.size() - 1}(random); };
+
+    switch (random() % 6)
+    {
+    case 0:
+        if (!input.empty())
+        {
+            input[at()] ^= 1 << (random() % 8);
+        }
+        break;
+    case 1:
+        if (!input.empty())
+        {
+            input[at()] = byte(random);
+        }
+        break;
+    case 2:
+        // length, sensor and cell count decide every offset
+        for (const size_t i : {5, 8, 9})
+        {
+            if (i < input.size() && random() % 2)
+            {
+                input[i] = byte(random);
+            }
+        }
+        break;
+    case 3:
+        if (!input.empty())
+        {
+            input.resize(at());
+        }
+        break;
+    case 4:
+        for (auto n = random() % 16; n; n--)
+        {
+            input.push_back(byte(random));
+        }
+        break;
+    case 5:
+        input.resize(random() % 300);
+        for (auto &value : input)
+        {
+            value = byte(random);
+        }
+        break;
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    const size_t iterations = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1'000'000;
+
+    esp_log_level_set("*", ESP_LOG_NONE);
+
+    for (int i = 2; i < argc; i++)
+    {
+        std::ifstream file{argv[i], std::ios::binary};
+        const std::vector<uint8_t> input{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+
+    const auto seeds = seed_frames();
+    std::minstd_rand random{1};
+    size_t valid = 0;
+
+    for (size_t i = 0; i < iterations; i++)
+    {
+        auto input = seeds[i % seeds.size()];
+        for (auto n = 1 + random() % 4; n; n--)
+        {
+            mutate(input, random);
+        }
+        if (random() % 2)
+        {
+            fix_up(input);
+        }
+
+        valid += antbms::validate_status_frame(input).has_value();
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+
+    std::printf("%zu inputs, %zu passed validation, %zu seeds\n", iterations, valid, seeds.size());
+    return EXIT_SUCCESS;
+}
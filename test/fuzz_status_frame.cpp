@@ -0,0 +1,49 @@
+// Fuzz target for validate_status_frame() and decode_status_frame(). Whatever
+// passes validation is decoded, so the decoder must never read outside the frame.
+// The same bytes also go through FrameAssembler as notifications of 1 to 64 bytes.
+//
+// Built with libFuzzer under Clang, otherwise fuzz_driver.cpp calls it with mutated
+// emulator frames. Both builds run under AddressSanitizer and UBSan.
+
+// system includes
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+// local includes
+#include "antbms/datastructure.h"
+#include "antbms/frame.h"
+#include "antbms/frameassembler.h"
+#include "antbms/statusdecoder.h"
+
+using namespace antbms;
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    const std::span<const uint8_t> frame{data, size};
+
+    if (validate_status_frame(frame))
+    {
+        AntBmsData decoded{};
+        decode_status_frame(frame, decoded);
+
+        if (decoded.cell_voltages.size() != frame[9] || decoded.temperatures.size() != frame[8])
+        {
+            __builtin_trap();
+        }
+    }
+
+    FrameAssembler assembler;
+    const size_t chunk_size = size ? 1 + data[0] % 64 : 1;
+    for (size_t pos = 0; pos < size; pos += chunk_size)
+    {
+        const auto assembled = assembler.feed(frame.subspan(pos, std::min(chunk_size, size - pos)), int64_t(pos));
+        if (assembled && (assembled->size() < ANT_FRAME_OVERHEAD || assembled->size() > size))
+        {
+            __builtin_trap();
+        }
+    }
+
+    return 0;
+}
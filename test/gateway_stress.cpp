@@ -0,0 +1,167 @@
+// GatewayStore under load: one writer thread publishes updates for many senders, as
+// the ESP-NOW ingest on the gateway's main loop does, while reader threads copy
+// random sources and check every copy for tearing.
+//
+//   gateway_stress [duration ms] [senders] [readers]
+//
+// Read latency is sampled on every 16th read, the max covers all of them.
+
+// system includes
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+// local includes
+#include "antbms/datastructure.h"
+#include "antbms/gatewaystore.h"
+#include "benchstats.h"
+
+using namespace antbms;
+
+namespace {
+
+constexpr const size_t STRESS_CELLS = 16;
+// cell values stay within what a PackSnapshot can hold
+constexpr const uint32_t CELL_VALUE_RANGE = 4000;
+constexpr const uint32_t LATENCY_SAMPLE_EVERY = 16;
+
+// every field of an update is derived from one counter, a torn copy mixes two of them
+bool consistent(const PackSnapshot &snapshot)
+{
+    if (!snapshot.updates)
+    {
+        return true;
+    }
+
+    const auto expected = static_cast<uint16_t>(static_cast<uint32_t>(snapshot.total_voltage) % CELL_VALUE_RANGE);
+    return snapshot.cell_count == STRESS_CELLS &&
+           std::all_of(snapshot.cells_mv.begin(), snapshot.cells_mv.begin() + STRESS_CELLS,
+                       [expected](uint16_t cell) { return cell == expected; });
+}
+
+struct ReaderResult
+{
+    uint64_t reads{};
+    uint64_t torn{};
+    uint32_t retries{};
+    int64_t max_ns{};
+    bench::Samples latency;
+};
+
+void reader(const GatewayStore &store, const std::atomic<bool> &stop, ReaderResult &result, uint32_t seed)
+{
+    std::minstd_rand rng{seed};
+
+    while (!stop.load(std::memory_order_relaxed))
+    {
+        const auto count = store.size();
+        if (!count)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        const auto start = bench::now_ns();
+        const auto snapshot = store.read(rng() % count, &result.retries);
+        const auto latency = bench::now_ns() - start;
+
+        result.max_ns = std::max(result.max_ns, latency);
+        if (result.reads++ % LATENCY_SAMPLE_EVERY == 0)
+        {
+            result.latency.add(latency);
+        }
+
+        if (!consistent(snapshot))
+        {
+            result.torn++;
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    const int64_t duration_ns = (argc > 1 ? std::strtol(argv[1], nullptr, 10) : 2'000) * 1'000'000;
+    const size_t senders = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 50;
+    const size_t readers = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 4;
+
+    GatewayStore store;
+    std::atomic<bool> stop{false};
+    std::vector<ReaderResult> reader_results(readers);
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < readers; i++)
+    {
+        threads.emplace_back(reader, std::cref(store), std::cref(stop), std::ref(reader_results[i]), uint32_t(i + 1));
+    }
+
+    uint64_t updates = 0;
+    uint32_t counter = 0;
+    bench::Samples update_latency;
+
+    const auto start = bench::now_ns();
+    while (bench::now_ns() - start < duration_ns)
+    {
+        for (size_t sender = 0; sender < senders; sender++)
+        {
+            const GatewayStore::SourceKey key{
+                .mac = {0x02, 0x00, 0x00, 0x00, static_cast<uint8_t>(sender >> 8), static_cast<uint8_t>(sender)},
+                .pack_id = 0,
+            };
+
+            const auto value = ++counter;
+            const auto update_start = bench::now_ns();
+            store.update(key, update_start / 1000, [value](AntBmsData &data) {
+                data.total_voltage = static_cast<float>(value % (1 << 24));
+                data.cell_voltages.resize(STRESS_CELLS);
+                std::fill(data.cell_voltages.begin(), data.cell_voltages.end(),
+                          (value % (1 << 24) % CELL_VALUE_RANGE) * 0.001f);
+            });
+            if (updates++ % LATENCY_SAMPLE_EVERY == 0)
+            {
+                update_latency.add(bench::now_ns() - update_start);
+            }
+        }
+    }
+    const auto elapsed_s = (bench::now_ns() - start) / 1e9;
+
+    stop = true;
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    uint64_t reads = 0;
+    uint64_t torn = 0;
+    uint64_t retries = 0;
+    int64_t max_read_ns = 0;
+    bench::Samples read_latency;
+    for (const auto &result : reader_results)
+    {
+        reads += result.reads;
+        torn += result.torn;
+        retries += result.retries;
+        max_read_ns = std::max(max_read_ns, result.max_ns);
+        read_latency.merge(result.latency);
+    }
+
+    std::printf("%zu senders, %zu readers, %.1fs: %.0f updates/s, %.0f reads/s, torn=%llu retries=%llu (%.4f per read)\n",
+                senders, readers, elapsed_s, updates / elapsed_s, reads / elapsed_s,
+                static_cast<unsigned long long>(torn), static_cast<unsigned long long>(retries),
+                reads ? double(retries) / reads : 0.);
+    update_latency.print("update");
+    read_latency.print("read");
+    std::printf("  read max over all %llu reads: %lldns\n", static_cast<unsigned long long>(reads),
+                static_cast<long long>(max_read_ns));
+
+    bench::check(store.size() == std::min(senders, GatewayStore::MAX_SOURCES), "every sender got a slot");
+    bench::check(torn == 0, "no torn copies");
+    bench::check(reads > 0, "readers got through");
+
+    return bench::failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,176 @@
+// Emulator -> FrameAssembler -> status decode -> analytics -> telemetry encode, the
+// path every status frame takes on a node, without BLE and ESP-NOW in between.
+//
+//   pipeline_bench [frames]
+//
+// Wall clock numbers are host CPU time per stage. Link latency is the emulator's
+// simulated time from status request to the last notification of the answer.
+
+// system includes
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// local includes
+#include "antbms/analytics.h"
+#include "antbms/datastructure.h"
+#include "antbms/emulator.h"
+#include "antbms/frame.h"
+#include "antbms/frameassembler.h"
+#include "antbms/statusdecoder.h"
+#include "antbms/telemetryscheduler.h"
+#include "benchstats.h"
+
+using namespace antbms;
+
+namespace {
+
+constexpr const auto STATUS_REQUEST_FRAME = make_frame(0x01, 0x0000, 0xbe);
+
+// the gap between two status polls in simulated time, the emulator never overlaps answers
+constexpr const int64_t POLL_INTERVAL_US = 1'000'000;
+
+struct Scenario
+{
+    const char *name;
+    Emulator::Config config;
+};
+
+void run(const Scenario &scenario, size_t frames, FieldMask fields)
+{
+    Emulator emulator{scenario.config};
+    FrameAssembler assembler;
+    AntBmsData data;
+    Analytics analytics;
+    std::array<char, 250> tx_buffer;
+
+    bench::Samples assemble;
+    bench::Samples decode;
+    bench::Samples analyse;
+    bench::Samples encode;
+    bench::Samples total;
+    bench::Samples link_latency;
+
+    size_t completed = 0;
+    size_t invalid = 0;
+    size_t encoded_bytes = 0;
+
+    const auto wall_start = bench::now_ns();
+
+    for (size_t i = 0; i < frames; i++)
+    {
+        const int64_t request_us = int64_t(i) * POLL_INTERVAL_US;
+        emulator.write(STATUS_REQUEST_FRAME, request_us);
+
+        int64_t assemble_ns = 0;
+        while (const auto due_us = emulator.next_due_us())
+        {
+            emulator.poll(*due_us, [&](const uint8_t *notification, size_t length) {
+                const auto start = bench::now_ns();
+                const auto frame = assembler.feed({notification, length}, *due_us);
+                assemble_ns += bench::now_ns() - start;
+
+                if (!frame)
+                {
+                    return;
+                }
+
+                link_latency.add(*due_us - request_us);
+
+                int64_t decode_ns = 0;
+                int64_t analyse_ns = 0;
+                int64_t encode_ns = 0;
+
+                {
+                    const auto start = bench::now_ns();
+                    const auto valid = validate_status_frame(*frame);
+                    if (valid)
+                    {
+                        decode_status_frame(*frame, data);
+                    }
+                    decode_ns = bench::now_ns() - start;
+
+                    if (!valid)
+                    {
+                        invalid++;
+                        return;
+                    }
+                }
+
+                {
+                    // right after the decode, as AntBms::on_status_data_() does
+                    const auto start = bench::now_ns();
+                    analytics.update(data, *due_us);
+                    analyse_ns = bench::now_ns() - start;
+                }
+
+                {
+                    const auto start = bench::now_ns();
+                    const auto size = data.encodeFields(tx_buffer, fields);
+                    encode_ns = bench::now_ns() - start;
+                    bench::check(size.has_value(), "fast group fits one ESP-NOW frame");
+                    encoded_bytes += size.value_or(0);
+                }
+
+                completed++;
+                assemble.add(assemble_ns);
+                decode.add(decode_ns);
+                analyse.add(analyse_ns);
+                encode.add(encode_ns);
+                total.add(assemble_ns + decode_ns + analyse_ns + encode_ns);
+                assemble_ns = 0;
+            });
+        }
+    }
+
+    const auto wall_s = (bench::now_ns() - wall_start) / 1e9;
+
+    std::printf("%s: cells=%u sensors=%u mtu=%u loss=%.0f%%\n", scenario.name, scenario.config.cells,
+                scenario.config.temperature_sensors, scenario.config.mtu, scenario.config.loss_rate * 100.f);
+    std::printf("  frames %zu/%zu complete, %zu invalid, crc errors=%lu length errors=%lu, %.0f frames/s, "
+                "%.1f bytes encoded per frame\n",
+                completed, frames, invalid, static_cast<unsigned long>(assembler.crc_errors),
+                static_cast<unsigned long>(assembler.length_errors), completed / wall_s,
+                completed ? double(encoded_bytes) / completed : 0.);
+    assemble.print("assemble");
+    decode.print("validate+decode");
+    analyse.print("analytics");
+    encode.print("encode");
+    total.print("total");
+    link_latency.print("request->frame (link)", "us");
+
+    bench::check(invalid == 0, "every assembled frame validates");
+    bench::check(data.cell_voltages.size() == scenario.config.cells, "decoded cell count");
+    bench::check(data.temperatures.size() == scenario.config.temperature_sensors, "decoded sensor count");
+    bench::check(std::isfinite(data.energy_in) && std::isfinite(data.energy_out) && std::isfinite(data.average_current) &&
+                 std::isfinite(data.imbalance_trend) && std::isfinite(data.internal_resistance),
+                 "derived metrics stay finite");
+    if (scenario.config.loss_rate == 0.f)
+    {
+        bench::check(completed == frames, "no loss, every frame completes");
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    const size_t frames = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100'000;
+
+    const auto fast_fields = TelemetryScheduler{}.group(0).fields;
+
+    const std::array<Scenario, 3> scenarios{{
+        {"default MTU", {.cells = 14, .temperature_sensors = 4, .mtu = 23}},
+        {"negotiated MTU", {.cells = 16, .temperature_sensors = 2, .mtu = 247}},
+        {"lossy link", {.cells = 14, .temperature_sensors = 4, .mtu = 23, .loss_rate = 0.02f}},
+    }};
+
+    for (const auto &scenario : scenarios)
+    {
+        run(scenario, frames, fast_fields);
+    }
+
+    return bench::failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,223 @@
+// Every SerializationFormat over status frames replayed from captures, the host
+// counterpart of run_serialization_benchmark() on the device.
+//
+//   serialization_bench [iterations] [capture files...]
+//
+// Capture files are binary or a device log with the "CAP " lines of CAP:dump,
+// every decoded status frame of them is one sample. Without capture files an
+// emulator session is recorded and replayed instead.
+//
+// Prints one "BENCH {...}" line per format, tools/benchmark-results turns them into
+// a results file or checks them against an earlier one:
+//
+//   serialization_bench 50 capture.log | tools/benchmark-results -o results.json
+//   serialization_bench 50 capture.log | tools/benchmark-results --baseline results.json
+//
+// CPU time is host time per sample, the stack peak is taken on a painted thread
+// stack less an empty function, the heap peak counts operator new of the encoder.
+// Airtime is at 1 Mbps, the rate RateController starts at.
+
+// system includes
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include <string>
+#include <vector>
+
+// posix includes
+#include <malloc.h>
+
+// local includes
+#include "antbms/capture.h"
+#include "antbms/capturereplay.h"
+#include "antbms/emulator.h"
+#include "antbms/frame.h"
+#include "antbms/serializationbench.h"
+#include "benchstats.h"
+#include "capturefile.h"
+#include "ratecontroller.h"
+#include "stackpeak.h"
+
+using namespace antbms;
+
+namespace {
+
+constexpr const auto STATUS_REQUEST_FRAME = make_frame(0x01, 0x0000, 0xbe);
+
+// allocations while tracing, sizes as malloc rounded them so frees match
+bool tracing = false;
+int64_t heap_current = 0;
+int64_t heap_peak = 0;
+
+/// polls the emulator once a second and records everything, as CAP:start does on a node
+std::vector<uint8_t> emulator_capture(const Emulator::Config &config, size_t polls)
+{
+    Emulator emulator{config};
+    CaptureRing ring;
+    ring.start(256 * 1024);
+    ring.record(CaptureEvent::Connected, 0, std::array<uint8_t, 2>{uint8_t(config.mtu), uint8_t(config.mtu >> 8)});
+
+    for (size_t i = 0; i < polls; i++)
+    {
+        const int64_t request_us = 1'000 + int64_t(i) * 1'000'000;
+        ring.record(CaptureEvent::Write, request_us, STATUS_REQUEST_FRAME);
+        emulator.write(STATUS_REQUEST_FRAME, request_us);
+
+        while (const auto due_us = emulator.next_due_us())
+        {
+            emulator.poll(*due_us, [&](const uint8_t *notification, size_t length) {
+                ring.record(CaptureEvent::Notification, *due_us, {notification, length});
+            });
+        }
+    }
+
+    return ring.serialize();
+}
+
+bool replay(std::vector<uint8_t> capture, const char *source, std::vector<RecordedSample> &samples)
+{
+    auto replay = CaptureReplay::open(std::move(capture));
+    if (!replay)
+    {
+        std::fprintf(stderr, "%s: %s\n", source, replay.error().c_str());
+        return false;
+    }
+
+    replay->on_status([&samples](const AntBmsData &data, int64_t captured_us) {
+        samples.push_back(RecordedSample{.received_us = captured_us, .data = data});
+    });
+
+    if (const auto done = replay->step(std::numeric_limits<int64_t>::max()); !done)
+    {
+        std::fprintf(stderr, "%s: %s\n", source, done.error().c_str());
+        return false;
+    }
+
+    std::printf("%s: %lu status frames, %lu invalid\n", source,
+                static_cast<unsigned long>(replay->stats().status_frames),
+                static_cast<unsigned long>(replay->stats().invalid_frames));
+    return true;
+}
+
+SerializationResult run(const SerializationFormat &format, std::span<const RecordedSample> samples,
+                        size_t iterations, size_t stack_baseline)
+{
+    const auto &rate = espnow::RateController{}.current();
+
+    SerializationResult result{.name = format.name, .samples = uint32_t(samples.size())};
+
+    int64_t cpu_ns = 0;
+    for (size_t i = 0; i < iterations; i++)
+    {
+        SerializationSink sink{.rate = rate};
+
+        const auto start = bench::now_ns();
+        format.encode(samples, sink);
+        cpu_ns += bench::now_ns() - start;
+
+        // every iteration produces the same frames
+        result.frames = sink.frames;
+        result.bytes = sink.bytes;
+        result.errors = sink.errors;
+        result.airtime_us = sink.airtime_us;
+    }
+    result.cpu_ns_per_sample = cpu_ns / std::max<int64_t>(samples.size() * iterations, 1);
+
+    result.stack_peak = bench::stack_peak([&]() {
+        SerializationSink sink{.rate = rate};
+        format.encode(samples, sink);
+    }) - stack_baseline;
+
+    {
+        SerializationSink sink{.rate = rate};
+        heap_current = 0;
+        heap_peak = 0;
+        tracing = true;
+        format.encode(samples, sink);
+        tracing = false;
+        result.heap_peak = heap_peak;
+    }
+
+    return result;
+}
+
+} // namespace
+
+void *operator new(size_t size)
+{
+    void *ptr = std::malloc(size ? size : 1);
+    if (!ptr)
+    {
+        throw std::bad_alloc{};
+    }
+
+    if (tracing)
+    {
+        heap_current += malloc_usable_size(ptr);
+        heap_peak = std::max(heap_peak, heap_current);
+    }
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+    if (ptr && tracing)
+    {
+        heap_current -= malloc_usable_size(ptr);
+    }
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+int main(int argc, char **argv)
+{
+    const size_t iterations = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 50;
+
+    std::vector<RecordedSample> samples;
+    for (int i = 2; i < argc; i++)
+    {
+        auto capture = bench::load_capture(argv[i]);
+        if (!capture)
+        {
+            std::fprintf(stderr, "%s\n", capture.error().c_str());
+            return EXIT_FAILURE;
+        }
+        if (!replay(std::move(*capture), argv[i], samples))
+        {
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (argc <= 2)
+    {
+        replay(emulator_capture({.cells = 16, .temperature_sensors = 4, .mtu = 247}, 200), "emulator", samples);
+    }
+
+    if (samples.empty())
+    {
+        std::fprintf(stderr, "no status frames in the captures\n");
+        return EXIT_FAILURE;
+    }
+
+    const auto stack_baseline = bench::stack_peak([]() {});
+
+    for (const auto &format : serialization_formats())
+    {
+        const auto result = run(format, samples, iterations, stack_baseline);
+
+        std::array<char, 384> line;
+        const auto json = format_serialization_result(result, line);
+        std::printf("BENCH %.*s\n", int(json.size()), json.data());
+
+        bench::check(result.errors == 0, format.name);
+    }
+
+    return bench::failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+// host stand-in, errors and warnings go to stderr unless esp_log_level_set("*", ...) lowered
+// the level, the rest is compiled but never printed
+
+// system includes
+#include <cstdio>
+
+typedef enum
+{
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+inline esp_log_level_t esp_log_host_level = ESP_LOG_WARN;
+
+inline void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    if (tag[0] == '*')
+    {
+        esp_log_host_level = level;
+    }
+}
+
+#define ESP_LOG_PRINTED(level, letter, tag, format, ...) \
+    do { if (esp_log_host_level >= level) std::fprintf(stderr, letter " %s: " format "\n", tag, ##__VA_ARGS__); } while (false)
+#define ESP_LOGE(tag, format, ...) ESP_LOG_PRINTED(ESP_LOG_ERROR, "E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) ESP_LOG_PRINTED(ESP_LOG_WARN, "W", tag, format, ##__VA_ARGS__)
+#define ESP_LOG_DROPPED(tag, format, ...) do { if (false) std::fprintf(stderr, format, ##__VA_ARGS__); } while (false)
+#define ESP_LOGI(tag, format, ...) ESP_LOG_DROPPED(tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) ESP_LOG_DROPPED(tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) ESP_LOG_DROPPED(tag, format, ##__VA_ARGS__)
@@ -0,0 +1,7 @@
+#pragma once
+
+// host stand-in, only the limits the portable code sizes its buffers by
+
+#define ESP_NOW_ETH_ALEN 6
+#define ESP_NOW_MAX_DATA_LEN 250
+#define ESP_NOW_MAX_TOTAL_PEER_NUM 20
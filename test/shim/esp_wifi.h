@@ -0,0 +1,15 @@
+#pragma once
+
+// host stand-in, only the PHY rates RateController picks from, values as in ESP-IDF
+
+typedef enum
+{
+    WIFI_PHY_RATE_1M_L = 0x00,
+    WIFI_PHY_RATE_2M_L = 0x01,
+    WIFI_PHY_RATE_24M = 0x09,
+    WIFI_PHY_RATE_12M = 0x0A,
+    WIFI_PHY_RATE_6M = 0x0B,
+    WIFI_PHY_RATE_54M = 0x0C,
+    WIFI_PHY_RATE_36M = 0x0D,
+    WIFI_PHY_RATE_LORA_250K = 0x29,
+} wifi_phy_rate_t;
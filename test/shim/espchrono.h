@@ -0,0 +1,30 @@
+#pragma once
+
+// host stand-in for the parts of espchrono the portable code uses
+
+// system includes
+#include <chrono>
+#include <cstdint>
+
+// local includes
+#include "esp_timer.h"
+
+namespace espchrono {
+
+struct millis_clock
+{
+    using rep = int64_t;
+    using period = std::milli;
+    using duration = std::chrono::duration<rep, period>;
+    using time_point = std::chrono::time_point<millis_clock, duration>;
+
+    static constexpr bool is_steady = true;
+
+    static time_point now()
+    { return time_point{duration{esp_timer_get_time() / 1000}}; }
+};
+
+inline millis_clock::duration ago(millis_clock::time_point time_point)
+{ return millis_clock::now() - time_point; }
+
+} // namespace espchrono
@@ -0,0 +1,15 @@
+#pragma once
+
+// host stand-in, one tick is a millisecond
+
+// system includes
+#include <cstdint>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) (static_cast<TickType_t>(ms))
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
@@ -0,0 +1,22 @@
+#pragma once
+
+// host stand-in, tasks are threads
+
+// system includes
+#include <chrono>
+#include <thread>
+
+// local includes
+#include "FreeRTOS.h"
+
+inline void vTaskDelay(TickType_t ticks)
+{
+    if (ticks)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds{ticks * portTICK_PERIOD_MS});
+    }
+    else
+    {
+        std::this_thread::yield();
+    }
+}
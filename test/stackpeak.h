@@ -0,0 +1,49 @@
+#pragma once
+
+// system includes
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+// posix includes
+#include <pthread.h>
+
+namespace bench {
+
+/// Runs \p function on a thread of its own with a painted stack and returns how many
+/// bytes of it were touched, like uxTaskGetStackHighWaterMark() on the device.
+/// Includes the thread's own frames, compare against an empty function.
+///
+/// \p function runs once beforehand: the first call through a PLT entry goes through
+/// the dynamic linker, which saves the vector registers and takes a few KB of stack.
+template<typename Function>
+size_t stack_peak(Function &&function, size_t stack_size = 64 * 1024)
+{
+    constexpr const uint8_t PAINT = 0xa5;
+
+    function();
+
+    auto *stack = static_cast<uint8_t *>(std::aligned_alloc(4096, stack_size));
+    std::memset(stack, PAINT, stack_size);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, stack, stack_size);
+
+    pthread_t thread;
+    pthread_create(&thread, &attr, [](void *arg) -> void * {
+        (*static_cast<Function *>(arg))();
+        return nullptr;
+    }, &function);
+    pthread_join(thread, nullptr);
+    pthread_attr_destroy(&attr);
+
+    // the stack grows down, the lowest touched byte is the peak
+    const auto untouched = std::find_if(stack, stack + stack_size, [](uint8_t byte) { return byte != PAINT; }) - stack;
+    std::free(stack);
+
+    return stack_size - untouched;
+}
+
+} // namespace bench
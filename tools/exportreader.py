@@ -0,0 +1,111 @@
+# Decoder for the gateway's binary UART export (GATEWAY_UART_EXPORT), see main/antbms/exportencoder.h
+#
+# Used by tools/export-reader, import it to read the stream from other tools:
+#
+#   reader = exportreader.Reader()
+#   for snapshot in reader.feed(os.read(fd, 4096)):
+#       ...
+#
+# test/export_reader_test.py checks it over a pty against the device encoder.
+
+import os
+import struct
+import termios
+import tty
+
+VERSION = 1
+TYPE_SNAPSHOT = 1
+SNAPSHOT = struct.Struct('<qqI8f4f32HHH')
+HEADER = struct.Struct('<BBH6sB')
+FRAME_SIZE = HEADER.size + SNAPSHOT.size + 2
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0xA001 if crc & 1 else crc >> 1
+    return crc
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            return None
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+class Reader:
+    def __init__(self):
+        self.buffer = bytearray()
+        self.sequence = None
+        self.frames = 0
+        self.bytes = 0
+        self.lost = 0
+        self.bad = 0
+
+    def feed(self, data):
+        self.bytes += len(data)
+        self.buffer += data
+        while (end := self.buffer.find(0)) >= 0:
+            encoded = bytes(self.buffer[:end])
+            del self.buffer[:end + 1]
+            if encoded:
+                yield from self.frame(encoded)
+
+    def frame(self, encoded):
+        frame = cobs_decode(encoded)
+        if frame is None or len(frame) != FRAME_SIZE or \
+                crc16(frame[:-2]) != int.from_bytes(frame[-2:], 'little'):
+            self.bad += 1
+            return
+
+        version, type_, sequence, mac, pack_id = HEADER.unpack_from(frame)
+        if version != VERSION or type_ != TYPE_SNAPSHOT:
+            self.bad += 1
+            return
+
+        if self.sequence is not None:
+            self.lost += (sequence - self.sequence - 1) & 0xFFFF
+        self.sequence = sequence
+        self.frames += 1
+
+        fields = SNAPSHOT.unpack_from(frame, HEADER.size)
+        cell_count, temperature_count = fields[-2:]
+        yield {
+            'sequence': sequence,
+            'mac': mac.hex(':'),
+            'pack_id': pack_id,
+            'timestamp_us': fields[0],
+            'updated_us': fields[1],
+            'updates': fields[2],
+            'total_voltage': fields[3],
+            'current': fields[4],
+            'power': fields[5],
+            'state_of_charge': fields[6],
+            'max_cell_voltage': fields[7],
+            'min_cell_voltage': fields[8],
+            'delta_cell_voltage': fields[9],
+            'mosfet_temperature': fields[10],
+            'temperatures': list(fields[11:15][:temperature_count]),
+            'cells_mv': list(fields[15:47][:cell_count]),
+        }
+
+
+def open_port(path, baud):
+    fd = os.open(path, os.O_RDONLY | os.O_NOCTTY)
+    tty.setraw(fd)
+    attributes = termios.tcgetattr(fd)
+    speed = getattr(termios, f'B{baud}', None)
+    if speed is not None:
+        attributes[4] = attributes[5] = speed
+    termios.tcsetattr(fd, termios.TCSANOW, attributes)
+    return fd